@@ -17,10 +17,12 @@
 //***************************************************************************
 
 // ISO C++ 98 headers.
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <cstdio>
-#include <map>
+#include <cstring>
+#include <utility>
 
 // IMC Base headers.
 #include "String.hpp"
@@ -30,10 +32,6 @@
 // IMC API headers.
 #include "../Spec/AllMessages.hpp"
 
-//! Construct a std::map statically from an array of std::pairs.
-#define IMC_DECLARE_STATIC_MAP(name, ta, tb, ps)                    \
-  static std::map<ta, tb> name(ps, (ps) + sizeof(ps) / sizeof((ps)[0]))
-
 namespace IMC
 {
   typedef Message* (*Creator) (void);
@@ -45,36 +43,94 @@ namespace IMC
     return new Type();
   }
 
-  static std::pair<uint32_t, std::string> pairs_id_abbrev[] =
+  //! Message type known to the factory.
+  struct FactoryEntry
   {
-#define MESSAGE(id, abbrev, md5)                    \
-    std::pair<uint32_t, std::string>(id, #abbrev),
-#include "../Spec/Factory.xdef"
+    uint32_t id;
+    Creator creator;
+    const char* abbrev;
   };
 
-  static std::pair<std::string, uint32_t> pairs_abbrev_id[] =
+  //! All message types, constant initialized.
+  static const FactoryEntry c_entries[] =
   {
 #define MESSAGE(id, abbrev, md5)                    \
-    std::pair<std::string, uint32_t>(#abbrev, id),
+    {id, &create<abbrev>, #abbrev},
 #include "../Spec/Factory.xdef"
   };
 
-  static std::pair<int, Creator> creator_pairs_id[] =
+  static const size_t c_entry_count = sizeof(c_entries) / sizeof(c_entries[0]);
+
+  //! Lookup tables built once from c_entries.
+  class FactoryTables
   {
-#define MESSAGE(id, abbrev, md5)                    \
-    std::pair<int, Creator>(id, &create<abbrev>),
-#include "../Spec/Factory.xdef"
+  public:
+    //! Entries indexed by identification number (null for unknown ids).
+    std::vector<const FactoryEntry*> by_id;
+    //! Entries sorted by abbreviation.
+    std::vector<const FactoryEntry*> by_abbrev;
+
+    FactoryTables(void)
+    {
+      uint32_t max_id = 0;
+      for (size_t i = 0; i < c_entry_count; ++i)
+        max_id = std::max(max_id, c_entries[i].id);
+
+      by_id.assign(max_id + 1, 0);
+      for (size_t i = 0; i < c_entry_count; ++i)
+      {
+        by_id[c_entries[i].id] = &c_entries[i];
+        by_abbrev.push_back(&c_entries[i]);
+      }
+      std::sort(by_abbrev.begin(), by_abbrev.end(), lessAbbrev);
+    }
+
+    const FactoryEntry*
+    find(uint32_t id) const
+    {
+      return id < by_id.size() ? by_id[id] : 0;
+    }
+
+    const FactoryEntry*
+    find(const std::string& abbrev) const
+    {
+      std::vector<const FactoryEntry*>::const_iterator itr =
+        std::lower_bound(by_abbrev.begin(), by_abbrev.end(), abbrev, lessAbbrevKey);
+
+      if (itr == by_abbrev.end() || abbrev != (*itr)->abbrev)
+        return 0;
+
+      return *itr;
+    }
+
+  private:
+    static bool
+    lessAbbrev(const FactoryEntry* a, const FactoryEntry* b)
+    {
+      return std::strcmp(a->abbrev, b->abbrev) < 0;
+    }
+
+    static bool
+    lessAbbrevKey(const FactoryEntry* a, const std::string& abbrev)
+    {
+      return abbrev.compare(a->abbrev) > 0;
+    }
   };
 
-  IMC_DECLARE_STATIC_MAP(creators_by_id, int, Creator, creator_pairs_id);
-  IMC_DECLARE_STATIC_MAP(map_id_abbrev, uint32_t, std::string, pairs_id_abbrev);
-  IMC_DECLARE_STATIC_MAP(map_abbrev_id, std::string, uint32_t, pairs_abbrev_id);
+  //! Tables are built on first use, which is thread-safe.
+  static const FactoryTables&
+  tables(void)
+  {
+    static const FactoryTables t;
+    return t;
+  }
 
   Message*
   Factory::produce(uint32_t id)
   {
-    if (creators_by_id[id])
-      return creators_by_id[id]();
+    const FactoryEntry* entry = tables().find(id);
+    if (entry)
+      return entry->creator();
 
     return 0;
   }
@@ -90,42 +146,38 @@ namespace IMC
   std::string
   Factory::getAbbrevFromId(uint32_t id)
   {
-    std::map<uint32_t, std::string>::iterator itr = map_id_abbrev.find(id);
+    const FactoryEntry* entry = tables().find(id);
 
-    if (itr == map_id_abbrev.end())
+    if (entry == 0)
       throw InvalidMessageId(id);
 
-    return itr->second;
+    return entry->abbrev;
   }
 
   uint32_t
   Factory::getIdFromAbbrev(const std::string& name)
   {
-    std::map<std::string, uint32_t>::iterator itr = map_abbrev_id.find(name);
+    const FactoryEntry* entry = tables().find(name);
 
-    if (itr == map_abbrev_id.end())
+    if (entry == 0)
       throw InvalidMessageAbbrev(name);
 
-    return itr->second;
+    return entry->id;
   }
 
   void
   Factory::getAbbrevs(std::vector<std::string>& v)
   {
-    for(std::map<std::string, uint32_t>::iterator itr = map_abbrev_id.begin();
-        itr != map_abbrev_id.end(); itr++)
-    {
-      v.push_back(itr->first);
-    }
+    const std::vector<const FactoryEntry*>& entries = tables().by_abbrev;
+    for (size_t i = 0; i < entries.size(); ++i)
+      v.push_back(entries[i]->abbrev);
   }
 
   void
   Factory::getIds(std::vector<uint32_t>& v)
   {
-    for(std::map<std::string, uint32_t>::iterator itr = map_abbrev_id.begin();
-        itr != map_abbrev_id.end(); itr++)
-    {
-      v.push_back(itr->second);
-    }
+    const std::vector<const FactoryEntry*>& entries = tables().by_abbrev;
+    for (size_t i = 0; i < entries.size(); ++i)
+      v.push_back(entries[i]->id);
   }
 }
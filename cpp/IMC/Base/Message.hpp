@@ -28,6 +28,7 @@
 #include "Config.hpp"
 #include "Message.hpp"
 #include "JSON.hpp"
+#include "MessagePool.hpp"
 #include "Exceptions.hpp"
 #include "Clock.hpp"
 
@@ -87,6 +88,20 @@ namespace IMC
     ~Message(void)
     { }
 
+    //! Allocate message objects from the pool of their type.
+    static void*
+    operator new(size_t size)
+    {
+      return MessagePool::allocate(size);
+    }
+
+    //! Return message objects to the pool of their type.
+    static void
+    operator delete(void* ptr, size_t size)
+    {
+      MessagePool::release(ptr, size);
+    }
+
     //! Retrieve a copy of the message.
     //! @return message copy.
     virtual Message*
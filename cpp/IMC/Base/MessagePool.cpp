@@ -0,0 +1,188 @@
+//***************************************************************************
+// Copyright 2017 OceanScan - Marine Systems & Technology, Lda.             *
+//***************************************************************************
+// Licensed under the Apache License, Version 2.0 (the "License");          *
+// you may not use this file except in compliance with the License.         *
+// You may obtain a copy of the License at                                  *
+//                                                                          *
+// http://www.apache.org/licenses/LICENSE-2.0                               *
+//                                                                          *
+// Unless required by applicable law or agreed to in writing, software      *
+// distributed under the License is distributed on an "AS IS" BASIS,        *
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+// See the License for the specific language governing permissions and      *
+// limitations under the License.                                           *
+//***************************************************************************
+
+// ISO C++ 11 headers.
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// IMC Base headers.
+#include "MessagePool.hpp"
+
+namespace IMC
+{
+  //! Block sizes are rounded up to a multiple of this.
+  static const size_t c_granularity = 16;
+  //! Number of pools: larger blocks are not pooled.
+  static const size_t c_pool_count = 128;
+  //! Number of blocks moved at once between a thread cache and a shared pool.
+  static const size_t c_batch = 32;
+
+  //! Free blocks of one size shared by all threads.
+  struct SharedPool
+  {
+    std::mutex mutex;
+    std::vector<void*> blocks;
+  };
+
+  static std::atomic<size_t> s_capacity(1024);
+  static std::atomic<size_t> s_recycled(0);
+  static std::atomic<size_t> s_allocated(0);
+
+  //! Shared pools are never destroyed, as messages with static storage
+  //! duration may be deleted after the end of main().
+  static SharedPool*
+  sharedPools(void)
+  {
+    static SharedPool* p = new SharedPool[c_pool_count];
+    return p;
+  }
+
+  //! Set once the cache of the thread is destroyed, after which its blocks
+  //! go straight to the system allocator.
+  static thread_local bool t_cache_destroyed = false;
+
+  //! Free blocks cached by a thread, allocated and released without locking.
+  //! Blocks move to and from the shared pools by batches, so that messages
+  //! created by a thread and deleted by another are recycled too.
+  struct ThreadCache
+  {
+    std::vector<void*> blocks[c_pool_count];
+    size_t recycled;
+
+    ThreadCache(void):
+      recycled(0)
+    { }
+
+    ~ThreadCache(void)
+    {
+      t_cache_destroyed = true;
+      for (size_t i = 0; i < c_pool_count; ++i)
+      {
+        while (!blocks[i].empty())
+          giveBack(i, blocks[i].size());
+      }
+      s_recycled += recycled;
+    }
+
+    void*
+    take(size_t index)
+    {
+      std::vector<void*>& local = blocks[index];
+      if (local.empty())
+      {
+        SharedPool& pool = sharedPools()[index];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        const size_t n = std::min(c_batch, pool.blocks.size());
+        local.insert(local.end(), pool.blocks.end() - n, pool.blocks.end());
+        pool.blocks.resize(pool.blocks.size() - n);
+      }
+      if (local.empty())
+        return 0;
+
+      void* ptr = local.back();
+      local.pop_back();
+      ++recycled;
+      return ptr;
+    }
+
+    void
+    put(size_t index, void* ptr)
+    {
+      std::vector<void*>& local = blocks[index];
+      local.push_back(ptr);
+      if (local.size() >= 2 * c_batch)
+        giveBack(index, c_batch);
+    }
+
+    //! Move the last n blocks to the shared pool, or to the system if the
+    //! shared pool is full.
+    void
+    giveBack(size_t index, size_t n)
+    {
+      std::vector<void*>& local = blocks[index];
+      SharedPool& pool = sharedPools()[index];
+      {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        const size_t kept = std::min(n, s_capacity > pool.blocks.size() ? s_capacity - pool.blocks.size() : 0);
+        pool.blocks.insert(pool.blocks.end(), local.end() - n, local.end() - (n - kept));
+        for (size_t i = local.size() - (n - kept); i < local.size(); ++i)
+          ::operator delete(local[i]);
+      }
+      local.resize(local.size() - n);
+    }
+  };
+
+  //! Cache of the calling thread, null if it was already destroyed.
+  static ThreadCache*
+  threadCache(void)
+  {
+    if (t_cache_destroyed)
+      return 0;
+
+    static thread_local ThreadCache cache;
+    return &cache;
+  }
+
+  void*
+  MessagePool::allocate(size_t size)
+  {
+    const size_t index = (size + c_granularity - 1) / c_granularity;
+    ThreadCache* cache = index < c_pool_count ? threadCache() : 0;
+    if (cache)
+    {
+      void* ptr = cache->take(index);
+      if (ptr)
+        return ptr;
+    }
+
+    ++s_allocated;
+    return ::operator new(index * c_granularity);
+  }
+
+  void
+  MessagePool::release(void* ptr, size_t size)
+  {
+    if (ptr == 0)
+      return;
+
+    const size_t index = (size + c_granularity - 1) / c_granularity;
+    ThreadCache* cache = index < c_pool_count ? threadCache() : 0;
+    if (cache)
+    {
+      cache->put(index, ptr);
+      return;
+    }
+
+    ::operator delete(ptr);
+  }
+
+  void
+  MessagePool::setCapacity(size_t capacity)
+  {
+    s_capacity = capacity;
+  }
+
+  void
+  MessagePool::getStats(size_t& recycled, size_t& allocated)
+  {
+    ThreadCache* cache = threadCache();
+    recycled = s_recycled + (cache ? cache->recycled : 0);
+    allocated = s_allocated;
+  }
+}
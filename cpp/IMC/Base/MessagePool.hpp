@@ -0,0 +1,70 @@
+//***************************************************************************
+// Copyright 2017 OceanScan - Marine Systems & Technology, Lda.             *
+//***************************************************************************
+// Licensed under the Apache License, Version 2.0 (the "License");          *
+// you may not use this file except in compliance with the License.         *
+// You may obtain a copy of the License at                                  *
+//                                                                          *
+// http://www.apache.org/licenses/LICENSE-2.0                               *
+//                                                                          *
+// Unless required by applicable law or agreed to in writing, software      *
+// distributed under the License is distributed on an "AS IS" BASIS,        *
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+// See the License for the specific language governing permissions and      *
+// limitations under the License.                                           *
+//***************************************************************************
+
+#ifndef IMC_MESSAGE_POOL_HPP_INCLUDED_
+#define IMC_MESSAGE_POOL_HPP_INCLUDED_
+
+// ISO C++ 98 headers.
+#include <cstddef>
+
+// IMC Base headers.
+#include "Config.hpp"
+
+namespace IMC
+{
+  class IMC_SYM_EXPORT MessagePool;
+
+  //! Pools of memory blocks for message objects.
+  //!
+  //! Blocks are pooled by size, i.e. by message type, and recycled when a
+  //! message is deleted, so that high-rate messages do not go through the
+  //! system allocator once their pool is warm. Each thread caches free
+  //! blocks without locking and exchanges them by batches with pools shared
+  //! by all threads: a message can be deleted by another thread than the one
+  //! that created it.
+  //! Only the message objects are pooled, not the storage of their
+  //! variable-size fields.
+  class MessagePool
+  {
+  public:
+    //! Allocate a block of the given size.
+    //! @param size block size in bytes.
+    //! @return allocated block.
+    static void*
+    allocate(size_t size);
+
+    //! Return a block to the pool of its size.
+    //! @param ptr block returned by allocate().
+    //! @param size size given to allocate().
+    static void
+    release(void* ptr, size_t size);
+
+    //! Set the maximum number of free blocks kept for each size in the shared
+    //! pools. Blocks released when a pool is full are returned to the system.
+    //! @param capacity maximum number of free blocks.
+    static void
+    setCapacity(size_t capacity);
+
+    //! Retrieve allocation statistics.
+    //! @param recycled number of allocations served by a pool (only counting
+    //! the calling thread and terminated threads).
+    //! @param allocated number of allocations served by the system.
+    static void
+    getStats(size_t& recycled, size_t& allocated);
+  };
+}
+
+#endif
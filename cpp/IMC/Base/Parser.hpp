@@ -21,6 +21,7 @@
 #define IMC_PARSER_HPP_INCLUDED_
 
 // ISO C++ headers.
+#include <algorithm>
 #include <vector>
 #include <queue>
 #include <set>
@@ -47,6 +48,7 @@ namespace IMC
       m_stage = PS_SYNC;
       m_pos = 0;
       m_buf.clear();
+      m_partial.clear();
     }
 
     //! Parse byte and return message if parsing of one message is done.
@@ -122,6 +124,163 @@ namespace IMC
       return m;
     }
 
+    //! Parse a contiguous buffer and append every complete message found to msgs.
+    //! Sync words are searched in bulk and complete messages are validated and
+    //! deserialized directly from the buffer. The beginning of a message cut at
+    //! the end of the buffer is kept until the next call completes it.
+    //! This entry point must not be mixed with parse(uint8_t) on the same parser.
+    //! @param data buffer.
+    //! @param size number of bytes in the buffer.
+    //! @param msgs vector to which parsed messages are appended.
+    //! @return number of bytes consumed, including the bytes of an
+    //! incomplete message kept for the next call.
+    size_t
+    parse(const uint8_t* data, size_t size, std::vector<Message*>& msgs)
+    {
+      size_t consumed = 0;
+
+      if (!m_partial.empty())
+      {
+        consumed = completePartial(data, size, msgs);
+        if (!m_partial.empty())
+          return size; // still incomplete
+      }
+
+      scan(data + consumed, size - consumed, msgs);
+      return size;
+    }
+
+  private:
+    //! Returns true if the two bytes are a sync word, in any byte order.
+    static bool
+    isSync(const uint8_t* bfr)
+    {
+      return (bfr[0] == 0xFE && bfr[1] == 0x54) || (bfr[0] == 0x54 && bfr[1] == 0xFE);
+    }
+
+    //! Size of a complete message from its header.
+    static size_t
+    messageSize(const Header& hdr)
+    {
+      return IMC_CONST_HEADER_SIZE + hdr.size + IMC_CONST_FOOTER_SIZE;
+    }
+
+    //! Scan a buffer for messages, keeping an incomplete one in m_partial.
+    void
+    scan(const uint8_t* data, size_t size, std::vector<Message*>& msgs)
+    {
+      size_t pos = 0;
+
+      while (pos < size)
+      {
+        // Bulk search of the first byte of a sync word.
+        const uint8_t* end = data + size;
+        const uint8_t* p = data + pos;
+        while (p < end && *p != 0xFE && *p != 0x54)
+          ++p;
+        pos = p - data;
+
+        if (pos + 1 >= size)
+        {
+          // A sync word may start on the last byte.
+          if (pos < size)
+            m_partial.assign(data + pos, end);
+          return;
+        }
+
+        if (!isSync(data + pos))
+        {
+          ++pos;
+          continue;
+        }
+
+        if (size - pos < IMC_CONST_HEADER_SIZE)
+        {
+          m_partial.assign(data + pos, end);
+          return;
+        }
+
+        Header hdr;
+        Packet::deserializeHeader(hdr, data + pos, size - pos);
+        const size_t n = messageSize(hdr);
+        if (size - pos < n)
+        {
+          m_partial.assign(data + pos, end);
+          return;
+        }
+
+        try
+        {
+          msgs.push_back(Packet::deserializePayload(hdr, data + pos, n, 0));
+          pos += n;
+        }
+        catch (...)
+        {
+          ++pos; // try to find sync again from the next byte
+        }
+      }
+    }
+
+    //! Complete the message kept in m_partial with the beginning of a buffer.
+    //! @return number of bytes of the buffer consumed.
+    size_t
+    completePartial(const uint8_t* data, size_t size, std::vector<Message*>& msgs)
+    {
+      size_t consumed = 0;
+
+      // Complete the sync word and the header.
+      if (m_partial.size() < IMC_CONST_HEADER_SIZE)
+      {
+        consumed = std::min(size, IMC_CONST_HEADER_SIZE - m_partial.size());
+        m_partial.insert(m_partial.end(), data, data + consumed);
+        if (m_partial.size() < IMC_CONST_HEADER_SIZE)
+        {
+          if (!isSync(&m_partial[0]) && m_partial.size() >= 2)
+            return resync(data, size, consumed, msgs);
+          return consumed;
+        }
+        if (!isSync(&m_partial[0]))
+          return resync(data, size, consumed, msgs);
+      }
+
+      Header hdr;
+      Packet::deserializeHeader(hdr, &m_partial[0], m_partial.size());
+      const size_t n = messageSize(hdr);
+
+      // Complete the payload.
+      const size_t missing = std::min(size - consumed, n - m_partial.size());
+      m_partial.insert(m_partial.end(), data + consumed, data + consumed + missing);
+      consumed += missing;
+      if (m_partial.size() < n)
+        return consumed;
+
+      try
+      {
+        msgs.push_back(Packet::deserializePayload(hdr, &m_partial[0], n, 0));
+      }
+      catch (...)
+      {
+        return resync(data, size, consumed, msgs);
+      }
+
+      m_partial.clear();
+      return consumed;
+    }
+
+    //! Discard the first byte of m_partial and scan the rest of it followed
+    //! by the rest of the buffer. Only used on invalid data.
+    //! @return number of bytes of the buffer consumed (all of them).
+    size_t
+    resync(const uint8_t* data, size_t size, size_t consumed, std::vector<Message*>& msgs)
+    {
+      std::vector<uint8_t> rest(m_partial.begin() + 1, m_partial.end());
+      rest.insert(rest.end(), data + consumed, data + size);
+      m_partial.clear();
+      if (!rest.empty())
+        scan(&rest[0], rest.size(), msgs);
+      return size;
+    }
+
   private:
     //! Parser stage constants.
     enum ParserStage
@@ -139,6 +298,8 @@ namespace IMC
     unsigned int m_pos;
     //! Holds parsed header (c_payload stage).
     Header m_header;
+    //! Beginning of an incomplete message (buffer parsing).
+    std::vector<uint8_t> m_partial;
   };
 }
 
@@ -24,8 +24,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "fire_data.hpp"
 
+#include <future>
+#include <numeric>
+#include <thread>
+
+#include "../ext/ThreadPool.hpp"
+
 namespace SAOP {
 
+    constexpr size_t FireData::queries_per_chunk;
+    constexpr size_t FireData::update_tile_size;
+
     opt<Cell> FireData::project_on_fire_front(const Cell& cell, double time) const {
         ASSERT(ignitions.is_in(cell));
         Cell proj = project_closest_to_fire_front(cell, time);
@@ -38,6 +47,17 @@ namespace SAOP {
     }
 
     Cell FireData::project_closest_to_fire_front(const Cell& cell, double time) const {
+        ASSERT(ignitions.is_in(cell));
+        if (front_index && !(time >= ignitions(cell) && time <= traversal_end(cell))) {
+            opt<Cell> closest = front_index->closest_on_fire_front(cell, time);
+            if (closest) {
+                return *closest;
+            }
+        }
+        return walk_to_fire_front(cell, time);
+    }
+
+    Cell FireData::walk_to_fire_front(const Cell& cell, double time) const {
         ASSERT(ignitions.is_in(cell));
         if (time >= ignitions(cell) && time <= traversal_end(cell)) {
             return cell;
@@ -87,7 +107,7 @@ namespace SAOP {
             if (!ignitions.is_in(next_cell) || !eventually_ignited(next_cell)) {
                 return cell;
             } else {
-                return project_closest_to_fire_front(next_cell, time);
+                return walk_to_fire_front(next_cell, time);
             }
         }
     }
@@ -106,6 +126,87 @@ namespace SAOP {
             return {};
     }
 
+    std::vector<opt<Segment3d>>
+    FireData::project_on_firefront(const std::vector<FrontProjectionQuery>& queries, ThreadPool* pool) const {
+        std::vector<opt<Segment3d>> projections(queries.size());
+
+        // cell of the visibility center of each query, none if outside of the raster
+        std::vector<opt<Cell>> cells(queries.size());
+        for (size_t i = 0; i < queries.size(); i++) {
+            const Waypoint3d center = queries[i].uav->visibility_center(queries[i].segment);
+            if (ignitions.is_in(center)) {
+                cells[i] = ignitions.as_cell(center);
+            }
+        }
+
+        // order queries by time, then by cell, so that queries projecting the same cell at the same time are
+        // consecutive and the cell is projected only once
+        std::vector<size_t> order(queries.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&queries, &cells](size_t a, size_t b) {
+            if (queries[a].time != queries[b].time) {
+                return queries[a].time < queries[b].time;
+            }
+            if (!cells[a] || !cells[b]) {
+                return !cells[a] && cells[b];
+            }
+            return cells[a]->y < cells[b]->y || (cells[a]->y == cells[b]->y && cells[a]->x < cells[b]->x);
+        });
+
+        // cell of the fire front on which each query is projected
+        std::vector<opt<Cell>> projected_cells(queries.size());
+
+        auto project_range = [this, &queries, &cells, &order, &projected_cells, &projections](size_t first,
+                                                                                             size_t last) {
+            for (size_t i = first; i < last; i++) {
+                const size_t q_id = order[i];
+                const FrontProjectionQuery& q = queries[q_id];
+                if (!cells[q_id]) {
+                    continue;
+                }
+                if (i > first && cells[order[i - 1]] && *cells[order[i - 1]] == *cells[q_id] &&
+                    queries[order[i - 1]].time == q.time) {
+                    // same cell and time as the previous query
+                    projected_cells[q_id] = projected_cells[order[i - 1]];
+                } else {
+                    projected_cells[q_id] = project_on_fire_front(*cells[q_id], q.time);
+                }
+                if (projected_cells[q_id]) {
+                    const Waypoint3d center = q.uav->visibility_center(q.segment);
+                    projections[q_id] = q.uav->observation_segment(ignitions.x_coords(projected_cells[q_id]->x),
+                                                                   ignitions.y_coords(projected_cells[q_id]->y),
+                                                                   center.z, q.segment.start.dir, q.segment.length);
+                }
+            }
+        };
+
+        if (!pool || queries.size() < 2 * queries_per_chunk) {
+            project_range(0, queries.size());
+        } else {
+            std::vector<std::future<void>> chunks;
+            for (size_t first = 0; first < queries.size(); first += queries_per_chunk) {
+                const size_t last = std::min(first + queries_per_chunk, queries.size());
+                chunks.push_back(pool->enqueue(project_range, first, last));
+            }
+            for (auto& chunk : chunks) {
+                chunk.get();
+            }
+        }
+        return projections;
+    }
+
+    std::vector<opt<Segment3d>>
+    FireData::project_on_firefront(const std::vector<Segment3d>& segments, const std::vector<double>& times,
+                                   const UAV& uav, ThreadPool* pool) const {
+        ASSERT(segments.size() == times.size());
+        std::vector<FrontProjectionQuery> queries;
+        queries.reserve(segments.size());
+        for (size_t i = 0; i < segments.size(); i++) {
+            queries.push_back({&uav, segments[i], times[i]});
+        }
+        return project_on_firefront(queries, pool);
+    }
+
     Segment3d FireData::project_closest_to_fire_front(const Segment3d& seg, const UAV& uav, double time) const {
         const Waypoint3d center = uav.visibility_center(seg);
         if (!ignitions.is_in(center))
@@ -123,9 +224,13 @@ namespace SAOP {
     DRaster FireData::compute_traversal_ends(const DRaster& ignitions) {
         DRaster ie(ignitions.x_width, ignitions.y_height, ignitions.x_offset, ignitions.y_offset,
                    ignitions.cell_width);
+        compute_traversal_ends(ignitions, ie, CellRect{0, 0, ignitions.x_width, ignitions.y_height});
+        return ie;
+    }
 
-        for (size_t x = 0; x < ignitions.x_width; x++) {
-            for (size_t y = 0; y < ignitions.y_height; y++) {
+    void FireData::compute_traversal_ends(const DRaster& ignitions, DRaster& ie, const CellRect& area) {
+        for (size_t y = area.y_min; y < area.y_max; y++) {
+            for (size_t x = area.x_min; x < area.x_max; x++) {
                 if (ignitions(x, y) < numeric_limits<double>::max() / 2) {
                     // cell is ignited
                     // find the neighbor with highest ignition time
@@ -153,14 +258,18 @@ namespace SAOP {
                 }
             }
         }
-        return ie;
     }
 
     DRaster FireData::compute_propagation_direction(const DRaster& ignitions) {
         DRaster pd(ignitions.x_width, ignitions.y_height, ignitions.x_offset, ignitions.y_offset,
                    ignitions.cell_width);
+        compute_propagation_direction(ignitions, pd, CellRect{0, 0, ignitions.x_width, ignitions.y_height});
+        return pd;
+    }
+
+    void FireData::compute_propagation_direction(const DRaster& ignitions, DRaster& pd, const CellRect& area) {
         /** Returns the ignitions time of (x+dx, y+dy). If it is out of the raster, or not ignited, it defaults to the ignition of (x,y).*/
-        auto default_ignition = [ignitions](size_t x, size_t y, int dx, int dy) {
+        auto default_ignition = [&ignitions](size_t x, size_t y, int dx, int dy) {
             const double def = ignitions(x, y);
             if (x == 0 && dx < 0) return def;
             if (x + dx >= ignitions.x_width) return def;
@@ -170,11 +279,11 @@ namespace SAOP {
             return ignitions(x + dx, y + dy);
         };
 
-        for (size_t x = 0; x < ignitions.x_width; x++) {
-            for (size_t y = 0; y < ignitions.y_height; y++) {
+        for (size_t y = area.y_min; y < area.y_max; y++) {
+            for (size_t x = area.x_min; x < area.x_max; x++) {
                 if (ignitions(x, y) < numeric_limits<double>::max() / 2) {
                     // cell is ignited, compute slope
-                    auto ign = [x, y, default_ignition](int dx, int dy) { return default_ignition(x, y, dx, dy); };
+                    auto ign = [x, y, &default_ignition](int dx, int dy) { return default_ignition(x, y, dx, dy); };
                     const double prop_dx =
                             ign(1, -1) + 2 * ign(1, 0) + ign(1, 1) - ign(-1, -1) - 2 * ign(-1, 0) - ign(-1, 1);
                     const double prop_dy =
@@ -187,7 +296,150 @@ namespace SAOP {
                 }
             }
         }
-        return pd;
+    }
+
+    void FireData::compute_front_duration_bounds() {
+        // min and max durations, ignoring cells that are never ignited
+        min_ign_duration = std::numeric_limits<double>::infinity();
+        max_ign_duration = 0.;
+        for (size_t i = 0; i < ignitions.data.size(); i++) {
+            if (ignitions.data[i] < numeric_limits<double>::max() / 2) {
+                const double duration = traversal_end.data[i] - ignitions.data[i];
+                min_ign_duration = std::min(min_ign_duration, duration);
+                max_ign_duration = std::max(max_ign_duration, duration);
+            }
+        }
+    }
+
+    shared_ptr<FireData>
+    FireData::updated(const DRaster& new_ignitions, const std::vector<CellRect>& changed_areas) const {
+        ASSERT(new_ignitions.x_width == ignitions.x_width && new_ignitions.y_height == ignitions.y_height);
+        ASSERT(new_ignitions.x_offset == ignitions.x_offset && new_ignitions.y_offset == ignitions.y_offset);
+        ASSERT(new_ignitions.cell_width == ignitions.cell_width);
+
+        std::vector<CellRect> areas;
+        std::vector<CellRect> halos;
+        for (const CellRect& changed : changed_areas) {
+            const CellRect area = changed.expanded(0, ignitions.x_width, ignitions.y_height);
+            if (area.empty()) {
+                continue;
+            }
+            areas.push_back(area);
+            // traversal ends and propagation directions depend on the 8 neighbors of each cell
+            halos.push_back(area.expanded(1, ignitions.x_width, ignitions.y_height));
+        }
+        return shared_ptr<FireData>(new FireData(*this, new_ignitions, areas, halos));
+    }
+
+    shared_ptr<FireData> FireData::updated(const DRaster& new_ignitions) const {
+        ASSERT(new_ignitions.x_width == ignitions.x_width && new_ignitions.y_height == ignitions.y_height);
+        std::vector<CellRect> changed_tiles;
+        for (size_t y0 = 0; y0 < ignitions.y_height; y0 += update_tile_size) {
+            for (size_t x0 = 0; x0 < ignitions.x_width; x0 += update_tile_size) {
+                const CellRect tile{x0, y0, std::min(x0 + update_tile_size, ignitions.x_width),
+                                    std::min(y0 + update_tile_size, ignitions.y_height)};
+                bool changed = false;
+                for (size_t y = tile.y_min; y < tile.y_max && !changed; y++) {
+                    const size_t row = ignitions.x_width * y;
+                    changed = !std::equal(ignitions.data.begin() + row + tile.x_min,
+                                          ignitions.data.begin() + row + tile.x_max,
+                                          new_ignitions.data.begin() + row + tile.x_min);
+                }
+                if (changed) {
+                    changed_tiles.push_back(tile);
+                }
+            }
+        }
+        return updated(new_ignitions, changed_tiles);
+    }
+
+    FireData::FireData(const FireData& base, const DRaster& new_ignitions, const std::vector<CellRect>& areas,
+                       const std::vector<CellRect>& halos)
+            : ignitions(replaced_in_areas(base.ignitions, new_ignitions, areas)),
+              traversal_end(updated_traversal_ends(ignitions, base.traversal_end, halos)),
+              propagation_directions(updated_propagation_directions(ignitions, base.propagation_directions, halos)),
+              elevation(base.elevation),
+              max_ign_duration(base.max_ign_duration),
+              min_ign_duration(base.min_ign_duration) {
+        auto is_ignited = [](double ign) { return ign < numeric_limits<double>::max() / 2; };
+
+        // if a cell holding the previous min or max duration is updated, the bounds must be recomputed entirely
+        bool full_bounds_update = false;
+        for (const CellRect& halo : halos) {
+            for (size_t y = halo.y_min; y < halo.y_max && !full_bounds_update; y++) {
+                for (size_t x = halo.x_min; x < halo.x_max; x++) {
+                    if (is_ignited(base.ignitions(x, y))) {
+                        const double duration = base.traversal_end(x, y) - base.ignitions(x, y);
+                        if (duration == base.min_ign_duration || duration == base.max_ign_duration) {
+                            full_bounds_update = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (full_bounds_update) {
+            compute_front_duration_bounds();
+        } else {
+            for (const CellRect& halo : halos) {
+                for (size_t y = halo.y_min; y < halo.y_max; y++) {
+                    for (size_t x = halo.x_min; x < halo.x_max; x++) {
+                        if (is_ignited(ignitions(x, y))) {
+                            const double duration = traversal_end(x, y) - ignitions(x, y);
+                            min_ign_duration = std::min(min_ign_duration, duration);
+                            max_ign_duration = std::max(max_ign_duration, duration);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (base.front_index) {
+            if (halos.empty()) {
+                front_index = base.front_index;
+            } else {
+                auto index = make_shared<FireFrontIndex>(*base.front_index);
+                index->update(ignitions, traversal_end, halos);
+                front_index = index;
+            }
+        }
+        if (base.ignition_counts_index) {
+            if (halos.empty()) {
+                ignition_counts_index = base.ignition_counts_index;
+            } else {
+                ignition_counts_index = make_shared<const IgnitionCounts>(*base.ignition_counts_index,
+                                                                          base.ignitions, ignitions, areas);
+            }
+        }
+    }
+
+    DRaster FireData::replaced_in_areas(const DRaster& ignitions, const DRaster& new_ignitions,
+                                        const std::vector<CellRect>& areas) {
+        DRaster replaced = ignitions;
+        for (const CellRect& area : areas) {
+            for (size_t y = area.y_min; y < area.y_max; y++) {
+                for (size_t x = area.x_min; x < area.x_max; x++) {
+                    replaced.set(x, y, new_ignitions(x, y));
+                }
+            }
+        }
+        return replaced;
+    }
+
+    DRaster FireData::updated_traversal_ends(const DRaster& ignitions, DRaster traversal_ends,
+                                             const std::vector<CellRect>& areas) {
+        for (const CellRect& area : areas) {
+            compute_traversal_ends(ignitions, traversal_ends, area);
+        }
+        return traversal_ends;
+    }
+
+    DRaster FireData::updated_propagation_directions(const DRaster& ignitions, DRaster directions,
+                                                     const std::vector<CellRect>& areas) {
+        for (const CellRect& area : areas) {
+            compute_propagation_direction(ignitions, directions, area);
+        }
+        return directions;
     }
 
     opt<Cell> FireData::next_in_propagation_direction(const Cell& cell) const {
@@ -30,9 +30,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <iostream>
 #include <set>
 
+#include "../ext/ThreadPool.hpp"
 #include "../ext/optional.hpp"
 #include "../utils.hpp"
+#include "fire_front_index.hpp"
 #include "raster.hpp"
+#include "summed_area.hpp"
 #include "uav.hpp"
 #include "waypoint.hpp"
 
@@ -40,6 +43,13 @@ using namespace std;
 
 namespace SAOP {
 
+    /** A segment to project on the fire front of the given time, as observed by the given UAV. */
+    struct FrontProjectionQuery {
+        const UAV* uav;
+        Segment3d segment;
+        double time;
+    };
+
     class FireData {
     public:
         /** Time at which the firefront reaches each cell.
@@ -60,30 +70,7 @@ namespace SAOP {
                   traversal_end(compute_traversal_ends(ignition_raster)),
                   propagation_directions(compute_propagation_direction(ignition_raster)),
                   elevation(make_shared<DRaster>(elevation_raster)) {
-
-            std::vector<double> durations(ignitions.data.size());
-            // compute ignition duration
-            std::transform(traversal_end.begin(), traversal_end.end(), ignitions.begin(), durations.begin(),
-                           [](double a, double b) {
-                               // Minus (ignoring non-ignited)
-                               return b >= numeric_limits<double>::max() / 2 ?
-                                      std::numeric_limits<double>::signaling_NaN() : a - b;
-                           });
-            // Find min and max durations
-            std::pair<double, double> min_max = std::accumulate(
-                    durations.begin(), durations.end(),
-                    std::pair<double, double>({std::numeric_limits<double>::infinity(), .0}),
-                    [](std::pair<double, double> a, double b) -> std::pair<double, double> {
-                        // Accumulate min and max if b is eventually ignited (!NaN)
-                        if (isnan(b)) {
-                            return a;
-                        } else {
-                            return {std::min<double>(std::get<0>(a), b),
-                                    std::max<double>(std::get<1>(a), b)};
-                        }
-                    });
-            min_ign_duration = std::get<0>(min_max);
-            max_ign_duration = std::get<1>(min_max);
+            compute_front_duration_bounds();
         }
 
         FireData(const FireData& from) = default;
@@ -114,9 +101,54 @@ namespace SAOP {
         /** Lookup a cell that ignited at `time`. Returns an empty option if no such cell was found. */
         opt<Cell> project_on_fire_front(const Cell& cell, double time) const;
 
-        /** Finds the closest cell from the fire front of the given time by going up or down the propagation slope.*/
+        /** Finds the closest cell from the fire front of the given time.
+         *
+         * If the fire front was indexed (see index_fire_front), this is the closest burning cell at the given time.
+         * Otherwise, or if no cell is burning at this time, this is done by going up or down the propagation slope.*/
         Cell project_closest_to_fire_front(const Cell& cell, double time) const;
 
+        /** Builds an index of the fire front, used to speed up projections on the fire front.
+         * 'bin_duration' is the time resolution (in seconds) of the index. */
+        void index_fire_front(double bin_duration, size_t bucket_cells = 8) {
+            front_index = make_shared<FireFrontIndex>(ignitions, traversal_end, bin_duration, bucket_cells);
+        }
+
+        /** Builds prefix counts of the ignited cells, binned every 'bin_duration' seconds, to bound the number of
+         * cells igniting in an area during a time interval in constant time (see IgnitionCounts).
+         * The counts are built on 'num_threads' threads (0 for one thread per hardware core). */
+        void index_ignition_counts(double bin_duration, size_t num_threads = 0) {
+            if (num_threads == 0) {
+                num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            }
+            ignition_counts_index = make_shared<const IgnitionCounts>(ignitions, bin_duration, num_threads);
+        }
+
+        /** FireData where the ignition times in the given areas are replaced by the ones of 'new_ignitions'.
+         *
+         * Derived layers (traversal ends, propagation directions, front durations and fire front index) are
+         * recomputed only around the changed areas, with the same result as building a new FireData from
+         * the updated ignitions. Ignition counts, if any, keep the same bins and only rebuild the tables of the
+         * bins in which cells changed.
+         * Cells of 'new_ignitions' outside of the given areas are ignored.
+         *
+         * This FireData is left untouched: plans using it stay consistent until they are given the updated one
+         * (see Plan::firedata()). */
+        shared_ptr<FireData> updated(const DRaster& new_ignitions, const std::vector<CellRect>& changed_areas) const;
+
+        /** FireData with the ignition raster replaced by 'new_ignitions', recomputing derived layers only in the
+         * tiles where ignition times changed. */
+        shared_ptr<FireData> updated(const DRaster& new_ignitions) const;
+
+        /** Index of the fire front, null if index_fire_front was not called. */
+        shared_ptr<const FireFrontIndex> fire_front_index() const {
+            return front_index;
+        }
+
+        /** Prefix counts of ignited cells, null if index_ignition_counts was not called. */
+        shared_ptr<const IgnitionCounts> ignition_counts() const {
+            return ignition_counts_index;
+        }
+
         /** Returns a segment whose visibility center is on cell on the firefront of the given time.
          *
          * This essentially projects a segment on the firefront, non-touching its orientation.
@@ -131,16 +163,69 @@ namespace SAOP {
          **/
         Segment3d project_closest_to_fire_front(const Segment3d& seg, const UAV& uav, double time) const;
 
+        /** Batched version of project_on_firefront(seg, uav, time): the i-th element of the result is the projection
+         * of the i-th query.
+         *
+         * Queries projecting the same cell at the same time share a single projection on the fire front.
+         * If a thread pool is given, large batches are split among its workers.
+         **/
+        std::vector<opt<Segment3d>>
+        project_on_firefront(const std::vector<FrontProjectionQuery>& queries, ThreadPool* pool = nullptr) const;
+
+        /** Projects all segments (the i-th at times[i]) on the fire front, as observed by the given UAV. */
+        std::vector<opt<Segment3d>>
+        project_on_firefront(const std::vector<Segment3d>& segments, const std::vector<double>& times,
+                             const UAV& uav, ThreadPool* pool = nullptr) const;
+
     private:
         double max_ign_duration;
         double min_ign_duration;
 
+        shared_ptr<const FireFrontIndex> front_index = nullptr;
+
+        shared_ptr<const IgnitionCounts> ignition_counts_index = nullptr;
+
+        /** Number of queries of a batch projection handled by each task of the thread pool. */
+        static constexpr size_t queries_per_chunk = 256;
+
+        /** Copy of 'base' with the ignitions of 'new_ignitions' in 'areas', see updated().
+         * 'halos' are the areas extended by one cell, where derived layers are recomputed. */
+        FireData(const FireData& base, const DRaster& new_ignitions, const std::vector<CellRect>& areas,
+                 const std::vector<CellRect>& halos);
+
+        /** Walks up or down the propagation slope until reaching the fire front of the given time. */
+        Cell walk_to_fire_front(const Cell& cell, double time) const;
+
+        /** Side of the square tiles compared to find changed areas when updating from a full ignition raster. */
+        static constexpr size_t update_tile_size = 64;
+
         /** Builds a raster containing the times at which the firefront leaves the cells. */
         static DRaster compute_traversal_ends(const DRaster& ignitions);
 
+        /** Copy of 'ignitions' with the values in 'areas' taken from 'new_ignitions'. */
+        static DRaster replaced_in_areas(const DRaster& ignitions, const DRaster& new_ignitions,
+                                         const std::vector<CellRect>& areas);
+
+        /** Copy of 'traversal_ends' with the values in 'areas' recomputed from 'ignitions'. */
+        static DRaster updated_traversal_ends(const DRaster& ignitions, DRaster traversal_ends,
+                                              const std::vector<CellRect>& areas);
+
+        /** Copy of 'directions' with the values in 'areas' recomputed from 'ignitions'. */
+        static DRaster updated_propagation_directions(const DRaster& ignitions, DRaster directions,
+                                                      const std::vector<CellRect>& areas);
+
+        /** Computes the traversal ends of the cells in the given area. */
+        static void compute_traversal_ends(const DRaster& ignitions, DRaster& traversal_ends, const CellRect& area);
+
         /** Computes local fire propagation direction. This is done by looking at the ignitions raster as an elevation raster
          * and finding main raising direction as it is done for computing slope.*/
         static DRaster compute_propagation_direction(const DRaster& ignitions);
+
+        /** Computes the propagation directions of the cells in the given area. */
+        static void compute_propagation_direction(const DRaster& ignitions, DRaster& directions, const CellRect& area);
+
+        /** Computes min_ign_duration and max_ign_duration over the whole raster. */
+        void compute_front_duration_bounds();
     };
 }
 #endif //PLANNING_CPP_FIRE_DATA_H
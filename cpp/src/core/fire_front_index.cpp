@@ -0,0 +1,226 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "fire_front_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace SAOP {
+
+    FireFrontIndex::FireFrontIndex(const DRaster& ignitions, const DRaster& traversal_end, double bin_duration,
+                                   size_t bucket_cells)
+            : _bin_duration(bin_duration), bucket_cells(bucket_cells),
+              x_buckets((ignitions.x_width + bucket_cells - 1) / bucket_cells),
+              y_buckets((ignitions.y_height + bucket_cells - 1) / bucket_cells),
+              start_time(std::numeric_limits<double>::infinity()), max_burning_duration(0) {
+        ASSERT(bin_duration > 0);
+        ASSERT(bucket_cells > 0);
+        ASSERT(ignitions.x_width == traversal_end.x_width && ignitions.y_height == traversal_end.y_height);
+
+        double last_ignition = -std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < ignitions.data.size(); i++) {
+            if (is_ignited(ignitions.data[i])) {
+                start_time = std::min(start_time, ignitions.data[i]);
+                last_ignition = std::max(last_ignition, ignitions.data[i]);
+            }
+        }
+        if (start_time > last_ignition) {
+            // nothing is ever ignited
+            return;
+        }
+
+        bins = std::vector<std::vector<Entry>>(bin_of(last_ignition) + 1);
+        bins_latest_end = std::vector<double>(bins.size(), -std::numeric_limits<double>::infinity());
+        for (size_t y = 0; y < ignitions.y_height; y++) {
+            for (size_t x = 0; x < ignitions.x_width; x++) {
+                if (!is_ignited(ignitions(x, y))) {
+                    continue;
+                }
+                const Entry e = entry(ignitions, traversal_end, x, y);
+                const size_t b = bin_of(e.ignition);
+                bins[b].push_back(e);
+                bins_latest_end[b] = std::max(bins_latest_end[b], e.traversal_end);
+                max_burning_duration = std::max(max_burning_duration, e.traversal_end - e.ignition);
+            }
+        }
+        for (auto& bin : bins) {
+            std::sort(bin.begin(), bin.end());
+            bin.shrink_to_fit();
+        }
+    }
+
+    void FireFrontIndex::update(const DRaster& ignitions, const DRaster& traversal_end,
+                                const std::vector<CellRect>& areas) {
+        auto in_area = [](const CellRect& area, size_t x, size_t y) {
+            return area.x_min <= x && x < area.x_max && area.y_min <= y && y < area.y_max;
+        };
+        // area of the cell (x, y) is the first of 'areas' containing it.
+        auto first_area_of = [&areas, &in_area](size_t x, size_t y) {
+            size_t i = 0;
+            while (!in_area(areas[i], x, y)) {
+                i++;
+            }
+            return i;
+        };
+
+        // new entries of the updated areas, each cell being taken only once
+        std::vector<Entry> added;
+        for (size_t i = 0; i < areas.size(); i++) {
+            for (size_t y = areas[i].y_min; y < areas[i].y_max; y++) {
+                for (size_t x = areas[i].x_min; x < areas[i].x_max; x++) {
+                    if (is_ignited(ignitions(x, y)) && first_area_of(x, y) == i) {
+                        added.push_back(entry(ignitions, traversal_end, x, y));
+                    }
+                }
+            }
+        }
+        for (const Entry& e : added) {
+            if (bins.empty()) {
+                *this = FireFrontIndex(ignitions, traversal_end, _bin_duration, bucket_cells);
+                return;
+            }
+            if (e.ignition < start_time) {
+                // extend the time range of the index with empty bins at the beginning
+                const size_t num_new_bins = (size_t) std::ceil((start_time - e.ignition) / _bin_duration);
+                bins.insert(bins.begin(), num_new_bins, std::vector<Entry>());
+                bins_latest_end.insert(bins_latest_end.begin(), num_new_bins,
+                                       -std::numeric_limits<double>::infinity());
+                start_time -= num_new_bins * _bin_duration;
+            }
+            if (bin_of(e.ignition) >= bins.size()) {
+                bins.resize(bin_of(e.ignition) + 1);
+                bins_latest_end.resize(bins.size(), -std::numeric_limits<double>::infinity());
+            }
+        }
+        std::sort(added.begin(), added.end());
+
+        for (auto& bin : bins) {
+            // remove entries of the updated areas, only looking at the buckets they overlap
+            for (const CellRect& area : areas) {
+                if (area.empty()) {
+                    continue;
+                }
+                const size_t bx_min = area.x_min / bucket_cells;
+                const size_t bx_max = (area.x_max - 1) / bucket_cells;
+                for (size_t by = area.y_min / bucket_cells; by <= (area.y_max - 1) / bucket_cells; by++) {
+                    const Entry first_key{(uint32_t) (bx_min + by * x_buckets), 0, 0, 0., 0.};
+                    const Entry last_key{(uint32_t) (bx_max + by * x_buckets + 1), 0, 0, 0., 0.};
+                    auto first = std::lower_bound(bin.begin(), bin.end(), first_key);
+                    auto last = std::lower_bound(first, bin.end(), last_key);
+                    auto removed = std::remove_if(first, last, [&area, &in_area](const Entry& e) {
+                        return in_area(area, e.x, e.y);
+                    });
+                    bin.erase(removed, last);
+                }
+            }
+        }
+
+        // insert new entries, keeping each bin sorted.
+        // Bounds of the traversal ends and burning durations are only raised: removed cells might leave them loose
+        std::vector<std::vector<Entry>> added_by_bin(bins.size());
+        for (const Entry& e : added) {
+            const size_t b = bin_of(e.ignition);
+            added_by_bin[b].push_back(e);
+            bins_latest_end[b] = std::max(bins_latest_end[b], e.traversal_end);
+            max_burning_duration = std::max(max_burning_duration, e.traversal_end - e.ignition);
+        }
+        for (size_t b = 0; b < bins.size(); b++) {
+            if (!added_by_bin[b].empty()) {
+                const size_t previous_size = bins[b].size();
+                bins[b].insert(bins[b].end(), added_by_bin[b].begin(), added_by_bin[b].end());
+                std::inplace_merge(bins[b].begin(), bins[b].begin() + previous_size, bins[b].end());
+            }
+        }
+    }
+
+    opt<Cell> FireFrontIndex::closest_on_fire_front(const Cell& cell, double time) const {
+        if (bins.empty() || time < start_time) {
+            return {};
+        }
+        // bins of the cells that might be burning at this time
+        std::vector<const std::vector<Entry>*> burning_bins;
+        const size_t last_bin = std::min(bin_of(time), bins.size() - 1);
+        for (size_t b = bin_of(time - max_burning_duration); b <= last_bin; b++) {
+            if (!bins[b].empty() && bins_latest_end[b] >= time) {
+                burning_bins.push_back(&bins[b]);
+            }
+        }
+        if (burning_bins.empty()) {
+            return {};
+        }
+
+        const long qbx = (long) (cell.x / bucket_cells);
+        const long qby = (long) (cell.y / bucket_cells);
+        const long max_ring = (long) std::max(x_buckets, y_buckets);
+
+        opt<Cell> best = {};
+        double best_dist_sq = std::numeric_limits<double>::infinity();
+
+        auto visit_bucket = [&](long bx, long by) {
+            if (bx < 0 || by < 0 || bx >= (long) x_buckets || by >= (long) y_buckets) {
+                return;
+            }
+            const Entry key{(uint32_t) (bx + by * x_buckets), 0, 0, 0., 0.};
+            for (const std::vector<Entry>* bin : burning_bins) {
+                auto it = std::lower_bound(bin->begin(), bin->end(), key);
+                for (; it != bin->end() && it->bucket == key.bucket; ++it) {
+                    if (it->ignition <= time && time <= it->traversal_end) {
+                        const double dx = (double) it->x - (double) cell.x;
+                        const double dy = (double) it->y - (double) cell.y;
+                        const double d = dx * dx + dy * dy;
+                        // ties are broken on the position, whatever the order of the bins and buckets
+                        if (d < best_dist_sq || (d == best_dist_sq &&
+                                                 (it->y < best->y || (it->y == best->y && it->x < best->x)))) {
+                            best_dist_sq = d;
+                            best = Cell{it->x, it->y};
+                        }
+                    }
+                }
+            }
+        };
+
+        for (long ring = 0; ring <= max_ring; ring++) {
+            // cells of this ring are at least (ring - 1) buckets away from the query cell
+            const double min_dist = (double) std::max(ring - 1, 0L) * bucket_cells;
+            if (best && min_dist * min_dist > best_dist_sq) {
+                break;
+            }
+            if (ring == 0) {
+                visit_bucket(qbx, qby);
+                continue;
+            }
+            for (long d = -ring; d <= ring; d++) {
+                visit_bucket(qbx + d, qby - ring);
+                visit_bucket(qbx + d, qby + ring);
+            }
+            for (long d = -ring + 1; d <= ring - 1; d++) {
+                visit_bucket(qbx - ring, qby + d);
+                visit_bucket(qbx + ring, qby + d);
+            }
+        }
+        return best;
+    }
+}
@@ -0,0 +1,110 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_FIRE_FRONT_INDEX_H
+#define PLANNING_CPP_FIRE_FRONT_INDEX_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../ext/optional.hpp"
+#include "../utils.hpp"
+#include "raster.hpp"
+
+namespace SAOP {
+
+    /** Index of the cells on the fire front, to find the closest cell burning at a given time.
+     *
+     * Time is divided in bins of fixed duration. Each cell is recorded once, in the bin of its ignition time.
+     * The cells burning at a given time (between their ignition and traversal end) are thus found in the bins
+     * spanning the longest burning duration of a cell before this time, skipping the bins whose cells all stopped
+     * burning earlier.
+     * In each bin, cells are sorted by the square bucket of 'bucket_cells' x 'bucket_cells' cells they fall in,
+     * so that the cells of a bucket are found by binary search. A query explores buckets in rings of increasing
+     * size around the query cell until no closer cell can be found.
+     */
+    class FireFrontIndex {
+    public:
+        FireFrontIndex(const DRaster& ignitions, const DRaster& traversal_end, double bin_duration,
+                       size_t bucket_cells = 8);
+
+        /** Closest cell (in euclidean distance) that is burning at the given time,
+         * i.e., ignitions(c) <= time <= traversal_end(c). Ties are broken by row, then by column.
+         * Returns an empty option if there is no such cell. */
+        opt<Cell> closest_on_fire_front(const Cell& cell, double time) const;
+
+        /** Updates the index after the ignitions or traversal ends changed in the given areas.
+         * Queries then give the same results as on a new index built from the updated rasters. */
+        void update(const DRaster& ignitions, const DRaster& traversal_end, const std::vector<CellRect>& areas);
+
+        double bin_duration() const { return _bin_duration; }
+
+        size_t bucket_size() const { return bucket_cells; }
+
+    private:
+        struct Entry {
+            uint32_t bucket;
+            uint32_t x;
+            uint32_t y;
+            double ignition;
+            double traversal_end;
+
+            /* Sorted by bucket, then by row and column for a deterministic order inside a bucket. */
+            bool operator<(const Entry& other) const {
+                return bucket < other.bucket ||
+                       (bucket == other.bucket && (y < other.y || (y == other.y && x < other.x)));
+            }
+        };
+
+        double _bin_duration;
+        size_t bucket_cells;
+        size_t x_buckets;
+        size_t y_buckets;
+        double start_time;
+        /* Upper bound of the time during which a cell of the index is burning */
+        double max_burning_duration;
+
+        /* Cells igniting during each time bin, sorted by bucket. */
+        std::vector<std::vector<Entry>> bins;
+        /* Upper bound of the traversal ends of the cells of each bin. */
+        std::vector<double> bins_latest_end;
+
+        bool is_ignited(double ignition) const {
+            return ignition < std::numeric_limits<double>::max() / 2;
+        }
+
+        Entry entry(const DRaster& ignitions, const DRaster& traversal_end, size_t x, size_t y) const {
+            return Entry{(uint32_t) (x / bucket_cells + (y / bucket_cells) * x_buckets),
+                         (uint32_t) x, (uint32_t) y, ignitions(x, y), traversal_end(x, y)};
+        }
+
+        /* Time bin containing the given time. Only valid for times in the range of the index. */
+        size_t bin_of(double time) const {
+            return time <= start_time ? 0 : (size_t) ((time - start_time) / _bin_duration);
+        }
+    };
+}
+
+#endif //PLANNING_CPP_FIRE_FRONT_INDEX_H
@@ -0,0 +1,157 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_FOOTPRINT_CACHE_HPP
+#define PLANNING_CPP_FOOTPRINT_CACHE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "raster.hpp"
+#include "waypoint.hpp"
+
+namespace SAOP {
+
+    /** Pre-rasterized footprints of a sensor on a grid, to replace RasterMapper::segment_trace for short segments.
+     *
+     * On a given grid, the cells traced for a segment of given length only depend on its heading and on the
+     * position of its start inside its cell (sub-cell phase). Footprints are traced once for a discrete set of
+     * headings and phases and stored as spans of cells relative to the cell of the segment start.
+     * Tracing a segment then consists in translating the stamp of the closest heading and phase.
+     * Segments whose length differs from the one of the stamps are traced exactly with
+     * RasterMapper::segment_trace.
+     */
+    class FootprintStampCache {
+    public:
+        /** Builds stamps for segments of length 'segment_length' observed with a view_width x view_depth sensor,
+         * on a grid of cells of width 'cell_width'. */
+        FootprintStampCache(double view_width, double view_depth, double cell_width, double segment_length = 1.,
+                            size_t heading_bins = 360, size_t phase_bins = 8)
+                : view_width(view_width), view_depth(view_depth), cell_width(cell_width),
+                  segment_length(segment_length), heading_bins(heading_bins), phase_bins(phase_bins) {
+            ASSERT(heading_bins > 0 && phase_bins > 0);
+            // canonical raster centered on cell (0, 0), large enough to contain any footprint
+            const double extent = std::sqrt(std::pow(view_width, 2) + std::pow(view_depth + segment_length, 2));
+            const long radius = (long) std::ceil(extent / cell_width) + 2;
+            const DRaster canvas((size_t) (2 * radius + 1), (size_t) (2 * radius + 1),
+                                 -radius * cell_width, -radius * cell_width, cell_width);
+
+            stamps.reserve(heading_bins * phase_bins * phase_bins);
+            for (size_t h = 0; h < heading_bins; h++) {
+                for (size_t py = 0; py < phase_bins; py++) {
+                    for (size_t px = 0; px < phase_bins; px++) {
+                        const Waypoint3d start{phase_of_bin(px), phase_of_bin(py), 0.,
+                                               (h + 0.5) * 2 * M_PI / heading_bins};
+                        const Segment3d canonical{start, segment_length};
+                        stamps.push_back(as_spans(*RasterMapper::segment_trace(canonical, view_width, view_depth,
+                                                                               canvas), radius));
+                    }
+                }
+            }
+        }
+
+        /** True if the stamps were built for this sensor and grid. */
+        bool is_for(double view_width, double view_depth, double cell_width) const {
+            return this->view_width == view_width && this->view_depth == view_depth && this->cell_width == cell_width;
+        }
+
+        /** Cells of the raster seen from the segment, as RasterMapper::segment_trace. */
+        template<typename GenRaster>
+        std::vector<Cell> trace(const Segment3d& segment, const GenRaster& raster) const {
+            ASSERT(raster.cell_width == cell_width);
+            if (std::abs(segment.length - segment_length) > 1e-6 || !raster.is_in(segment.start)) {
+                // elongated segment or start out of the raster, no stamp for it
+                return *RasterMapper::segment_trace(segment, view_width, view_depth, raster);
+            }
+            const Cell origin = raster.as_cell(segment.start);
+            const size_t px = bin_of_phase(segment.start.x - raster.x_coords(origin.x));
+            const size_t py = bin_of_phase(segment.start.y - raster.y_coords(origin.y));
+            const double dir = positive_modulo(segment.start.dir, 2 * M_PI);
+            const size_t h = std::min((size_t) (dir / (2 * M_PI) * heading_bins), heading_bins - 1);
+
+            std::vector<Cell> cells;
+            for (const Span& span : stamps[(h * phase_bins + py) * phase_bins + px]) {
+                const long y = (long) origin.y + span.dy;
+                if (y < 0 || y >= (long) raster.y_height) {
+                    continue;
+                }
+                const long x_min = std::max(0L, (long) origin.x + span.dx_min);
+                const long x_max = std::min((long) raster.x_width - 1, (long) origin.x + span.dx_max);
+                for (long x = x_min; x <= x_max; x++) {
+                    cells.emplace_back((size_t) x, (size_t) y);
+                }
+            }
+            return cells;
+        }
+
+    private:
+        /** Cells [dx_min, dx_max] of row dy, relative to the cell of the segment start. */
+        struct Span {
+            long dy;
+            long dx_min;
+            long dx_max;
+        };
+
+        double view_width;
+        double view_depth;
+        double cell_width;
+        double segment_length;
+        size_t heading_bins;
+        size_t phase_bins;
+
+        /** Spans of each stamp, indexed by (heading, y phase, x phase). */
+        std::vector<std::vector<Span>> stamps;
+
+        /** Position of a segment start in its cell, for a given bin. */
+        double phase_of_bin(size_t bin) const {
+            return ((bin + 0.5) / phase_bins - 0.5) * cell_width;
+        }
+
+        size_t bin_of_phase(double phase) const {
+            const long bin = (long) std::floor((phase / cell_width + 0.5) * phase_bins);
+            return (size_t) std::min(std::max(bin, 0L), (long) phase_bins - 1);
+        }
+
+        /** Groups cells of the canonical raster into spans relative to its center cell (radius, radius). */
+        static std::vector<Span> as_spans(std::vector<Cell> cells, long radius) {
+            std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+                return a.y < b.y || (a.y == b.y && a.x < b.x);
+            });
+            std::vector<Span> spans;
+            for (const Cell& c : cells) {
+                const long dx = (long) c.x - radius;
+                const long dy = (long) c.y - radius;
+                if (!spans.empty() && spans.back().dy == dy && spans.back().dx_max + 1 == dx) {
+                    spans.back().dx_max = dx;
+                } else {
+                    spans.push_back(Span{dy, dx, dx});
+                }
+            }
+            return spans;
+        }
+    };
+}
+
+#endif //PLANNING_CPP_FOOTPRINT_CACHE_HPP
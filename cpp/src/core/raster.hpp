@@ -25,6 +25,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #ifndef PLANNING_CPP_RASTER_H
 #define PLANNING_CPP_RASTER_H
 
+#include <algorithm>
 #include <valarray>
 #include <stdexcept>
 #include <unordered_set>
@@ -60,6 +61,26 @@ namespace SAOP {
         }
     };
 
+    /** Rectangular area of a raster, from (x_min, y_min) included to (x_max, y_max) excluded. */
+    struct CellRect final {
+        size_t x_min;
+        size_t y_min;
+        size_t x_max;
+        size_t y_max;
+
+        bool empty() const { return x_min >= x_max || y_min >= y_max; }
+
+        /** Area extended by 'margin' cells in every direction, clipped to a raster of the given size. */
+        CellRect expanded(size_t margin, size_t x_width, size_t y_height) const {
+            return CellRect{x_min > margin ? x_min - margin : 0, y_min > margin ? y_min - margin : 0,
+                            std::min(x_max + margin, x_width), std::min(y_max + margin, y_height)};
+        }
+
+        friend std::ostream& operator<<(std::ostream& stream, const CellRect& r) {
+            return stream << "[" << r.x_min << ", " << r.x_max << ")x[" << r.y_min << ", " << r.y_max << ")";
+        }
+    };
+
     struct CellHash {
         size_t operator()(const Cell& x) const noexcept {
             return std::hash<size_t>()(x.x) ^ std::hash<size_t>()(x.y);
@@ -88,6 +109,19 @@ namespace SAOP {
                 : GenRaster<T>(std::vector<T>(x_width * y_height, 0), x_width, y_height, x_offset, y_offset,
                                cell_width) {}
 
+        /** Copy of the cells of the given area, with the offsets of its first cell. */
+        GenRaster<T> sub_raster(const CellRect& area) const {
+            ASSERT(area.x_max <= x_width && area.y_max <= y_height && !area.empty());
+            std::vector<T> sub_data;
+            sub_data.reserve((area.x_max - area.x_min) * (area.y_max - area.y_min));
+            for (size_t y = area.y_min; y < area.y_max; y++) {
+                sub_data.insert(sub_data.end(), data.begin() + y * x_width + area.x_min,
+                                data.begin() + y * x_width + area.x_max);
+            }
+            return GenRaster<T>(std::move(sub_data), area.x_max - area.x_min, area.y_max - area.y_min,
+                                x_coords(area.x_min), y_coords(area.y_min), cell_width);
+        }
+
         GenRaster<T>(const GenRaster<T>& like, T fill)
                 : GenRaster<T>(std::vector<T>(like.x_width * like.y_height, fill), like.x_width, like.y_height,
                                like.x_offset,
@@ -624,7 +658,65 @@ namespace SAOP {
             return trace;
         }
 
+        /** Calls f(row, col_min, col_max) for each row of the raster with cells whose center is in a rectangle.
+         *
+         * The rectangle is given in the frame of the point (x, y) with heading 'dir': positions along the heading
+         * are in [along_min, along_max], and positions across it in [-half_width, half_width].
+         * The extent of the rectangle in each row is computed analytically, without testing individual cells. */
+        template<typename GenRaster, typename F>
+        static void for_each_rectangle_row(const GenRaster& raster, double x, double y, double dir,
+                                           double along_min, double along_max, double half_width, F f) {
+            const double ux = cos(dir);
+            const double uy = sin(dir);
+
+            // corners of the rectangle, to find the rows it covers
+            double y_low = std::numeric_limits<double>::infinity();
+            double y_high = -std::numeric_limits<double>::infinity();
+            for (double s : {along_min, along_max}) {
+                for (double l : {-half_width, half_width}) {
+                    y_low = std::min(y_low, y + s * uy + l * ux);
+                    y_high = std::max(y_high, y + s * uy + l * ux);
+                }
+            }
+            const long row_min = std::max(0L, (long) std::ceil((y_low - raster.y_offset) / raster.cell_width));
+            const long row_max = std::min((long) raster.y_height - 1,
+                                          (long) std::floor((y_high - raster.y_offset) / raster.cell_width));
+
+            for (long row = row_min; row <= row_max; row++) {
+                const double ry = raster.y_offset + row * raster.cell_width - y;
+                // along = rx * ux + ry * uy, across = -rx * uy + ry * ux, with rx relative to x
+                double rx_low = -std::numeric_limits<double>::infinity();
+                double rx_high = std::numeric_limits<double>::infinity();
+                if (!restrict_interval(ux, ry * uy, along_min, along_max, rx_low, rx_high) ||
+                    !restrict_interval(-uy, ry * ux, -half_width, half_width, rx_low, rx_high)) {
+                    continue;
+                }
+                const long col_min = std::max(0L, (long) std::ceil((rx_low + x - raster.x_offset) / raster.cell_width));
+                const long col_max = std::min((long) raster.x_width - 1,
+                                              (long) std::floor((rx_high + x - raster.x_offset) / raster.cell_width));
+                if (col_min <= col_max) {
+                    f((size_t) row, (size_t) col_min, (size_t) col_max);
+                }
+            }
+        }
+
     private:
+        /** Restricts [low, high] to the values of x such that lo <= a * x + b <= hi.
+         * Returns false if the resulting interval is empty. */
+        static bool restrict_interval(double a, double b, double lo, double hi, double& low, double& high) {
+            if (std::abs(a) < 1e-12) {
+                return lo <= b && b <= hi;
+            }
+            double x1 = (lo - b) / a;
+            double x2 = (hi - b) / a;
+            if (x1 > x2) {
+                std::swap(x1, x2);
+            }
+            low = std::max(low, x1);
+            high = std::min(high, x2);
+            return low <= high;
+        }
+
         /** Dot product of two vectors */
         static inline double dot(double x1, double y1, double x2, double y2) {
             return x1 * x2 + y1 * y2;
@@ -0,0 +1,367 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_SUMMED_AREA_HPP
+#define PLANNING_CPP_SUMMED_AREA_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "raster.hpp"
+#include "waypoint.hpp"
+#include "../ext/ThreadPool.hpp"
+
+namespace SAOP {
+
+    /** Summed-area table (integral image) of a raster.
+     *
+     * Once built, the sum of the values in any axis-aligned rectangle of cells is obtained in constant time, and the
+     * sum over a rotated rectangle (e.g. the visibility footprint of a segment) in a time proportional to the number
+     * of rows it covers. The table shares the geometry of the raster it was built from. */
+    template<typename T>
+    class SummedAreaTable {
+    public:
+        size_t x_width;
+        size_t y_height;
+        double x_offset;
+        double y_offset;
+        double cell_width;
+
+        /** Table of the values value_of(Cell) for each cell of a raster with the same geometry as 'like'.
+         * Rows then columns are accumulated in parallel when num_threads > 1. */
+        template<typename GenRaster, typename F>
+        SummedAreaTable(const GenRaster& like, F value_of, size_t num_threads = 1)
+                : x_width(like.x_width), y_height(like.y_height), x_offset(like.x_offset), y_offset(like.y_offset),
+                  cell_width(like.cell_width), table((like.x_width + 1) * (like.y_height + 1), T()) {
+            const size_t stride = x_width + 1;
+            // prefix sums along each row, then along each column
+            auto rows = [&](size_t first, size_t last) {
+                for (size_t y = first; y < last; y++) {
+                    T acc = T();
+                    for (size_t x = 0; x < x_width; x++) {
+                        acc += value_of(Cell{x, y});
+                        table[(x + 1) + (y + 1) * stride] = acc;
+                    }
+                }
+            };
+            auto columns = [&](size_t first, size_t last) {
+                for (size_t y = 1; y <= y_height; y++) {
+                    for (size_t x = first + 1; x <= last; x++) {
+                        table[x + y * stride] += table[x + (y - 1) * stride];
+                    }
+                }
+            };
+            in_chunks(y_height, num_threads, rows);
+            in_chunks(x_width, num_threads, columns);
+        }
+
+        /** Table of the values of a raster. NaN values are counted as zero. */
+        template<typename GenRaster>
+        static SummedAreaTable of(const GenRaster& raster, size_t num_threads = 1) {
+            return SummedAreaTable(raster, [&raster](Cell c) {
+                const auto v = raster(c);
+                return v == v ? static_cast<T>(v) : T();
+            }, num_threads);
+        }
+
+        /** Sum of the values in an axis-aligned rectangle of cells. */
+        T sum(const CellRect& area) const {
+            const size_t x_max = std::min(area.x_max, x_width);
+            const size_t y_max = std::min(area.y_max, y_height);
+            if (area.x_min >= x_max || area.y_min >= y_max) {
+                return T();
+            }
+            return at(x_max, y_max) - at(area.x_min, y_max) - at(x_max, area.y_min) + at(area.x_min, area.y_min);
+        }
+
+        /** Sum of the values of the cells [col_min, col_max] of a row. */
+        T row_sum(size_t row, size_t col_min, size_t col_max) const {
+            return sum(CellRect{col_min, row, col_max + 1, row + 1});
+        }
+
+        /** Sum of the values of the cells whose center is in a rotated rectangle.
+         * See RasterMapper::for_each_rectangle_row() for the meaning of the parameters. */
+        T rectangle_sum(double x, double y, double dir, double along_min, double along_max, double half_width) const {
+            T acc = T();
+            RasterMapper::for_each_rectangle_row(*this, x, y, dir, along_min, along_max, half_width,
+                                                 [this, &acc](size_t row, size_t col_min, size_t col_max) {
+                                                     acc += row_sum(row, col_min, col_max);
+                                                 });
+            return acc;
+        }
+
+        /** Sum of the values under the visibility footprint of a segment, i.e. the rectangle of
+         * RasterMapper::segment_trace() approximated by the cells whose center it contains. */
+        T footprint_sum(const Segment3d& segment, double view_width, double view_depth) const {
+            return rectangle_sum(segment.start.x, segment.start.y, segment.start.dir, -view_depth / 2,
+                                 segment.length + view_depth / 2, view_width / 2);
+        }
+
+        /** Smallest rectangle of cells containing the visibility footprint of a segment, with a one cell margin. */
+        CellRect footprint_bounds(const Segment3d& segment, double view_width, double view_depth) const {
+            const double ux = cos(segment.start.dir);
+            const double uy = sin(segment.start.dir);
+            double x_low = std::numeric_limits<double>::infinity();
+            double x_high = -std::numeric_limits<double>::infinity();
+            double y_low = std::numeric_limits<double>::infinity();
+            double y_high = -std::numeric_limits<double>::infinity();
+            for (double s : {-view_depth / 2, segment.length + view_depth / 2}) {
+                for (double l : {-view_width / 2, view_width / 2}) {
+                    x_low = std::min(x_low, segment.start.x + s * ux - l * uy);
+                    x_high = std::max(x_high, segment.start.x + s * ux - l * uy);
+                    y_low = std::min(y_low, segment.start.y + s * uy + l * ux);
+                    y_high = std::max(y_high, segment.start.y + s * uy + l * ux);
+                }
+            }
+            auto index = [this](double v, double offset, size_t size) {
+                const double i = std::floor((v - offset) / cell_width + 0.5);
+                return (size_t) std::min(std::max(i, 0.), (double) size);
+            };
+            return CellRect{index(x_low, x_offset, x_width) > 0 ? index(x_low, x_offset, x_width) - 1 : 0,
+                            index(y_low, y_offset, y_height) > 0 ? index(y_low, y_offset, y_height) - 1 : 0,
+                            std::min(index(x_high, x_offset, x_width) + 2, x_width),
+                            std::min(index(y_high, y_offset, y_height) + 2, y_height)};
+        }
+
+        /** Sum over footprint_bounds(), an upper bound of any footprint sum when values are non-negative. */
+        T bounding_sum(const Segment3d& segment, double view_width, double view_depth) const {
+            return sum(footprint_bounds(segment, view_width, view_depth));
+        }
+
+    private:
+        /** Sum of the cells [0, x) x [0, y) */
+        std::vector<T> table;
+
+        T at(size_t x, size_t y) const {
+            return table[x + y * (x_width + 1)];
+        }
+
+        template<typename F>
+        static void in_chunks(size_t n, size_t num_threads, F f) {
+            const size_t threads = std::min(num_threads, n);
+            if (threads <= 1) {
+                f(0, n);
+                return;
+            }
+            ThreadPool pool(threads);
+            std::vector<std::future<void>> chunks;
+            const size_t chunk_size = (n + threads - 1) / threads;
+            for (size_t first = 0; first < n; first += chunk_size) {
+                chunks.push_back(pool.enqueue(f, first, std::min(first + chunk_size, n)));
+            }
+            for (auto& c : chunks) {
+                c.get();
+            }
+        }
+    };
+
+    typedef SummedAreaTable<double> DSummedAreaTable;
+
+    /** Counts of ignited cells as prefix tables binned in time.
+     *
+     * A summed-area table of the cells ignited before t_k is kept for each bin boundary t_k, so that the number of
+     * cells of an area igniting in [t0, t1) is bounded from both sides in constant time for an axis-aligned
+     * rectangle, the bounds being exact when t0 and t1 are bin boundaries.
+     * Memory grows with the number of bins times the size of the raster, which should guide the bin duration.
+     * Tables are shared with the counts they are updated from (see the updating constructor), so that counts of
+     * successive versions of the ignitions only hold the tables that differ. */
+    class IgnitionCounts {
+    public:
+        /** Lower and upper bounds of a number of cells */
+        struct Bounds {
+            size_t lower;
+            size_t upper;
+        };
+
+        IgnitionCounts(const DRaster& ignitions, double bin_duration, size_t num_threads = 1)
+                : bin_duration(bin_duration), num_threads(num_threads) {
+            ASSERT(bin_duration > 0);
+            set_boundaries(ignitions);
+            build_tables(ignitions, std::vector<bool>(tables.size(), true));
+        }
+
+        /** Counts of 'ignitions', that only differ from 'base_ignitions' in the given areas, reusing the tables of
+         * 'base' (built from 'base_ignitions') that no cell of the areas changed sides of.
+         * All tables are rebuilt if the changes move the first or last ignition time. */
+        IgnitionCounts(const IgnitionCounts& base, const DRaster& base_ignitions, const DRaster& ignitions,
+                       const std::vector<CellRect>& areas)
+                : bin_duration(base.bin_duration), num_threads(base.num_threads) {
+            set_boundaries(ignitions);
+            if (start_time != base.start_time || tables.size() != base.tables.size()) {
+                build_tables(ignitions, std::vector<bool>(tables.size(), true));
+                return;
+            }
+            // a cell changing from ignition time 'a' to 'b' changes the tables whose boundary is in (min(a,b), max(a,b)]
+            // which are marked with a difference array
+            std::vector<int> changes(tables.size() + 1, 0);
+            for (const CellRect& area : areas) {
+                for (size_t y = area.y_min; y < area.y_max; y++) {
+                    for (size_t x = area.x_min; x < area.x_max; x++) {
+                        const double before = base_ignitions(x, y);
+                        const double after = ignitions(x, y);
+                        if (before != after) {
+                            changes[first_boundary_after(std::min(before, after))]++;
+                            changes[first_boundary_after(std::max(before, after))]--;
+                        }
+                    }
+                }
+            }
+            std::vector<bool> rebuilt(tables.size(), false);
+            int changed_cells = 0;
+            for (size_t k = 0; k < tables.size(); k++) {
+                changed_cells += changes[k];
+                if (changed_cells > 0) {
+                    rebuilt[k] = true;
+                } else {
+                    tables[k] = base.tables[k];
+                }
+            }
+            build_tables(ignitions, rebuilt);
+        }
+
+        double bin_size() const { return bin_duration; }
+
+        size_t num_bins() const { return tables.size() - 1; }
+
+        /** Bounds of the number of cells in the area that are ignited in [t0, t1). */
+        Bounds count_ignited_between(const CellRect& area, double t0, double t1) const {
+            return between([&area](const SummedAreaTable<uint32_t>& table) { return (size_t) table.sum(area); },
+                           t0, t1);
+        }
+
+        /** Bounds of the number of cells igniting in [t0, t1) under the visibility footprint of a segment.
+         * Cells are selected by their center, as in SummedAreaTable::footprint_sum(). */
+        Bounds count_ignited_between(const Segment3d& segment, double view_width, double view_depth,
+                                     double t0, double t1) const {
+            return between([&](const SummedAreaTable<uint32_t>& table) {
+                return (size_t) table.footprint_sum(segment, view_width, view_depth);
+            }, t0, t1);
+        }
+
+    private:
+        double bin_duration;
+        /** Number of threads on which tables are built */
+        size_t num_threads;
+        double start_time;
+        /** tables[k] counts the cells ignited strictly before boundary(k) */
+        std::vector<std::shared_ptr<const SummedAreaTable<uint32_t>>> tables;
+
+        double boundary(size_t k) const {
+            return start_time + k * bin_duration;
+        }
+
+        /** Index of the first boundary strictly after t, tables.size() if there is none. */
+        size_t first_boundary_after(double t) const {
+            if (t < start_time) {
+                return 0;
+            }
+            const double k = std::floor((t - start_time) / bin_duration) + 1;
+            return k < tables.size() ? (size_t) k : tables.size();
+        }
+
+        /** Sets the start time and the number of boundaries of the ignitions, leaving all tables null. */
+        void set_boundaries(const DRaster& ignitions) {
+            double first = std::numeric_limits<double>::infinity();
+            double last = -std::numeric_limits<double>::infinity();
+            for (double t : ignitions.data) {
+                if (t < std::numeric_limits<double>::max() / 2) {
+                    first = std::min(first, t);
+                    last = std::max(last, t);
+                }
+            }
+            start_time = first <= last ? first : 0.;
+            // the last boundary is strictly after the last ignition, its table counts all ignited cells
+            const size_t num_boundaries =
+                    first <= last ? (size_t) std::floor((last - first) / bin_duration) + 2 : 1;
+            tables.assign(num_boundaries, nullptr);
+        }
+
+        /** Builds the tables marked in 'selected', in parallel if num_threads > 1. */
+        void build_tables(const DRaster& ignitions, const std::vector<bool>& selected) {
+            auto table_at = [&ignitions](double boundary) {
+                return std::make_shared<const SummedAreaTable<uint32_t>>(ignitions, [&ignitions, boundary](Cell c) {
+                    return (uint32_t) (ignitions(c) < boundary ? 1 : 0);
+                });
+            };
+            const size_t num_selected = (size_t) std::count(selected.begin(), selected.end(), true);
+            const size_t threads = std::min(num_threads, num_selected);
+            if (threads <= 1) {
+                for (size_t k = 0; k < tables.size(); k++) {
+                    if (selected[k]) {
+                        tables[k] = table_at(boundary(k));
+                    }
+                }
+            } else {
+                ThreadPool pool(threads);
+                std::vector<std::pair<size_t, std::future<std::shared_ptr<const SummedAreaTable<uint32_t>>>>> futures;
+                for (size_t k = 0; k < tables.size(); k++) {
+                    if (selected[k]) {
+                        futures.emplace_back(k, pool.enqueue(table_at, boundary(k)));
+                    }
+                }
+                for (auto& f : futures) {
+                    tables[f.first] = f.second.get();
+                }
+            }
+        }
+
+        /** Index of the last boundary before t (or equal) and of the first boundary after t (or equal).
+         * The number of cells ignited before t is between the counts of these two boundaries. */
+        std::pair<size_t, size_t> boundaries_around(double t) const {
+            if (t <= start_time) {
+                return {0, 0};
+            }
+            const double k = (t - start_time) / bin_duration;
+            const size_t last = tables.size() - 1;
+            if (k >= last) {
+                return {last, last};
+            }
+            const auto lo = (size_t) std::floor(k);
+            return {lo, boundary(lo) == t ? lo : lo + 1};
+        }
+
+        template<typename F>
+        Bounds between(F count, double t0, double t1) const {
+            if (!(t0 < t1)) {
+                return Bounds{0, 0};
+            }
+            const auto k0 = boundaries_around(t0);
+            const auto k1 = boundaries_around(t1);
+            const size_t before_t0_low = count(*tables[k0.first]);
+            const size_t before_t0_high = k0.second == k0.first ? before_t0_low : count(*tables[k0.second]);
+            const size_t before_t1_low = k1.first == k0.second ? before_t0_high : count(*tables[k1.first]);
+            const size_t before_t1_high = k1.second == k1.first ? before_t1_low : count(*tables[k1.second]);
+            return Bounds{before_t1_low > before_t0_high ? before_t1_low - before_t0_high : 0,
+                          before_t1_high - before_t0_low};
+        }
+    };
+}
+
+#endif //PLANNING_CPP_SUMMED_AREA_HPP
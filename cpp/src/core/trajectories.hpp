@@ -72,6 +72,16 @@ namespace SAOP {
             return total;
         }
 
+        /** Hash of the plan geometry, combining the incrementally maintained hash of each trajectory.
+         * Two Trajectories with the same configurations and maneuvers have the same hash. */
+        uint64_t hash() const {
+            uint64_t h = 0;
+            for (size_t i = 0; i < trajs.size(); i++) {
+                h ^= (trajs[i].hash() + i) * 0x9e3779b97f4a7c15ULL;
+            }
+            return h;
+        }
+
         /** Returns the UAV performing the given trajectory */
         UAV uav(size_t traj_id) const {
             ASSERT(traj_id < trajs.size());
@@ -22,6 +22,8 @@ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
 OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <cstring>
+
 #include "trajectory.hpp"
 
 namespace SAOP {
@@ -51,6 +53,67 @@ namespace SAOP {
             _start_times.emplace_back(m.time);
             _man_names.emplace_back(m.name);
         }
+        _hash = 0;
+        for (long i = 0; i <= (long) size(); i++) {
+            _hash += transition_key(key_at(i - 1), key_at(i));
+        }
+    }
+
+    constexpr uint64_t Trajectory::START_KEY;
+    constexpr uint64_t Trajectory::END_KEY;
+
+    /* splitmix64 finalizer */
+    static inline uint64_t mix64(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    static inline uint64_t double_bits(double v) {
+        v += 0.; // -0. and 0. must have the same key
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+
+    uint64_t Trajectory::maneuver_key(const Segment3d& seg) {
+        uint64_t k = 0x9e3779b97f4a7c15ULL;
+        for (double v : {seg.start.x, seg.start.y, seg.start.z, seg.start.dir,
+                         seg.end.x, seg.end.y, seg.end.z, seg.end.dir}) {
+            k = mix64(k ^ double_bits(v));
+        }
+        return k;
+    }
+
+    uint64_t Trajectory::transition_key(uint64_t from, uint64_t to) {
+        return mix64(from * 0x9e3779b97f4a7c15ULL + to);
+    }
+
+    uint64_t Trajectory::config_key() const {
+        uint64_t k = 0x2545f4914f6cdd1dULL;
+        for (double v : {config.start_time, config.max_flight_time, config.wind.x(), config.wind.y(),
+                         config.uav.max_air_speed(), config.uav.max_angular_velocity(), config.uav.max_pitch_angle(),
+                         config.uav.view_width(), config.uav.view_depth()}) {
+            k = mix64(k ^ double_bits(v));
+        }
+        for (const opt<Waypoint3d>& wp : {config.start_position, config.end_position}) {
+            k = mix64(k ^ (wp ? maneuver_key(Segment3d(*wp)) : 0));
+        }
+        return k;
+    }
+
+    uint64_t Trajectory::hash() const {
+        return mix64(config_key() + _hash);
+    }
+
+    uint64_t Trajectory::key_at(long index) const {
+        if (index < 0) {
+            return START_KEY;
+        } else if (index >= (long) size()) {
+            return END_KEY;
+        } else {
+            return maneuver_key(_maneuvers[index]);
+        }
     }
 
     void Trajectory::freeze_before(double time) {
@@ -404,6 +467,11 @@ namespace SAOP {
 //                insertion_duration_cost(at_index, seg);
         }
         ASSERT(added_delay < std::numeric_limits<double>::infinity());
+        const uint64_t prev_key = key_at((long) at_index - 1);
+        const uint64_t next_key = key_at((long) at_index);
+        const uint64_t seg_key = maneuver_key(seg);
+        _hash += transition_key(prev_key, seg_key) + transition_key(seg_key, next_key) -
+                 transition_key(prev_key, next_key);
         _maneuvers.insert(_maneuvers.begin() + at_index, seg);
         _start_times.insert(_start_times.begin() + at_index, start);
         _man_names.insert(_man_names.begin() + at_index, name);
@@ -431,6 +499,11 @@ namespace SAOP {
         ASSERT(at_index <= size());
         ASSERT(insertion_range.contains(at_index));
         const double gained_delay = removal_duration_gain(at_index);
+        const uint64_t prev_key = key_at((long) at_index - 1);
+        const uint64_t next_key = key_at((long) at_index + 1);
+        const uint64_t seg_key = key_at((long) at_index);
+        _hash += transition_key(prev_key, next_key) - transition_key(prev_key, seg_key) -
+                 transition_key(seg_key, next_key);
         _maneuvers.erase(_maneuvers.begin() + at_index);
         _start_times.erase(_start_times.begin() + at_index);
         _man_names.erase(_man_names.begin() + at_index);
@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -461,6 +462,13 @@ namespace SAOP {
 
         std::string to_string() const;
 
+        /* Hash of the configuration and of the sequence of maneuvers of the trajectory.
+         * Maneuver names are ignored and maneuver times follow from the configuration and the maneuvers.
+         * The sequence part is the sum (modulo 2^64) of a key for each pair of consecutive maneuvers, maintained
+         * incrementally by insert_segment() and erase_segment(). Unlike a XOR, a sum does not cancel out
+         * transitions that appear twice, e.g., in a back and forth pattern. */
+        uint64_t hash() const;
+
     private:
         TrajectoryConfig config;
 
@@ -468,6 +476,25 @@ namespace SAOP {
         std::vector<double> _start_times;
         std::vector<std::string> _man_names;
 
+        /* Hash of the maneuver sequence, see hash(). Initialized with the transition of an empty trajectory. */
+        uint64_t _hash = transition_key(START_KEY, END_KEY);
+
+        /* Keys of virtual maneuvers before the first and after the last maneuvers */
+        static constexpr uint64_t START_KEY = 0x5bd1e9955bd1e995ULL;
+        static constexpr uint64_t END_KEY = 0xc2b2ae3d27d4eb4fULL;
+
+        /* Key of a maneuver, computed from its geometry. */
+        static uint64_t maneuver_key(const Segment3d& seg);
+
+        /* Key of the transition from a maneuver to the following one. */
+        static uint64_t transition_key(uint64_t from, uint64_t to);
+
+        /* Key of the configuration: start time, start and end positions, UAV and wind. */
+        uint64_t config_key() const;
+
+        /* Key of the maneuver at the given index, or START_KEY/END_KEY when out of the trajectory. */
+        uint64_t key_at(long index) const;
+
         /* Boolean flag that is set to true once the trajectory is initialized.
          * Validity checks are only performed when this flag is true. */
         bool is_set_up = false;
@@ -83,4 +83,70 @@ namespace SAOP {
         ss << "ReplaceSegmentUpdate(t=" << traj_id << ", i=" << at_index << ", s=" << new_seg << ")";
         return ss.str();
     }
-}
\ No newline at end of file
+
+    SegmentUpdate SegmentUpdate::apply(Trajectories& p) const {
+        switch (kind) {
+            case Kind::Insert: {
+                ASSERT(traj_id < p.size());
+                ASSERT(at_index <= p[traj_id].size());
+                p[traj_id].insert_segment(seg, at_index);
+                return SegmentUpdate::erase(traj_id, at_index);
+            }
+            case Kind::Delete: {
+                ASSERT(traj_id < p.size());
+                ASSERT(at_index < p[traj_id].size());
+                const Segment3d old_seg = p[traj_id].segment(at_index);
+                p[traj_id].erase_segment(at_index);
+                return SegmentUpdate::insert(traj_id, old_seg, at_index);
+            }
+            case Kind::Replace: {
+                ASSERT(traj_id < p.size());
+                ASSERT(at_index < p[traj_id].size());
+                const Segment3d old_seg = p[traj_id].segment(at_index);
+                p[traj_id].replace_segment(at_index, seg);
+                return SegmentUpdate::replace(traj_id, at_index, old_seg);
+            }
+            default:
+                return SegmentUpdate::empty();
+        }
+    }
+
+    double SegmentUpdate::duration_cost(const Trajectories& p) const {
+        switch (kind) {
+            case Kind::Insert:
+                return p[traj_id].insertion_duration_cost(at_index, seg);
+            case Kind::Delete:
+                return -p[traj_id].removal_duration_gain(at_index);
+            case Kind::Replace:
+                return p[traj_id].replacement_duration_cost(at_index, seg);
+            default:
+                return 0.;
+        }
+    }
+
+    PReversibleTrajectoriesUpdate SegmentUpdate::as_reversible() const {
+        switch (kind) {
+            case Kind::Insert:
+                return unique_ptr<InsertSegmentUpdate>(new InsertSegmentUpdate(traj_id, seg, at_index));
+            case Kind::Delete:
+                return unique_ptr<DeleteSegmentUpdate>(new DeleteSegmentUpdate(traj_id, at_index));
+            case Kind::Replace:
+                return unique_ptr<ReplaceSegmentUpdate>(new ReplaceSegmentUpdate(traj_id, at_index, seg));
+            default:
+                return unique_ptr<EmptyUpdate>(new EmptyUpdate());
+        }
+    }
+
+    std::string SegmentUpdate::to_string() const {
+        switch (kind) {
+            case Kind::Insert:
+                return InsertSegmentUpdate(traj_id, seg, at_index).to_string();
+            case Kind::Delete:
+                return DeleteSegmentUpdate(traj_id, at_index).to_string();
+            case Kind::Replace:
+                return ReplaceSegmentUpdate(traj_id, at_index, seg).to_string();
+            default:
+                return EmptyUpdate().to_string();
+        }
+    }
+}
@@ -120,6 +120,62 @@ namespace SAOP {
 
         PReversibleTrajectoriesUpdate apply(Trajectories& p) override;
     };
+
+    /** Value-type counterpart of the single segment updates above.
+     *
+     * A SegmentUpdate can be copied, stored in a plain array and discarded without touching the heap.
+     * It is intended to describe the many candidate changes a neighborhood considers before keeping one of them. */
+    struct SegmentUpdate final {
+        enum class Kind {
+            Empty, Insert, Delete, Replace
+        };
+
+        Kind kind;
+
+        /** Index of the trajectory in which to perform the update. */
+        size_t traj_id;
+
+        /** Index of the inserted/deleted/replaced segment. */
+        size_t at_index;
+
+        /** Inserted or replacement segment. Meaningless for Empty and Delete updates. */
+        Segment3d seg;
+
+        static SegmentUpdate empty() {
+            return SegmentUpdate(Kind::Empty, 0, 0, Segment3d(Waypoint3d(0, 0, 0, 0)));
+        }
+
+        static SegmentUpdate insert(size_t traj_id, const Segment3d& seg, size_t at_index) {
+            return SegmentUpdate(Kind::Insert, traj_id, at_index, seg);
+        }
+
+        static SegmentUpdate erase(size_t traj_id, size_t at_index) {
+            return SegmentUpdate(Kind::Delete, traj_id, at_index, Segment3d(Waypoint3d(0, 0, 0, 0)));
+        }
+
+        static SegmentUpdate replace(size_t traj_id, size_t at_index, const Segment3d& seg) {
+            return SegmentUpdate(Kind::Replace, traj_id, at_index, seg);
+        }
+
+        /** Applies the update and returns the update that would revert it. */
+        SegmentUpdate apply(Trajectories& p) const;
+
+        /** Increase in duration (s) of the target trajectory if this update was applied. */
+        double duration_cost(const Trajectories& p) const;
+
+        /** Equivalent update in the pointer-based hierarchy, e.g., to be given to Plan::update(). */
+        PReversibleTrajectoriesUpdate as_reversible() const;
+
+        std::string to_string() const;
+
+        friend std::ostream& operator<<(std::ostream& stream, const SegmentUpdate& u) {
+            return stream << u.to_string();
+        }
+
+    private:
+        SegmentUpdate(Kind kind, size_t traj_id, size_t at_index, const Segment3d& seg)
+                : kind(kind), traj_id(traj_id), at_index(at_index), seg(seg) {}
+    };
 }
 
 #endif //PROJECT_TRAJECTORIES_H
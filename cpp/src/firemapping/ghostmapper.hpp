@@ -24,15 +24,23 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #ifndef PLANNING_CPP_GHOSTMAPPER_HPP
 
-#include <vector>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "../core/fire_data.hpp"
+#include "../core/footprint_cache.hpp"
 #include "../core/raster.hpp"
 #include "../core/trajectories.hpp"
 #include "../core/trajectory.hpp"
 #include "../core/uav.hpp"
 #include "../ext/optional.hpp"
+#include "../ext/ThreadPool.hpp"
+#include "swath.hpp"
 
 namespace SAOP {
 
@@ -40,30 +48,64 @@ namespace SAOP {
     template<typename T>
     class GhostFireMapper {
     public:
-        explicit GhostFireMapper(shared_ptr<FireData> environment_gt)
+        /* If 'use_footprint_stamps' is set, footprints observed from waypoints are traced with a FootprintStampCache
+         * instead of RasterMapper::segment_trace. This is faster but approximate: the traced cells differ
+         * in about 14% of the footprints, by 0.4 cells on average. */
+        explicit GhostFireMapper(shared_ptr<FireData> environment_gt, bool use_footprint_stamps = false)
                 : _environment(environment_gt),
                   _fire_map(GenRaster<T>(environment_gt->ignitions, std::numeric_limits<T>::infinity())),
-                  _observed(GenRaster<T>(environment_gt->ignitions, std::numeric_limits<T>::infinity())) {}
+                  _observed(GenRaster<T>(environment_gt->ignitions, std::numeric_limits<T>::infinity())),
+                  use_footprint_stamps(use_footprint_stamps) {}
 
-        GhostFireMapper(shared_ptr<FireData> environment_gt, GenRaster<T> firemap, GenRaster<T> observed)
+        GhostFireMapper(shared_ptr<FireData> environment_gt, GenRaster<T> firemap, GenRaster<T> observed,
+                        bool use_footprint_stamps = false)
                 : _environment(std::move(environment_gt)),
                   _fire_map(std::move(firemap)),
-                  _observed(std::move(observed)) {}
+                  _observed(std::move(observed)),
+                  use_footprint_stamps(use_footprint_stamps) {}
 
 //        shared_ptr<FireData> environment_gt() const;
 
-        /* Get the current fire map*/
+        /* Get the current fire map.
+         * The reference is not protected against concurrent observations, see firemap_copy(). */
         const GenRaster<T>& firemap() const {
             return _fire_map;
         }
 
-        /* Get the current fire map*/
+        /* Get the current observation map.
+         * The reference is not protected against concurrent observations, see observed_copy(). */
         const GenRaster<T>& observed() const {
             return _observed;
         }
 
+        /* Copy of the current fire map, safe to take while another thread is observing. */
+        GenRaster<T> firemap_copy() const {
+            std::lock_guard<std::mutex> lock(maps_mutex);
+            return _fire_map;
+        }
+
+        /* Copy of the current observation map, safe to take while another thread is observing. */
+        GenRaster<T> observed_copy() const {
+            std::lock_guard<std::mutex> lock(maps_mutex);
+            return _observed;
+        }
+
+        /* Copy of an area of the current fire map (e.g. a tile returned by take_dirty_tiles()), safe to take while
+         * another thread is observing. */
+        GenRaster<T> firemap_area(const CellRect& area) const {
+            std::lock_guard<std::mutex> lock(maps_mutex);
+            return _fire_map.sub_raster(area);
+        }
+
+        /* Copy of an area of the current observation map, see firemap_area(). */
+        GenRaster<T> observed_area(const CellRect& area) const {
+            std::lock_guard<std::mutex> lock(maps_mutex);
+            return _observed.sub_raster(area);
+        }
+
         void observe(const Trajectory& traj) {
             auto wp_t = traj.as_waypoints_with_time();
+            std::lock_guard<std::mutex> lock(maps_mutex);
             observed_fire(std::move(std::get<0>(wp_t)), std::move(std::get<1>(wp_t)), traj.conf().uav,
                           _fire_map, _observed);
         }
@@ -75,9 +117,136 @@ namespace SAOP {
         }
 
         void observe(const vector<Waypoint3d>& wp_list, const vector<double>& time_list, const UAV& uav) {
+            std::lock_guard<std::mutex> lock(maps_mutex);
             observed_fire(wp_list, time_list, uav, _fire_map, _observed);
         }
 
+        /* Observe the fire from several lists of waypoints (e.g. one per UAV), like successive calls to observe().
+         *
+         * Instead of tracing the footprint of each waypoint, the swath of each straight run of waypoints is
+         * rasterized once (see StraightRun), a cell being observed if its center is in a footprint.
+         * Lists are processed in parallel by 'num_threads' threads (0 for one per hardware core), taken from a
+         * thread pool kept by the mapper across calls. The resulting cell updates are then applied tile by tile,
+         * each tile being written by a single thread, in the order of the lists.
+         *
+         * As in observe(), nothing is observed from a waypoint at which the UAV is turning: the camera is fixed to
+         * the airframe and does not look at the ground below the UAV while it banks. Turns are thus left out of
+         * the straight runs instead of being rasterized.
+         *
+         * The result is close to, but not the same as, the one of observe(). Footprints are extended by half a cell
+         * on each side and cells are selected by their center, so cells on the border of the swath may differ
+         * (1 to 2% of the observed cells in our tests). A cell is also seen by more waypoints, which makes its
+         * observation time later by up to the time needed to fly over a cell (about 2.6 s on average for 25 m
+         * cells at 18 m/s). */
+        void observe_swaths(const vector<vector<Waypoint3d>>& wp_lists, const vector<vector<double>>& time_lists,
+                            const vector<UAV>& uavs, size_t num_threads = 0) {
+            ASSERT(wp_lists.size() == time_lists.size() && wp_lists.size() == uavs.size());
+            std::lock_guard<std::mutex> lock(maps_mutex);
+            if (num_threads == 0) {
+                num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            }
+            if (!pool || pool_threads != num_threads) {
+                pool.reset(new ThreadPool(num_threads));
+                pool_threads = num_threads;
+            }
+
+            const size_t x_tiles = (_observed.x_width + tile_size - 1) / tile_size;
+            const size_t y_tiles = (_observed.y_height + tile_size - 1) / tile_size;
+            std::vector<SortedCellUpdates> updates(wp_lists.size());
+
+            std::vector<std::future<void>> tasks;
+            for (size_t i = 0; i < wp_lists.size(); i++) {
+                tasks.push_back(pool->enqueue([this, i, x_tiles, y_tiles, &wp_lists, &time_lists, &uavs, &updates]() {
+                    updates[i] = SortedCellUpdates(swath_updates(wp_lists[i], time_lists[i], uavs[i]),
+                                                   x_tiles * y_tiles, [x_tiles](size_t index, size_t x_width) {
+                                return (index % x_width) / tile_size + ((index / x_width) / tile_size) * x_tiles;
+                            }, _observed.x_width);
+                }));
+            }
+            for (auto& task : tasks) {
+                task.get();
+            }
+            tasks.clear();
+            for (const auto& list_updates : updates) {
+                for (size_t tile = 0; tile < x_tiles * y_tiles; tile++) {
+                    if (list_updates.tile_start[tile] < list_updates.tile_start[tile + 1]) {
+                        mark_tile_dirty(tile);
+                    }
+                }
+            }
+
+            const size_t num_tiles = x_tiles * y_tiles;
+            const size_t chunk_size = (num_tiles + num_threads - 1) / num_threads;
+            for (size_t first = 0; first < num_tiles; first += chunk_size) {
+                const size_t last = std::min(first + chunk_size, num_tiles);
+                tasks.push_back(pool->enqueue([this, first, last, &updates]() {
+                    for (size_t tile = first; tile < last; tile++) {
+                        for (const auto& list_updates : updates) {
+                            for (size_t u = list_updates.tile_start[tile]; u < list_updates.tile_start[tile + 1]; u++) {
+                                apply(list_updates.updates[u]);
+                            }
+                        }
+                    }
+                }));
+            }
+            for (auto& task : tasks) {
+                task.get();
+            }
+        }
+
+        /* Streaming observation: ingests the pose of a UAV at a given time, as reported in real time.
+         *
+         * The footprint of the previous pose of the same UAV (identified by its name) is observed, unless the UAV
+         * was turning between the two poses. Up to the tolerances used to group waypoints in straight runs
+         * (see StraightRun), this is equivalent to observing the full list of poses with observe_swaths(), without
+         * going over the previous ones again. Poses older than the previous one are ignored. */
+        void observe_pose(const UAV& uav, const Waypoint3d& pose, double time) {
+            std::lock_guard<std::mutex> lock(maps_mutex);
+            auto previous = last_poses.find(uav.name());
+            if (previous != last_poses.end()) {
+                if (time <= previous->second.second) {
+                    return;
+                }
+                const Waypoint3d& previous_pose = previous->second.first;
+                for (const CellUpdate& u : swath_updates({previous_pose, pose}, {previous->second.second, time}, uav)) {
+                    apply(u);
+                    mark_dirty(u.index);
+                }
+            }
+            last_poses[uav.name()] = {pose, time};
+        }
+
+        /* Tiles of the fire map and observed rasters modified by observe_pose() and observe_swaths() since
+         * the previous call. */
+        std::vector<CellRect> take_dirty_tiles() {
+            std::lock_guard<std::mutex> lock(maps_mutex);
+            std::vector<CellRect> tiles;
+            tiles.reserve(dirty_tiles.size());
+            const size_t x_tiles = (_observed.x_width + tile_size - 1) / tile_size;
+            for (size_t tile : dirty_tiles) {
+                const size_t x_min = (tile % x_tiles) * tile_size;
+                const size_t y_min = (tile / x_tiles) * tile_size;
+                tiles.push_back(CellRect{x_min, y_min, std::min(x_min + tile_size, _observed.x_width),
+                                         std::min(y_min + tile_size, _observed.y_height)});
+                dirty[tile] = false;
+            }
+            dirty_tiles.clear();
+            return tiles;
+        }
+
+        void observe_swaths(const Trajectories& trajs, size_t num_threads = 0) {
+            vector<vector<Waypoint3d>> wp_lists;
+            vector<vector<double>> time_lists;
+            vector<UAV> uavs;
+            for (const auto& t : trajs) {
+                auto wp_t = t.as_waypoints_with_time();
+                wp_lists.push_back(std::move(std::get<0>(wp_t)));
+                time_lists.push_back(std::move(std::get<1>(wp_t)));
+                uavs.push_back(t.conf().uav);
+            }
+            observe_swaths(wp_lists, time_lists, uavs, num_threads);
+        }
+
         GenRaster<T> observed_fire(const vector<Waypoint3d>& shot_wp_list,
                                    const vector<double>& shot_time_list, const UAV& uav) const {
             GenRaster<T> fire = GenRaster<T>(_environment->ignitions, std::numeric_limits<T>::quiet_NaN());
@@ -97,9 +266,7 @@ namespace SAOP {
             auto it_t = shot_time_list.begin();
             for (; it_wp != shot_wp_list.end() - 1 || it_t != shot_time_list.end() - 1; ++it_wp, ++it_t) {
                 if (!uav.is_turning(*it_wp, *(it_wp + 1))) {
-                    opt<std::vector<Cell>> ignited_cells =
-                            *RasterMapper::segment_trace(Segment3d{*it_wp, (*it_wp).forward(1.)}, uav.view_width(),
-                                                         uav.view_depth(), fire);
+                    opt<std::vector<Cell>> ignited_cells = footprint_trace(uav, *it_wp, fire);
                     if (ignited_cells) {
                         for (const auto& c: *ignited_cells) {
                             TimeWindow fire_time_window = TimeWindow{_environment->ignitions(c),
@@ -132,9 +299,7 @@ namespace SAOP {
             auto it_t = shot_time_list.begin();
             for (; it_wp != shot_wp_list.end() - 1 || it_t != shot_time_list.end() - 1; ++it_wp, ++it_t) {
                 if (!uav.is_turning(*it_wp, *(it_wp + 1))) {
-                    opt<std::vector<Cell>> ignited_cells =
-                            *RasterMapper::segment_trace(Segment3d{*it_wp, (*it_wp).forward(1.)}, uav.view_width(),
-                                                         uav.view_depth(), obs_raster);
+                    opt<std::vector<Cell>> ignited_cells = footprint_trace(uav, *it_wp, obs_raster);
                     if (ignited_cells) {
                         for (const auto& c: *ignited_cells) {
                             TimeWindow fire_tw = TimeWindow{_environment->ignitions(c),
@@ -165,9 +330,7 @@ namespace SAOP {
             auto it_t = shot_time_list.begin();
             for (; it_wp != shot_wp_list.end() - 1 || it_t != shot_time_list.end() - 1; ++it_wp, ++it_t) {
                 if (!uav.is_turning(*it_wp, *(it_wp + 1))) {
-                    opt<std::vector<Cell>> ignited_cells =
-                            *RasterMapper::segment_trace(Segment3d{*it_wp, (*it_wp).forward(1.)}, uav.view_width(),
-                                                         uav.view_depth(), _environment->ignitions);
+                    opt<std::vector<Cell>> ignited_cells = footprint_trace(uav, *it_wp, _environment->ignitions);
                     if (ignited_cells) {
                         for (const auto& c: *ignited_cells) {
                             TimeWindow fire_time_window = TimeWindow{_environment->ignitions(c),
@@ -188,8 +351,149 @@ namespace SAOP {
         shared_ptr<FireData> _environment;
         GenRaster<T> _fire_map;
         GenRaster<T> _observed;
+
+        /** Held while the maps, the dirty tiles or the last poses are accessed, so that observations can be made
+         * from several threads. */
+        mutable std::mutex maps_mutex;
+
+        /** Side of the square tiles in which the rasters are split for parallel updates and change tracking. */
+        static constexpr size_t tile_size = 64;
+
+        /** Threads of observe_swaths(), created on first use. Only accessed with maps_mutex held. */
+        std::unique_ptr<ThreadPool> pool;
+        size_t pool_threads = 0;
+
+        /** Whether footprints are traced with stamps, see the constructor. */
+        const bool use_footprint_stamps;
+
+        /** Footprint stamps of each UAV, built on first use. Only accessed with stamps_mutex held. */
+        mutable std::map<std::string, std::shared_ptr<const FootprintStampCache>> stamp_caches;
+        mutable std::mutex stamps_mutex;
+
+        /** Cells seen from the footprint of the UAV at the waypoint. */
+        template<typename Raster>
+        std::vector<Cell> footprint_trace(const UAV& uav, const Waypoint3d& wp, const Raster& raster) const {
+            const Segment3d segment{wp, wp.forward(1.)};
+            if (use_footprint_stamps) {
+                return footprint_stamps(uav)->trace(segment, raster);
+            }
+            return *RasterMapper::segment_trace(segment, uav.view_width(), uav.view_depth(), raster);
+        }
+
+        /** Footprint stamps of 1m long segments for the UAV on the rasters of this mapper. */
+        std::shared_ptr<const FootprintStampCache> footprint_stamps(const UAV& uav) const {
+            std::lock_guard<std::mutex> lock(stamps_mutex);
+            auto it = stamp_caches.find(uav.name());
+            if (it != stamp_caches.end() &&
+                !it->second->is_for(uav.view_width(), uav.view_depth(), _observed.cell_width)) {
+                // another UAV with the same name, stamps are outdated
+                stamp_caches.erase(it);
+                it = stamp_caches.end();
+            }
+            if (it == stamp_caches.end()) {
+                it = stamp_caches.emplace(uav.name(), std::make_shared<const FootprintStampCache>(
+                        uav.view_width(), uav.view_depth(), _observed.cell_width)).first;
+            }
+            return it->second;
+        }
+
+        /** Last pose and time of each UAV for streaming observation. */
+        std::map<std::string, std::pair<Waypoint3d, double>> last_poses;
+
+        /** Tiles modified since the last call to take_dirty_tiles(), as a list and as flags. */
+        std::vector<size_t> dirty_tiles;
+        std::vector<bool> dirty;
+
+        void mark_tile_dirty(size_t tile) {
+            if (dirty.empty()) {
+                dirty = std::vector<bool>(((_observed.x_width + tile_size - 1) / tile_size) *
+                                          ((_observed.y_height + tile_size - 1) / tile_size), false);
+            }
+            if (!dirty[tile]) {
+                dirty[tile] = true;
+                dirty_tiles.push_back(tile);
+            }
+        }
+
+        void mark_dirty(size_t cell_index) {
+            const size_t x_tiles = (_observed.x_width + tile_size - 1) / tile_size;
+            mark_tile_dirty((cell_index % _observed.x_width) / tile_size +
+                            ((cell_index / _observed.x_width) / tile_size) * x_tiles);
+        }
+
+        /** Update of a cell observed at time 'observed', and seen on fire at time 'fire' if 'on_fire'. */
+        struct CellUpdate {
+            size_t index;
+            T observed;
+            T fire;
+            bool on_fire;
+        };
+
+        /** Cell updates sorted by tile, keeping their order inside each tile.
+         * Updates of tile i are in [tile_start[i], tile_start[i+1]). */
+        struct SortedCellUpdates {
+            std::vector<CellUpdate> updates;
+            std::vector<size_t> tile_start;
+
+            SortedCellUpdates() = default;
+
+            template<typename TileOf>
+            SortedCellUpdates(const std::vector<CellUpdate>& unsorted, size_t num_tiles, TileOf tile_of,
+                              size_t x_width)
+                    : updates(unsorted.size()), tile_start(num_tiles + 1, 0) {
+                // counting sort
+                for (const auto& u : unsorted) {
+                    tile_start[tile_of(u.index, x_width) + 1]++;
+                }
+                for (size_t i = 0; i < num_tiles; i++) {
+                    tile_start[i + 1] += tile_start[i];
+                }
+                std::vector<size_t> next(tile_start.begin(), tile_start.end() - 1);
+                for (const auto& u : unsorted) {
+                    updates[next[tile_of(u.index, x_width)]++] = u;
+                }
+            }
+        };
+
+        void apply(const CellUpdate& u) {
+            _observed.data[u.index] = u.observed;
+            if (u.on_fire) {
+                _fire_map.data[u.index] = u.fire;
+            }
+        }
+
+        /** Cell updates resulting from observing from the waypoints, in the order they would be applied by
+         * observed_fire(). */
+        std::vector<CellUpdate> swath_updates(const vector<Waypoint3d>& wp_list, const vector<double>& time_list,
+                                              const UAV& uav) const {
+            std::vector<CellUpdate> updates;
+            const DRaster& ignitions = _environment->ignitions;
+            const DRaster& traversal_end = _environment->traversal_end;
+            for (const StraightRun& run : StraightRun::split(wp_list, time_list, uav, ignitions.cell_width / 4)) {
+                // footprints are extended by half a cell on each side to include partially seen cells
+                run.for_each_cell(uav.view_width() + ignitions.cell_width, uav.view_depth() + ignitions.cell_width,
+                                  ignitions,
+                                  [&](const Cell& c, size_t first, size_t last) {
+                                      CellUpdate u{c.x + c.y * ignitions.x_width, (T) run.times[last], 0, false};
+                                      // last waypoint seeing the cell while it is burning
+                                      auto after_fire = std::lower_bound(run.times.begin() + first,
+                                                                         run.times.begin() + last + 1,
+                                                                         traversal_end(c));
+                                      if (after_fire != run.times.begin() + first &&
+                                          *(after_fire - 1) >= ignitions(c)) {
+                                          u.fire = (T) *(after_fire - 1);
+                                          u.on_fire = true;
+                                      }
+                                      updates.push_back(u);
+                                  });
+            }
+            return updates;
+        }
     };
 
+    template<typename T>
+    constexpr size_t GhostFireMapper<T>::tile_size;
+
 }
 #define PLANNING_CPP_GHOSTMAPPER_HPP
 
@@ -0,0 +1,222 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_RECONSTRUCTION_HPP
+#define PLANNING_CPP_RECONSTRUCTION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "../core/raster.hpp"
+#include "../core/waypoint.hpp"
+#include "../ext/ThreadPool.hpp"
+
+namespace SAOP {
+
+    /** Static 2D KD-tree over a set of positions, stored implicitly in a single array. */
+    class KDTree2D {
+    public:
+        explicit KDTree2D(const std::vector<PositionTime>& points) : nodes(points) {
+            build(0, nodes.size(), 0);
+        }
+
+        /** Up to 'k' points closest to (x, y) within 'radius', as (squared distance, point) sorted by distance. */
+        std::vector<std::pair<double, const PositionTime*>>
+        nearest(double x, double y, size_t k, double radius) const {
+            std::vector<std::pair<double, const PositionTime*>> heap;
+            heap.reserve(k + 1);
+            nearest(0, nodes.size(), 0, x, y, k, radius * radius, heap);
+            std::sort_heap(heap.begin(), heap.end());
+            return heap;
+        }
+
+        size_t size() const { return nodes.size(); }
+
+    private:
+        /* Points of [lo, hi) are split along axis (depth % 2) by the median at (lo + hi) / 2. */
+        std::vector<PositionTime> nodes;
+
+        static double coord(const PositionTime& p, size_t axis) {
+            return axis == 0 ? p.pt.x : p.pt.y;
+        }
+
+        void build(size_t lo, size_t hi, size_t depth) {
+            if (hi - lo <= 1) {
+                return;
+            }
+            const size_t mid = (lo + hi) / 2;
+            const size_t axis = depth % 2;
+            std::nth_element(nodes.begin() + lo, nodes.begin() + mid, nodes.begin() + hi,
+                             [axis](const PositionTime& a, const PositionTime& b) {
+                                 return coord(a, axis) < coord(b, axis);
+                             });
+            build(lo, mid, depth + 1);
+            build(mid + 1, hi, depth + 1);
+        }
+
+        void nearest(size_t lo, size_t hi, size_t depth, double x, double y, size_t k, double max_dist_sq,
+                     std::vector<std::pair<double, const PositionTime*>>& heap) const {
+            if (lo >= hi) {
+                return;
+            }
+            const size_t mid = (lo + hi) / 2;
+            const PositionTime& p = nodes[mid];
+            const double d_sq = (p.pt.x - x) * (p.pt.x - x) + (p.pt.y - y) * (p.pt.y - y);
+            if (d_sq <= max_dist_sq && (heap.size() < k || d_sq < heap.front().first)) {
+                heap.emplace_back(d_sq, &p);
+                std::push_heap(heap.begin(), heap.end());
+                if (heap.size() > k) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.pop_back();
+                }
+            }
+
+            const size_t axis = depth % 2;
+            const double diff = (axis == 0 ? x : y) - coord(p, axis);
+            const bool left_first = diff < 0;
+            if (left_first) {
+                nearest(lo, mid, depth + 1, x, y, k, max_dist_sq, heap);
+            } else {
+                nearest(mid + 1, hi, depth + 1, x, y, k, max_dist_sq, heap);
+            }
+            // other side only if it may contain closer points
+            const double bound = heap.size() < k ? max_dist_sq : std::min(max_dist_sq, heap.front().first);
+            if (diff * diff <= bound) {
+                if (left_first) {
+                    nearest(mid + 1, hi, depth + 1, x, y, k, max_dist_sq, heap);
+                } else {
+                    nearest(lo, mid, depth + 1, x, y, k, max_dist_sq, heap);
+                }
+            }
+        }
+    };
+
+    /** Reconstruction of a dense fire map (e.g. ignition times) from sparse observations.
+     *
+     * The value of each cell is a weighted mean of the closest observations (at most 'max_neighbors'), weighted
+     * by the compactly supported Wendland C2 function phi(r) = (1 - r)^4 (4r + 1), with r the distance
+     * normalized by 'support_radius'. Cells without any observation within the support radius get 'no_data'.
+     * The output raster is processed by tiles, in parallel. */
+    class FireMapReconstruction {
+    public:
+        FireMapReconstruction(double support_radius, size_t max_neighbors = 16, size_t num_threads = 0,
+                              double no_data = std::numeric_limits<double>::infinity())
+                : support_radius(support_radius), max_neighbors(max_neighbors),
+                  num_threads(num_threads == 0 ? std::max<size_t>(std::thread::hardware_concurrency(), 1)
+                                               : num_threads),
+                  no_data(no_data) {
+            ASSERT(support_radius > 0);
+            ASSERT(max_neighbors > 0);
+        }
+
+        /** Dense map with the geometry of 'like', interpolated from the given observations. */
+        template<typename T>
+        GenRaster<T> reconstruct(const std::vector<PositionTime>& observations, const GenRaster<T>& like) const {
+            GenRaster<T> result(like, (T) no_data);
+            if (observations.empty()) {
+                return result;
+            }
+            const KDTree2D tree(observations);
+
+            const size_t x_tiles = (result.x_width + tile_size - 1) / tile_size;
+            const size_t y_tiles = (result.y_height + tile_size - 1) / tile_size;
+            auto process_tiles = [this, &tree, &result, x_tiles](size_t first, size_t last) {
+                for (size_t tile = first; tile < last; tile++) {
+                    const size_t x0 = (tile % x_tiles) * tile_size;
+                    const size_t y0 = (tile / x_tiles) * tile_size;
+                    for (size_t y = y0; y < std::min(y0 + tile_size, result.y_height); y++) {
+                        for (size_t x = x0; x < std::min(x0 + tile_size, result.x_width); x++) {
+                            result.set(x, y, (T) interpolate(tree, result.x_coords(x), result.y_coords(y)));
+                        }
+                    }
+                }
+            };
+
+            const size_t num_tiles = x_tiles * y_tiles;
+            const size_t threads = std::min(num_threads, num_tiles);
+            if (threads <= 1) {
+                process_tiles(0, num_tiles);
+            } else {
+                ThreadPool pool(threads);
+                // more chunks than threads to balance tiles with many and few observations
+                const size_t chunk_size = std::max<size_t>(1, num_tiles / (4 * threads));
+                std::vector<std::future<void>> chunks;
+                for (size_t first = 0; first < num_tiles; first += chunk_size) {
+                    chunks.push_back(pool.enqueue(process_tiles, first, std::min(first + chunk_size, num_tiles)));
+                }
+                for (auto& chunk : chunks) {
+                    chunk.get();
+                }
+            }
+            return result;
+        }
+
+        /** Dense map interpolated from the observed cells of a map, i.e. cells whose value is finite
+         * (as in the fire map of a GhostFireMapper). Observed cells keep their value. */
+        template<typename T>
+        GenRaster<T> reconstruct(const GenRaster<T>& observed_map) const {
+            std::vector<PositionTime> observations;
+            for (size_t y = 0; y < observed_map.y_height; y++) {
+                for (size_t x = 0; x < observed_map.x_width; x++) {
+                    if (std::isfinite((double) observed_map(x, y))) {
+                        observations.emplace_back(observed_map.as_position(Cell{x, y}), (double) observed_map(x, y));
+                    }
+                }
+            }
+            GenRaster<T> result = reconstruct(observations, observed_map);
+            for (size_t i = 0; i < result.data.size(); i++) {
+                if (std::isfinite((double) observed_map.data[i])) {
+                    result.data[i] = observed_map.data[i];
+                }
+            }
+            return result;
+        }
+
+    private:
+        static constexpr size_t tile_size = 64;
+
+        double support_radius;
+        size_t max_neighbors;
+        size_t num_threads;
+        double no_data;
+
+        double interpolate(const KDTree2D& tree, double x, double y) const {
+            double weighted_sum = 0.;
+            double weights = 0.;
+            for (const auto& neighbor : tree.nearest(x, y, max_neighbors, support_radius)) {
+                const double r = std::sqrt(neighbor.first) / support_radius;
+                const double w = std::pow(1. - r, 4) * (4. * r + 1.);
+                weighted_sum += w * neighbor.second->time;
+                weights += w;
+            }
+            return weights > 0. ? weighted_sum / weights : no_data;
+        }
+    };
+}
+
+#endif //PLANNING_CPP_RECONSTRUCTION_HPP
@@ -0,0 +1,125 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_SWATH_HPP
+#define PLANNING_CPP_SWATH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "../core/raster.hpp"
+#include "../core/uav.hpp"
+#include "../core/waypoint.hpp"
+
+namespace SAOP {
+
+    /** Successive observation waypoints flown along a straight line.
+     *
+     * The footprints of the waypoints are rectangles with the same orientation, whose union (the swath) is itself
+     * a rectangle. This allows rasterizing the swath once instead of tracing each footprint individually. */
+    struct StraightRun {
+        /** First waypoint of the run, giving its heading. */
+        Waypoint3d origin;
+        /** Position of each waypoint along the heading, relative to the origin (increasing). */
+        std::vector<double> along_track;
+        /** Time at which each waypoint is reached. */
+        std::vector<double> times;
+
+        /** Maximum difference of heading between a waypoint and the origin of its run. */
+        static constexpr double heading_tolerance = 0.01;
+
+        StraightRun(const Waypoint3d& origin, double time) : origin(origin), along_track({0.}), times({time}) {}
+
+        /** Extends the run with the given waypoint if it is on the line of the run, ahead of the previous ones
+         * (with a lateral deviation of at most 'lateral_tolerance'). Returns false otherwise. */
+        bool extend(const Waypoint3d& wp, double time, double lateral_tolerance) {
+            const double ux = cos(origin.dir);
+            const double uy = sin(origin.dir);
+            const double along = (wp.x - origin.x) * ux + (wp.y - origin.y) * uy;
+            const double lateral = -(wp.x - origin.x) * uy + (wp.y - origin.y) * ux;
+            if (std::abs(remainder(wp.dir - origin.dir, 2 * M_PI)) > heading_tolerance ||
+                std::abs(lateral) > lateral_tolerance || along <= along_track.back()) {
+                return false;
+            }
+            along_track.push_back(along);
+            times.push_back(time);
+            return true;
+        }
+
+        /** Splits a list of waypoints into straight runs.
+         *
+         * As in GhostFireMapper::observed_fire, a waypoint is only observing if the UAV is not turning between it
+         * and the next one. Hence the last waypoint of the list never observes. */
+        static std::vector<StraightRun> split(const std::vector<Waypoint3d>& wp_list, const std::vector<double>& time_list,
+                                              const UAV& uav, double lateral_tolerance) {
+            ASSERT(wp_list.size() == time_list.size());
+            std::vector<StraightRun> runs;
+            bool in_run = false;
+            for (size_t i = 0; i + 1 < wp_list.size(); i++) {
+                if (uav.is_turning(wp_list[i], wp_list[i + 1])) {
+                    in_run = false;
+                    continue;
+                }
+                if (!in_run || !runs.back().extend(wp_list[i], time_list[i], lateral_tolerance)) {
+                    runs.emplace_back(wp_list[i], time_list[i]);
+                    in_run = true;
+                }
+            }
+            return runs;
+        }
+
+        /** Calls f(cell, first, last) for every cell of the raster whose center is in the swath of the run,
+         * where [first, last] is the (non-empty) range of waypoints of the run whose footprint contains it.
+         *
+         * As in RasterMapper::segment_trace, the footprint of a waypoint is a 'view_width' wide rectangle
+         * extending 'view_depth'/2 behind it and 1 + 'view_depth'/2 ahead of it.
+         * Cells are visited row by row (see RasterMapper::for_each_rectangle_row). */
+        template<typename Raster, typename F>
+        void for_each_cell(double view_width, double view_depth, const Raster& raster, F f) const {
+            const double ux = cos(origin.dir);
+            const double uy = sin(origin.dir);
+            RasterMapper::for_each_rectangle_row(
+                    raster, origin.x, origin.y, origin.dir, along_track.front() - view_depth / 2,
+                    along_track.back() + 1. + view_depth / 2, view_width / 2,
+                    [&](size_t row, size_t col_min, size_t col_max) {
+                        const double y = raster.y_coords(row) - origin.y;
+                        for (size_t col = col_min; col <= col_max; col++) {
+                            const double along = (raster.x_coords(col) - origin.x) * ux + y * uy;
+                            // footprints containing this cell: along - 1 - depth/2 <= along_track[i] <= along + depth/2
+                            const auto first = std::lower_bound(along_track.begin(), along_track.end(),
+                                                                along - 1. - view_depth / 2);
+                            const auto last = std::upper_bound(first, along_track.end(), along + view_depth / 2);
+                            if (first != last) {
+                                f(Cell{col, row}, (size_t) (first - along_track.begin()),
+                                  (size_t) (last - along_track.begin()) - 1);
+                            }
+                        }
+                    });
+        }
+    };
+}
+
+#endif //PLANNING_CPP_SWATH_HPP
@@ -30,6 +30,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <pybind11/numpy.h> // support for numpy arrays
 
 #include "firemapping/ghostmapper.hpp"
+#include "firemapping/reconstruction.hpp"
 #include "cpp_py_utils.hpp"
 
 #include "saop_logging.hpp"
@@ -47,10 +48,11 @@ PYBIND11_MODULE(firemapping, m) {
     }, py::arg("logger").none(false), "Use a python logger as Boost::Log sink");
 
     py::class_<GhostFireMapper<double>>(m, "GhostFireMapper")
-            .def(py::init<std::shared_ptr<FireData>>(), py::arg("environment_gt"))
+            .def(py::init<std::shared_ptr<FireData>, bool>(), py::arg("environment_gt"),
+                 py::arg("use_footprint_stamps") = false)
 
-            .def_property_readonly("firemap", &GhostFireMapper<double>::firemap)
-            .def_property_readonly("observed", &GhostFireMapper<double>::observed)
+            .def_property_readonly("firemap", &GhostFireMapper<double>::firemap_copy)
+            .def_property_readonly("observed", &GhostFireMapper<double>::observed_copy)
 
             .def("observe", (void (GhostFireMapper<double>::*)(const Trajectory&)) &GhostFireMapper<double>::observe,
                  py::arg("trajectory"))
@@ -59,7 +61,27 @@ PYBIND11_MODULE(firemapping, m) {
             .def("observe", (void (GhostFireMapper<double>::*)(const vector<Waypoint3d>&, const vector<double>&,
                                                                const UAV&)) &GhostFireMapper<double>::observe,
                  py::arg("waypoint3d_list"), py::arg("time_list"), py::arg("uav"))
-
+            .def("observe_swaths",
+                 (void (GhostFireMapper<double>::*)(const Trajectories&, size_t))
+                         &GhostFireMapper<double>::observe_swaths,
+                 py::arg("trajectories"), py::arg("num_threads") = 0, py::call_guard<py::gil_scoped_release>(),
+                 "Observe from the trajectories by rasterizing swaths, see the other overload")
+            .def("observe_swaths",
+                 (void (GhostFireMapper<double>::*)(const vector<vector<Waypoint3d>>&, const vector<vector<double>>&,
+                                                    const vector<UAV>&, size_t))
+                         &GhostFireMapper<double>::observe_swaths,
+                 py::arg("waypoint3d_lists"), py::arg("time_lists"), py::arg("uavs"), py::arg("num_threads") = 0,
+                 py::call_guard<py::gil_scoped_release>(),
+                 "Faster equivalent of observe() on each list of waypoints, selecting cells by their center in the "
+                 "swath of straight runs. 1 to 2% of the observed cells differ from observe() and observation "
+                 "times can be later by up to the time needed to fly over a cell")
+
+            .def("observe_pose", &GhostFireMapper<double>::observe_pose,
+                 py::arg("uav"), py::arg("pose"), py::arg("time"), py::call_guard<py::gil_scoped_release>())
+            .def("take_dirty_tiles", &GhostFireMapper<double>::take_dirty_tiles,
+                 "Areas of the maps modified by observe_pose and observe_swaths since the previous call")
+            .def("firemap_area", &GhostFireMapper<double>::firemap_area, py::arg("area"))
+            .def("observed_area", &GhostFireMapper<double>::observed_area, py::arg("area"))
             .def("observed_fire",
                  (GenRaster<double> (GhostFireMapper<double>::*)(const std::vector<Waypoint3d>&,
                                                                  const std::vector<double>&,
@@ -67,6 +89,21 @@ PYBIND11_MODULE(firemapping, m) {
                          &GhostFireMapper<double>::observed_fire, py::arg("waypoint3d_list"), py::arg("time_list"),
                  py::arg("uav"));
 
+    py::class_<FireMapReconstruction>(m, "FireMapReconstruction",
+                                      "Dense fire map interpolated from sparse observations with compactly "
+                                      "supported (Wendland) radial weights")
+            .def(py::init<double, size_t, size_t, double>(), py::arg("support_radius"),
+                 py::arg("max_neighbors") = 16, py::arg("num_threads") = 0,
+                 py::arg("no_data") = std::numeric_limits<double>::infinity())
+            .def("reconstruct",
+                 (GenRaster<double> (FireMapReconstruction::*)(const std::vector<PositionTime>&,
+                                                               const GenRaster<double>&) const)
+                         &FireMapReconstruction::reconstruct<double>,
+                 py::arg("observations"), py::arg("like"), py::call_guard<py::gil_scoped_release>())
+            .def("reconstruct",
+                 (GenRaster<double> (FireMapReconstruction::*)(const GenRaster<double>&) const)
+                         &FireMapReconstruction::reconstruct<double>,
+                 py::arg("observed_map"), py::call_guard<py::gil_scoped_release>());
 }
 
-#endif //PLANNING_CPP_PYTHON_NEPTUS_H
\ No newline at end of file
+#endif //PLANNING_CPP_PYTHON_NEPTUS_H
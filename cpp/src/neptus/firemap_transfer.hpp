@@ -0,0 +1,394 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#ifndef PLANNING_CPP_FIREMAP_TRANSFER_HPP
+#define PLANNING_CPP_FIREMAP_TRANSFER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "../core/raster.hpp"
+#include "../ext/optional.hpp"
+
+namespace SAOP {
+    namespace neptus {
+
+        /* Transfer of fire maps by tile-addressed delta updates, so that only the parts of a map that changed are
+         * sent, and maps larger than an IMC message can be sent at all.
+         *
+         * An update carries the geometry of the map and the content of some of its square tiles, each compressed
+         * on its own. Updates are numbered and split into fragments, each sent as the value of a DevDataBinary:
+         *   uint16 magic number (0xF13F), uint32 stream id, uint32 sequence number of the update,
+         *   uint16 fragment index, uint16 fragment count, then a slice of the update.
+         * The stream id, drawn at random by each encoder, tells a restarted sender, numbering updates from 1 again.
+         * An update is:
+         *   uint64 EPSG code, uint64 x_width, uint64 y_height, double x_offset, double y_offset, double cell_width,
+         *   uint64 tile size, uint64 tile count, then for each tile:
+         *   uint64 tile x index, uint64 tile y index, uint64 compressed size, its zlib compressed cells (rows of doubles).
+         * Values are in the byte order of the sender, as in GenRaster::encoded.
+         *
+         * A tile carries its whole content: an update can be applied even if previous ones were lost. Only tiles
+         * older than the ones already received are ignored. */
+        namespace firemap_transfer {
+            static const char magic_number[2] = {static_cast<char>(0xF1), static_cast<char>(0x3F)};
+
+            static constexpr size_t fragment_header_size =
+                    2 * sizeof(char) + 2 * sizeof(uint32_t) + 2 * sizeof(uint16_t);
+
+            template<typename U>
+            static void write(const U& value, std::vector<char>& buffer) {
+                char const* begin = reinterpret_cast<char const*>(&value);
+                buffer.insert(buffer.end(), begin, begin + sizeof(U));
+            }
+
+            template<typename U>
+            static U read(const char*& it, const char* end) {
+                if (static_cast<size_t>(end - it) < sizeof(U)) {
+                    throw std::invalid_argument("Malformed fire map update");
+                }
+                U value;
+                std::memcpy(&value, it, sizeof(U));
+                it += sizeof(U);
+                return value;
+            }
+        }
+
+        /* Onboard side: encode the modified areas of a fire map as delta updates */
+        class FireMapEncoder {
+            uint64_t epsg_code;
+            size_t tile_size;
+            size_t max_fragment_size;
+            uint32_t stream;
+            uint32_t sequence = 0;
+
+        public:
+            /* 'max_fragment_size' bounds the size of each DevDataBinary value, fragment header included.
+             * The default leaves room for the IMC headers in a UDP datagram. */
+            explicit FireMapEncoder(uint64_t epsg_code, size_t tile_size = 64, size_t max_fragment_size = 60000)
+                    : epsg_code(epsg_code), tile_size(tile_size), max_fragment_size(max_fragment_size),
+                      stream(std::random_device()()) {
+                ASSERT(tile_size > 0);
+                ASSERT(max_fragment_size > firemap_transfer::fragment_header_size);
+            }
+
+            /* Fragments of the next update, carrying the tiles overlapping the given areas of the map
+             * (e.g. the ones returned by GhostFireMapper::take_dirty_tiles()) */
+            std::vector<std::vector<char>> encode(const DRaster& map, const std::vector<CellRect>& areas) {
+                using namespace firemap_transfer;
+                const size_t x_tiles = (map.x_width + tile_size - 1) / tile_size;
+                const size_t y_tiles = (map.y_height + tile_size - 1) / tile_size;
+
+                std::vector<bool> selected(x_tiles * y_tiles, false);
+                std::vector<size_t> tiles;
+                for (const auto& area : areas) {
+                    if (area.empty()) {
+                        continue;
+                    }
+                    ASSERT(area.x_max <= map.x_width && area.y_max <= map.y_height);
+                    for (size_t ty = area.y_min / tile_size; ty <= (area.y_max - 1) / tile_size; ty++) {
+                        for (size_t tx = area.x_min / tile_size; tx <= (area.x_max - 1) / tile_size; tx++) {
+                            if (!selected[tx + ty * x_tiles]) {
+                                selected[tx + ty * x_tiles] = true;
+                                tiles.push_back(tx + ty * x_tiles);
+                            }
+                        }
+                    }
+                }
+
+                std::vector<char> update;
+                write<uint64_t>(epsg_code, update);
+                write<uint64_t>(map.x_width, update);
+                write<uint64_t>(map.y_height, update);
+                write<double>(map.x_offset, update);
+                write<double>(map.y_offset, update);
+                write<double>(map.cell_width, update);
+                write<uint64_t>(tile_size, update);
+                write<uint64_t>(tiles.size(), update);
+
+                std::vector<double> cells;
+                std::vector<unsigned char> compressed;
+                for (size_t tile : tiles) {
+                    const size_t x_min = (tile % x_tiles) * tile_size;
+                    const size_t y_min = (tile / x_tiles) * tile_size;
+                    const size_t x_max = std::min(x_min + tile_size, map.x_width);
+                    const size_t y_max = std::min(y_min + tile_size, map.y_height);
+                    cells.clear();
+                    for (size_t y = y_min; y < y_max; y++) {
+                        cells.insert(cells.end(), map.data.begin() + y * map.x_width + x_min,
+                                     map.data.begin() + y * map.x_width + x_max);
+                    }
+
+                    uLongf compressed_size = compressBound(cells.size() * sizeof(double));
+                    compressed.resize(compressed_size);
+                    if (compress(compressed.data(), &compressed_size, reinterpret_cast<const Bytef*>(cells.data()),
+                                 cells.size() * sizeof(double)) != Z_OK) {
+                        throw std::runtime_error("Fire map tile compression failed");
+                    }
+                    write<uint64_t>(tile % x_tiles, update);
+                    write<uint64_t>(tile / x_tiles, update);
+                    write<uint64_t>(compressed_size, update);
+                    update.insert(update.end(), compressed.begin(), compressed.begin() + compressed_size);
+                }
+
+                const size_t slice_size = max_fragment_size - fragment_header_size;
+                const size_t n_fragments = (update.size() + slice_size - 1) / slice_size;
+                if (n_fragments > std::numeric_limits<uint16_t>::max()) {
+                    throw std::invalid_argument("Fire map update too large for its fragment size");
+                }
+                sequence++;
+
+                std::vector<std::vector<char>> fragments;
+                for (size_t i = 0; i < n_fragments; i++) {
+                    std::vector<char> fragment(magic_number, magic_number + 2);
+                    write<uint32_t>(stream, fragment);
+                    write<uint32_t>(sequence, fragment);
+                    write<uint16_t>(static_cast<uint16_t>(i), fragment);
+                    write<uint16_t>(static_cast<uint16_t>(n_fragments), fragment);
+                    fragment.insert(fragment.end(), update.begin() + i * slice_size,
+                                    update.begin() + std::min((i + 1) * slice_size, update.size()));
+                    fragments.emplace_back(std::move(fragment));
+                }
+                return fragments;
+            }
+
+            /* Fragments of an update carrying the whole map, e.g. for a new receiver */
+            std::vector<std::vector<char>> encode_all(const DRaster& map) {
+                return encode(map, {CellRect{0, 0, map.x_width, map.y_height}});
+            }
+
+            /* Sequence number of the last update encoded, 0 if none */
+            uint32_t last_sequence() const {
+                return sequence;
+            }
+        };
+
+        /* Ground side: reassemble delta updates and patch the fire map in place */
+        class FireMapReceiver {
+            /* Fragments received of an update not complete yet */
+            struct PartialUpdate {
+                std::vector<std::vector<char>> fragments;
+                size_t n_received;
+            };
+
+            /* Beyond this, the partial update with the lowest sequence number is abandoned */
+            static constexpr size_t max_partial_updates = 8;
+
+            /* Largest map (8192 x 8192 cells) and tile side accepted, bounding the memory a sender can make the
+             * receiver allocate */
+            static constexpr uint64_t max_map_cells = uint64_t(1) << 26;
+            static constexpr uint64_t max_tile_size = 4096;
+
+            opt<DRaster> map;
+            uint64_t epsg_code = 0;
+            size_t tile_size = 0;
+            /* Stream of the last update applied, and sequence number of the update that last wrote each tile in
+             * this stream, 0 if none */
+            uint32_t stream = 0;
+            std::vector<uint32_t> tile_sequence;
+            /* Keyed by (stream, sequence number) */
+            std::map<std::pair<uint32_t, uint32_t>, PartialUpdate> partial_updates;
+
+        public:
+            /* Whether a DevDataBinary value is a fragment of a fire map update */
+            static bool is_fragment(const std::vector<char>& value) {
+                return value.size() >= firemap_transfer::fragment_header_size &&
+                       value[0] == firemap_transfer::magic_number[0] && value[1] == firemap_transfer::magic_number[1];
+            }
+
+            /* Take a fragment. When it completes an update, the update is applied and the areas of the map it
+             * modified are returned. Throws std::invalid_argument on malformed data, or if the map exceeds
+             * max_map_cells or its tiles max_tile_size. */
+            std::vector<CellRect> receive(const std::vector<char>& fragment) {
+                using namespace firemap_transfer;
+                if (!is_fragment(fragment)) {
+                    throw std::invalid_argument("Not a fire map update fragment");
+                }
+                const char* it = fragment.data() + sizeof(magic_number);
+                const char* end = fragment.data() + fragment.size();
+                auto update_stream = read<uint32_t>(it, end);
+                auto sequence = read<uint32_t>(it, end);
+                auto index = read<uint16_t>(it, end);
+                auto count = read<uint16_t>(it, end);
+                if (index >= count) {
+                    throw std::invalid_argument("Malformed fire map update");
+                }
+
+                if (count == 1) {
+                    return apply(update_stream, sequence, it, end);
+                }
+
+                const auto key = std::make_pair(update_stream, sequence);
+                auto p = partial_updates.find(key);
+                if (p == partial_updates.end()) {
+                    if (partial_updates.size() >= max_partial_updates) {
+                        partial_updates.erase(std::min_element(
+                                partial_updates.begin(), partial_updates.end(),
+                                [](const std::pair<const std::pair<uint32_t, uint32_t>, PartialUpdate>& a,
+                                   const std::pair<const std::pair<uint32_t, uint32_t>, PartialUpdate>& b) {
+                                    return a.first.second < b.first.second;
+                                }));
+                    }
+                    p = partial_updates.emplace(key, PartialUpdate{std::vector<std::vector<char>>(count), 0}).first;
+                } else if (p->second.fragments.size() != count) {
+                    throw std::invalid_argument("Malformed fire map update");
+                }
+                PartialUpdate& partial = p->second;
+                if (partial.fragments[index].empty()) {
+                    partial.fragments[index].assign(it, end);
+                    partial.n_received++;
+                }
+                if (partial.n_received < count) {
+                    return {};
+                }
+
+                std::vector<char> update;
+                for (const auto& f : partial.fragments) {
+                    update.insert(update.end(), f.begin(), f.end());
+                }
+                partial_updates.erase(p);
+                return apply(update_stream, sequence, update.data(), update.data() + update.size());
+            }
+
+            bool has_firemap() const {
+                return static_cast<bool>(map);
+            }
+
+            /* Current fire map, with infinite values where nothing was received */
+            const DRaster& firemap() const {
+                ASSERT(map);
+                return *map;
+            }
+
+            /* EPSG code of the coordinates of the current fire map */
+            uint64_t epsg() const {
+                return epsg_code;
+            }
+
+        private:
+            struct Tile {
+                size_t x_index;
+                size_t y_index;
+                std::vector<double> cells;
+            };
+
+            std::vector<CellRect> apply(uint32_t update_stream, uint32_t sequence, const char* it, const char* end) {
+                using namespace firemap_transfer;
+                auto epsg = read<uint64_t>(it, end);
+                auto x_width = read<uint64_t>(it, end);
+                auto y_height = read<uint64_t>(it, end);
+                auto x_offset = read<double>(it, end);
+                auto y_offset = read<double>(it, end);
+                auto cell_width = read<double>(it, end);
+                auto new_tile_size = read<uint64_t>(it, end);
+                auto n_tiles = read<uint64_t>(it, end);
+                if (new_tile_size == 0 || x_width == 0 || y_height == 0) {
+                    throw std::invalid_argument("Malformed fire map update");
+                }
+                if (x_width > max_map_cells / y_height || new_tile_size > max_tile_size) {
+                    throw std::invalid_argument("Fire map update exceeds the size limits of the receiver");
+                }
+                const size_t x_tiles = (x_width + new_tile_size - 1) / new_tile_size;
+                const size_t y_tiles = (y_height + new_tile_size - 1) / new_tile_size;
+                if (n_tiles > x_tiles * y_tiles) {
+                    throw std::invalid_argument("Malformed fire map update");
+                }
+
+                // Decode everything before touching the map, so that a malformed update leaves it unchanged.
+                // Each tile is accepted once, so that decoded tiles never take more memory than the map.
+                std::vector<Tile> tiles;
+                std::vector<bool> decoded(x_tiles * y_tiles, false);
+                for (uint64_t i = 0; i < n_tiles; i++) {
+                    Tile t;
+                    t.x_index = read<uint64_t>(it, end);
+                    t.y_index = read<uint64_t>(it, end);
+                    auto compressed_size = read<uint64_t>(it, end);
+                    if (t.x_index >= x_tiles || t.y_index >= y_tiles || decoded[t.x_index + t.y_index * x_tiles] ||
+                        compressed_size > static_cast<uint64_t>(end - it)) {
+                        throw std::invalid_argument("Malformed fire map update");
+                    }
+                    decoded[t.x_index + t.y_index * x_tiles] = true;
+                    const size_t tile_x_width = std::min<size_t>(new_tile_size, x_width - t.x_index * new_tile_size);
+                    const size_t tile_y_height = std::min<size_t>(new_tile_size, y_height - t.y_index * new_tile_size);
+                    t.cells.resize(tile_x_width * tile_y_height);
+                    uLongf size = t.cells.size() * sizeof(double);
+                    if (uncompress(reinterpret_cast<Bytef*>(t.cells.data()), &size,
+                                   reinterpret_cast<const Bytef*>(it), compressed_size) != Z_OK ||
+                        size != t.cells.size() * sizeof(double)) {
+                        throw std::invalid_argument("Malformed fire map update");
+                    }
+                    it += compressed_size;
+                    tiles.emplace_back(std::move(t));
+                }
+
+                if (!map || !(map->x_width == x_width && map->y_height == y_height && map->x_offset == x_offset &&
+                              map->y_offset == y_offset && map->cell_width == cell_width) ||
+                    tile_size != new_tile_size || epsg_code != epsg) {
+                    // New map, or its geometry changed: start over
+                    map = DRaster(std::vector<double>(x_width * y_height, std::numeric_limits<double>::infinity()),
+                                  x_width, y_height, x_offset, y_offset, cell_width);
+                    epsg_code = epsg;
+                    tile_size = new_tile_size;
+                    tile_sequence = std::vector<uint32_t>(x_tiles * y_tiles, 0);
+                } else if (update_stream != stream) {
+                    // Another sender, or the same one restarted: its sequence numbers are not comparable
+                    std::fill(tile_sequence.begin(), tile_sequence.end(), 0);
+                }
+                stream = update_stream;
+
+                std::vector<CellRect> updated;
+                for (const auto& t : tiles) {
+                    uint32_t& last_sequence = tile_sequence[t.x_index + t.y_index * x_tiles];
+                    if (sequence <= last_sequence) {
+                        // Already received from a more recent update
+                        continue;
+                    }
+                    last_sequence = sequence;
+
+                    const size_t x_min = t.x_index * tile_size;
+                    const size_t y_min = t.y_index * tile_size;
+                    const size_t tile_x_width = std::min(tile_size, map->x_width - x_min);
+                    for (size_t row = 0; row < t.cells.size() / tile_x_width; row++) {
+                        std::copy(t.cells.begin() + row * tile_x_width, t.cells.begin() + (row + 1) * tile_x_width,
+                                  map->data.begin() + (y_min + row) * map->x_width + x_min);
+                    }
+                    updated.push_back(CellRect{x_min, y_min, x_min + tile_x_width,
+                                               y_min + t.cells.size() / tile_x_width});
+                }
+                return updated;
+            }
+        };
+    }
+}
+
+#endif //PLANNING_CPP_FIREMAP_TRANSFER_HPP
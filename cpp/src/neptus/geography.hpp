@@ -24,7 +24,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #ifndef PLANNING_CPP_GEOGRAPHY_HPP
 #define PLANNING_CPP_GEOGRAPHY_HPP
 
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include <gdal/ogr_spatialref.h>
@@ -60,36 +65,90 @@ namespace SAOP {
             return wgs84_wp;
         }
 
-        static std::vector<Waypoint3d> transform_coordinates(const std::vector<Waypoint3d>& from_wp, int from, int to) {
-            OGRSpatialReference dst_sr;
-            OGRSpatialReference src_sr;
-            src_sr.importFromEPSG(from);
-            dst_sr.importFromEPSG(to);
-
-            auto poCT = OGRCreateCoordinateTransformation(&src_sr, &dst_sr);
-            if (poCT == nullptr) {
-                // If the conversion cannot take place, poCT is null
-                throw std::invalid_argument("The conversion cannot take between the given coordinate systems");
+        /* Transformations between EPSG coordinate systems, created once per (from, to) pair and shared by all threads.
+         * Creating a transformation involves EPSG database lookups, far more costly than transforming points. */
+        class CoordinateTransformations {
+            struct Transformation {
+                std::unique_ptr<OGRCoordinateTransformation> ct;
+                /* A transformation must not be used by several threads at once */
+                std::mutex mtx;
+            };
+
+            std::mutex cache_mtx;
+            std::map<std::pair<int, int>, std::unique_ptr<Transformation>> cache;
+
+            static CoordinateTransformations& instance() {
+                static CoordinateTransformations transformations;
+                return transformations;
             }
 
-            double xx;
-            double yy;
-            auto to_wp = std::vector<Waypoint3d>();
+            Transformation& get(int from, int to) {
+                std::lock_guard<std::mutex> lock(cache_mtx);
+                auto& t = cache[std::make_pair(from, to)];
+                if (!t) {
+                    OGRSpatialReference dst_sr;
+                    OGRSpatialReference src_sr;
+                    src_sr.importFromEPSG(from);
+                    dst_sr.importFromEPSG(to);
+
+                    std::unique_ptr<OGRCoordinateTransformation> ct(OGRCreateCoordinateTransformation(&src_sr, &dst_sr));
+                    if (ct == nullptr) {
+                        // If the conversion cannot take place, ct is null
+                        cache.erase(std::make_pair(from, to));
+                        throw std::invalid_argument("The conversion cannot take between the given coordinate systems");
+                    }
+                    t.reset(new Transformation());
+                    t->ct = std::move(ct);
+                }
+                return *t;
+            }
 
-            for (auto it = from_wp.begin(); it < from_wp.end(); ++it) {
-                xx = it->x;
-                yy = it->y;
-                poCT->Transform(1, &xx, &yy); // Again Transform must succed
+        public:
+            /* Transform in place the n points (x[i], y[i]) from one EPSG coordinate system to another */
+            static void transform(int from, int to, size_t n, double* x, double* y) {
+                Transformation& t = instance().get(from, to);
+                std::lock_guard<std::mutex> lock(t.mtx);
+                t.ct->Transform(static_cast<int>(n), x, y); // Again Transform must succed
+            }
+        };
 
-                to_wp.emplace_back(Waypoint3d(xx / 180 * M_PI, yy / 180 * M_PI, it->z, it->dir));
-                xx = 0;
-                yy = 0;
+        /* Transform in place a batch of points given by their coordinates */
+        static void transform_coordinates(std::vector<double>& xs, std::vector<double>& ys, int from, int to) {
+            if (xs.size() != ys.size()) {
+                throw std::invalid_argument("Coordinate arrays of different sizes");
             }
-            delete poCT;
+            CoordinateTransformations::transform(from, to, xs.size(), xs.data(), ys.data());
+        }
 
+        /* Transform projected waypoints into geographic ones, in radians */
+        static std::vector<Waypoint3d> transform_coordinates(const std::vector<Waypoint3d>& from_wp, int from, int to) {
+            auto xs = std::vector<double>();
+            auto ys = std::vector<double>();
+            xs.reserve(from_wp.size());
+            ys.reserve(from_wp.size());
+            for (const auto& wp : from_wp) {
+                xs.push_back(wp.x);
+                ys.push_back(wp.y);
+            }
+
+            transform_coordinates(xs, ys, from, to);
+
+            auto to_wp = std::vector<Waypoint3d>();
+            to_wp.reserve(from_wp.size());
+            for (size_t i = 0; i < from_wp.size(); ++i) {
+                to_wp.emplace_back(Waypoint3d(xs[i] / 180 * M_PI, ys[i] / 180 * M_PI, from_wp[i].z, from_wp[i].dir));
+            }
             return to_wp;
         }
 
+        /* Transform a projected position into a geographic one, in radians */
+        static Position3d transform_coordinates(Position3d from_position, int from, int to) {
+            double x = from_position.x;
+            double y = from_position.y;
+            CoordinateTransformations::transform(from, to, 1, &x, &y);
+            return Position3d(x / 180 * M_PI, y / 180 * M_PI, from_position.z);
+        }
+
         /*Convert Lambert93 points to WGS84 (lat, lon) coordinates*/
         static std::vector<Waypoint3d> lambert93_to_world_coordinates(std::vector<Waypoint3d> lambert93_wp) {
             return transform_coordinates(lambert93_wp, EPSG_RGF93_LAMBERT93, EPSG_RGF93);
@@ -106,22 +165,16 @@ namespace SAOP {
 
         /*Convert LAEA points to ETRS89 (lat, lon) coordinates*/
         static Position3d laea_to_world_coordinates(Position3d laea_position) {
-            return transform_coordinates(
-                    std::vector<Waypoint3d>({Waypoint3d(laea_position.x, laea_position.y, laea_position.z, 0.)}),
-                    EPSG_ETRS89_LAEA, EPSG_ETRS89)[0].as_point();
+            return transform_coordinates(laea_position, EPSG_ETRS89_LAEA, EPSG_ETRS89);
         }
 
         static Position3d utm29n_to_world_coordinates(Position3d utm29n_position) {
-            return transform_coordinates(
-                    std::vector<Waypoint3d>({Waypoint3d(utm29n_position.x, utm29n_position.y, utm29n_position.z, 0.)}),
-                    EPSG_WGS84_UTM29N, EPSG_WGS84)[0].as_point();
+            return transform_coordinates(utm29n_position, EPSG_WGS84_UTM29N, EPSG_WGS84);
         }
 
         /*Convert Lambert93 points to WGS84 (lat, lon) coordinates*/
-        static Position3d lambert93_to_world_coordinates(Position3d laea_position) {
-            return transform_coordinates(
-                    std::vector<Waypoint3d>({Waypoint3d(laea_position.x, laea_position.y, laea_position.z, 0.)}),
-                    EPSG_RGF93_LAMBERT93, EPSG_RGF93)[0].as_point();
+        static Position3d lambert93_to_world_coordinates(Position3d lambert93_position) {
+            return transform_coordinates(lambert93_position, EPSG_RGF93_LAMBERT93, EPSG_RGF93);
         }
     }
 }
@@ -29,21 +29,157 @@ namespace SAOP {
 
         using boost::asio::ip::tcp;
 
+        constexpr size_t IMCComm::lane_batch_size;
+        constexpr uint16_t IMCTransportTCP::broadcast_address;
+        constexpr size_t IMCTransportTCP::max_pending;
+
+        IMCTCPSession::IMCTCPSession(boost::asio::io_service& io_service, tcp::socket socket,
+                                     std::function<void(std::unique_ptr<IMC::Message>)> recv_handler,
+                                     std::function<void(const IMCTCPSession*)> close_handler)
+                : socket(std::move(socket)), strand(io_service),
+                  recv_handler(std::move(recv_handler)), close_handler(std::move(close_handler)), open(true) {
+            boost::system::error_code error;
+            peer = this->socket.remote_endpoint(error);
+        }
+
+        void IMCTCPSession::start() {
+            BOOST_LOG_TRIVIAL(info) << "Session with " << peer << " started";
+            strand.post(boost::bind(&IMCTCPSession::async_read, shared_from_this()));
+        }
+
+        void IMCTCPSession::send(std::unique_ptr<IMC::Message> message) {
+            {
+                std::unique_lock<std::mutex> lock(outbox_mtx);
+                outbox.push_back(std::move(message));
+            }
+            strand.post(boost::bind(&IMCTCPSession::write_pending, shared_from_this()));
+        }
+
+        void IMCTCPSession::close() {
+            strand.post(boost::bind(&IMCTCPSession::do_close, shared_from_this()));
+        }
+
+        void IMCTCPSession::async_read() {
+            socket.async_read_some(boost::asio::buffer(recv_buffer),
+                                   strand.wrap(boost::bind(&IMCTCPSession::handle_read, shared_from_this(),
+                                                           boost::asio::placeholders::error,
+                                                           boost::asio::placeholders::bytes_transferred)));
+        }
+
+        void IMCTCPSession::handle_read(const boost::system::error_code& error, std::size_t bytes_transferred) {
+            if (error == boost::asio::error::eof) {
+                BOOST_LOG_TRIVIAL(info) << "Socket: " << error.message();
+                do_close(); // Connection closed cleanly by peer.
+                return;
+            } else if (error) {
+                if (error != boost::asio::error::operation_aborted) {
+                    BOOST_LOG_TRIVIAL(error) << "Socket: " << error.message();
+                }
+                do_close();
+                return;
+            }
+
+            // IMC message parsing. The parser keeps the incomplete message at the end of the buffer, if any.
+            parsed.clear();
+            parser.parse(recv_buffer.data(), bytes_transferred, parsed);
+            // owned before any is handed over, so that none leaks if recv_handler throws
+            std::vector<std::unique_ptr<IMC::Message>> received;
+            received.reserve(parsed.size());
+            for (IMC::Message* m : parsed) {
+                received.emplace_back(m);
+            }
+            parsed.clear();
+            for (auto& m : received) {
+                if (recv_handler) {
+                    recv_handler(std::move(m));
+                } else {
+                    BOOST_LOG_TRIVIAL(error) << "recv_handler not set. Received messages are being discarded.";
+                }
+            }
+            async_read();
+        }
+
+        void IMCTCPSession::write_pending() {
+            if (writing || !open) {
+                return;
+            }
+            {
+                std::unique_lock<std::mutex> lock(outbox_mtx);
+                in_flight.clear();
+                std::swap(in_flight, outbox);
+            }
+            if (in_flight.empty()) {
+                return;
+            }
+
+            // Coalesce all pending messages into a single write
+            size_t total = 0;
+            for (const auto& m : in_flight) {
+                total += m->getSerializationSize();
+            }
+            write_buffer.resize(total);
+            size_t n_bytes = 0;
+            for (const auto& m : in_flight) {
+                n_bytes += IMC::Packet::serialize(m.get(), write_buffer.data() + n_bytes, total - n_bytes);
+                BOOST_LOG_TRIVIAL(debug) << "Send " << m->getName() << "(" << static_cast<uint>(m->getId())
+                                         << "): "
+                                         << "from (" << m->getSource() << ", "
+                                         << static_cast<uint>(m->getSourceEntity())
+                                         << ") " << "to (" << m->getDestination() << ", "
+                                         << static_cast<uint>(m->getDestinationEntity()) << ")";
+            }
+
+            writing = true;
+            boost::asio::async_write(socket, boost::asio::buffer(write_buffer.data(), n_bytes),
+                                     strand.wrap(boost::bind(&IMCTCPSession::handle_write, shared_from_this(),
+                                                             boost::asio::placeholders::error,
+                                                             boost::asio::placeholders::bytes_transferred)));
+        }
+
+        void IMCTCPSession::handle_write(const boost::system::error_code& error, std::size_t) {
+            writing = false;
+            in_flight.clear();
+            if (error) {
+                if (error != boost::asio::error::operation_aborted) {
+                    BOOST_LOG_TRIVIAL(error) << "Socket: " << error.message();
+                }
+                do_close();
+                return;
+            }
+            // Messages sent during the write
+            write_pending();
+        }
+
+        void IMCTCPSession::do_close() {
+            if (!open) {
+                return;
+            }
+            open = false;
+            boost::system::error_code ignored;
+            socket.shutdown(tcp::socket::shutdown_both, ignored);
+            socket.close(ignored);
+            BOOST_LOG_TRIVIAL(info) << "Session with " << peer << " closed";
+            if (close_handler) {
+                close_handler(this);
+            }
+        }
+
         void IMCTransportTCP::loop() {
             try {
-                for (;;) {
-                    boost::asio::io_service io_service;
-                    tcp::acceptor a(io_service, tcp::endpoint(tcp::v4(), port));
-                    std::shared_ptr<tcp::socket> sock(new tcp::socket(io_service));
-                    BOOST_LOG_TRIVIAL(info) << "Waiting for an incoming connection on port " << port;
-                    tcp::endpoint client_endpoint;
-                    a.accept(*sock, client_endpoint);
-                    BOOST_LOG_TRIVIAL(info) << "Accepting connection from " << client_endpoint;
-                    session(std::move(sock));
+                acceptor.reset(new tcp::acceptor(io_service, tcp::endpoint(tcp::v4(), port)));
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "IMCTransportTCP cannot listen on port " << port << ": " << e.what();
+                return;
+            }
+            async_accept();
+            while (!io_service.stopped()) {
+                try {
+                    io_service.run();
+                } catch (const std::exception& e) {
+                    BOOST_LOG_TRIVIAL(warning) << "IMCTransportTCP network error: " << e.what();
                 }
-            } catch (...) {
-
             }
+            BOOST_LOG_TRIVIAL(info) << "IMCTransportTCP stopped";
         }
 
         /* Run without blocking */
@@ -51,65 +187,122 @@ namespace SAOP {
             session_thread = std::thread(std::bind(&IMCTransportTCP::loop, this));
         }
 
-        void IMCTransportTCP::session(std::shared_ptr<tcp::socket> sock) {
-            try {
-                BOOST_LOG_TRIVIAL(info) << "Socket " << (sock.get()) << " connected";
-                IMC::Parser parser = IMC::Parser();
-                IMC::ByteBuffer bb;
+        void IMCTransportTCP::async_accept() {
+            BOOST_LOG_TRIVIAL(info) << "Waiting for an incoming connection on port " << port;
+            auto sock = std::make_shared<tcp::socket>(io_service);
+            auto peer = std::make_shared<tcp::endpoint>();
+            acceptor->async_accept(*sock, *peer, boost::bind(&IMCTransportTCP::handle_accept, this, sock, peer,
+                                                             boost::asio::placeholders::error));
+        }
 
-                for (;;) {
-                    socket_connected = true;
-                    // TCP stream reception
-                    bb = IMC::ByteBuffer(65535);
-                    bb.setSize(65535);
-                    boost::system::error_code error;
-                    size_t length = sock->read_some(boost::asio::buffer(bb.getBuffer(), bb.getSize()), error);
-                    if (error == boost::asio::error::eof) {
-                        BOOST_LOG_TRIVIAL(info) << "Socket: " << error.message();
-                        break; // Connection closed cleanly by peer.
-                    } else if (error) {
-                        BOOST_LOG_TRIVIAL(error) << "Socket: " << error.message();
-                        throw boost::system::system_error(error); // Some other error.
-                    }
-                    // IMC message parsing
-                    size_t delta = 0;
-                    while (delta < length) {
-                        auto hb = parser.parse(*(bb.getBuffer() + delta));
-                        if (hb != nullptr) {
-//                            std::cout << "recv ";
-                            size_t ser_size = hb->getSerializationSize();
-                            if (recv_handler) {
-                                recv_handler(std::move(std::unique_ptr<IMC::Message>(hb)));
-                            } else {
-                                BOOST_LOG_TRIVIAL(error)
-                                    << "recv_handler not set. Received messages are being discarded.";
-                            }
-                            // Advance buffer cursor past the end of serialized hb.
-                            delta += ser_size;
-                        } else {
-                            delta++;
-                        }
+        void IMCTransportTCP::handle_accept(std::shared_ptr<tcp::socket> sock, std::shared_ptr<tcp::endpoint> peer,
+                                            const boost::system::error_code& error) {
+            if (error) {
+                BOOST_LOG_TRIVIAL(error) << "Accept: " << error.message();
+                if (error != boost::asio::error::operation_aborted) {
+                    async_accept();
+                }
+                return;
+            }
+            BOOST_LOG_TRIVIAL(info) << "Accepting connection from " << *peer;
+            sock->set_option(tcp::no_delay(true));
+
+            auto new_session = std::make_shared<IMCTCPSession>(
+                    io_service, std::move(*sock), nullptr,
+                    boost::bind(&IMCTransportTCP::handle_session_closed, this, _1));
+            // The handler only keeps a weak reference, the session must not own itself
+            std::weak_ptr<IMCTCPSession> weak_session = new_session;
+            new_session->set_recv_handler([this, weak_session](std::unique_ptr<IMC::Message> m) {
+                auto from = weak_session.lock();
+                if (from) {
+                    handle_message(from, std::move(m));
+                }
+            });
+            {
+                std::unique_lock<std::mutex> lock(session_mtx);
+                sessions.push_back(new_session);
+                // Broadcast messages sent while no peer was connected, the others wait for their route
+                auto broadcast = pending.find(broadcast_address);
+                if (broadcast != pending.end()) {
+                    for (auto& m : broadcast->second) {
+                        send_to_all(std::move(m));
                     }
+                    pending.erase(broadcast);
+                }
+            }
+            new_session->start();
 
-                    std::unique_ptr<IMC::Message> m = nullptr;
-                    while (send_q->pop(m)) {
-                        IMC::ByteBuffer serl_b = IMC::ByteBuffer(65535);
-                        size_t n_bytes = IMC::Packet::serialize(m.get(), serl_b);
-                        BOOST_LOG_TRIVIAL(debug) << "Send " << m->getName() << "(" << static_cast<uint>(m->getId())
-                                                 << "): "
-                                                 << "from (" << m->getSource() << ", "
-                                                 << static_cast<uint>(m->getSourceEntity())
-                                                 << ") " << "to (" << m->getDestination() << ", "
-                                                 << static_cast<uint>(m->getDestinationEntity()) << ")";
-                        boost::asio::write(*sock, boost::asio::buffer(serl_b.getBuffer(), n_bytes));
+            // Keep accepting other peers
+            async_accept();
+        }
+
+        void IMCTransportTCP::send(std::unique_ptr<IMC::Message> message) {
+            std::unique_lock<std::mutex> lock(session_mtx);
+            const uint16_t dst = message->getDestination();
+            auto route = routes.find(dst);
+            if (dst != broadcast_address && route != routes.end()) {
+                route->second->send(std::move(message));
+                return;
+            }
+            // Wait for a peer, and keep the order of the messages already waiting for this destination
+            if (sessions.empty() || pending.count(dst) > 0) {
+                auto& q = pending[dst];
+                if (q.size() >= max_pending) {
+                    BOOST_LOG_TRIVIAL(warning) << "No route to IMC system " << dst << ", dropping "
+                                               << q.front()->getName() << " message";
+                    q.pop_front();
+                }
+                q.push_back(std::move(message));
+                return;
+            }
+            send_to_all(std::move(message));
+        }
+
+        void IMCTransportTCP::send_to_all(std::unique_ptr<IMC::Message> message) {
+            for (size_t i = 1; i < sessions.size(); i++) {
+                sessions[i]->send(std::unique_ptr<IMC::Message>(message->clone()));
+            }
+            sessions[0]->send(std::move(message));
+        }
+
+        void IMCTransportTCP::handle_message(const std::shared_ptr<IMCTCPSession>& from,
+                                             std::unique_ptr<IMC::Message> message) {
+            {
+                std::unique_lock<std::mutex> lock(session_mtx);
+                auto route = routes.find(message->getSource());
+                if ((route == routes.end() || route->second != from) && from->is_open()) {
+                    BOOST_LOG_TRIVIAL(info) << "IMC system " << message->getSource() << " is reachable through "
+                                            << from->remote_endpoint();
+                    routes[message->getSource()] = from;
+                    auto waiting = pending.find(message->getSource());
+                    if (waiting != pending.end()) {
+                        for (auto& m : waiting->second) {
+                            from->send(std::move(m));
+                        }
+                        pending.erase(waiting);
                     }
                 }
             }
-            catch (std::exception& e) {
-                BOOST_LOG_TRIVIAL(error) << "Exception raised in IMCTransportTCP: " << e.what() << "\n";
-                socket_connected = false;
+            if (recv_handler) {
+                recv_handler(std::move(message));
+            } else {
+                BOOST_LOG_TRIVIAL(error) << "recv_handler not set. Received messages are being discarded.";
+            }
+        }
+
+        void IMCTransportTCP::handle_session_closed(const IMCTCPSession* closed) {
+            std::unique_lock<std::mutex> lock(session_mtx);
+            sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                          [closed](const std::shared_ptr<IMCTCPSession>& s) {
+                                              return s.get() == closed;
+                                          }), sessions.end());
+            for (auto it = routes.begin(); it != routes.end();) {
+                if (it->second.get() == closed) {
+                    it = routes.erase(it);
+                } else {
+                    ++it;
+                }
             }
-            socket_connected = false;
         }
 
         void IMCTransportUDP::recv_io_loop() {
@@ -181,37 +374,36 @@ namespace SAOP {
             message_thread = std::thread(std::bind(&IMCComm::loop, this));
         }
 
+        void IMCComm::stop() {
+            if (!message_thread.joinable()) {
+                return;
+            }
+            imc_transport->stop();
+            // Wakes up the dispatching loop, which ends once the messages received before it are dispatched
+            recv_q->push(nullptr);
+            message_thread.join();
+            // Lanes may still be scheduled on the workers, which stop accepting them when destroyed
+            {
+                std::unique_lock<std::mutex> lock(lanes_mtx);
+                all_handled.wait(lock, [this]() { return n_pending == 0; });
+            }
+            workers.reset();
+        }
+
         void IMCComm::message_dispatching_loop() {
+            // Messages only go through this thread to reach their lane, where they wait for a worker
+            workers.reset(new ThreadPool(dispatch_workers));
             try {
                 ready = true;
                 for (;;) {
                     std::unique_ptr<IMC::Message> m = nullptr;
                     while (recv_q->wait_pop(m)) {
-                        try {
-                            auto hnld_fun = message_bindings.at(m->getId());
-                            BOOST_LOG_TRIVIAL(debug) << "Process IMC message " << m->getName()
-                                                     << "(" << static_cast<uint>(m->getId()) << "): "
-                                                     << "from(" << m->getSource() << ", "
-                                                     << static_cast<uint>(m->getSourceEntity()) << ") "
-                                                     << "to(" << m->getDestination() << ", "
-                                                     << static_cast<uint>(m->getDestinationEntity()) << ")"
-                                                     << std::endl;
-                            hnld_fun(std::move(m));
-//                            auto m_raw = m.get();
-//                            m.release();
-//                            // variables can be moved into lambdas only from C++14 onwards, not C++11
-//                            thp.enqueue([hnld_fun, m_raw] {
-//                                std::unique_ptr<IMC::Message> mm = std::unique_ptr<IMC::Message>(m_raw);
-//                                hnld_fun(std::move(mm));
-//                            });
-                        } catch (const std::out_of_range& e) {
-                            BOOST_LOG_TRIVIAL(warning) << "Unhandled IMC message " << m->getName()
-                                                       << "(" << static_cast<uint>(m->getId()) << "): "
-                                                       << "from(" << m->getSource() << ", "
-                                                       << static_cast<uint>(m->getSourceEntity()) << ") "
-                                                       << "to(" << m->getDestination() << ", "
-                                                       << static_cast<uint>(m->getDestinationEntity()) << ")";
+                        if (!m) {
+                            // pushed by stop()
+                            ready = false;
+                            return;
                         }
+                        dispatch(std::move(m));
                     }
                 }
             } catch (...) {
@@ -220,5 +412,121 @@ namespace SAOP {
             }
             ready = false;
         }
+
+        void IMCComm::dispatch(std::unique_ptr<IMC::Message> m) {
+            const uint32_t key = (static_cast<uint32_t>(m->getSource()) << 16) | m->getId();
+            const uint16_t id = m->getId();
+            std::unique_lock<std::mutex> lock(lanes_mtx);
+            DispatchLane& lane = lanes[key];
+            auto policy = policies.find(id);
+            if (policy != policies.end() && policy->second.kind != DispatchPolicy::Kind::Fifo) {
+                // Messages already taken by a worker are not in 'pending' and cannot be dropped
+                while (lane.pending.size() >= policy->second.capacity) {
+                    lane.pending.pop_front();
+                    dropped[id]++;
+                    n_pending--;
+                }
+            }
+            lane.pending.push_back(std::move(m));
+            if (!lane.scheduled) {
+                lane.scheduled = true;
+                workers->enqueue(&IMCComm::drain_lane, this, key);
+            }
+        }
+
+        void IMCComm::drain_lane(uint32_t key) {
+            for (size_t handled = 0;; handled++) {
+                std::unique_ptr<IMC::Message> m;
+                {
+                    std::unique_lock<std::mutex> lock(lanes_mtx);
+                    if (handled > 0 && --n_pending == 0) {
+                        // the previous message was the last one received
+                        all_handled.notify_all();
+                    }
+                    DispatchLane& lane = lanes[key];
+                    if (lane.pending.empty()) {
+                        lane.scheduled = false;
+                        return;
+                    }
+                    if (handled == lane_batch_size) {
+                        // Still in charge of the lane, but let the lanes queued meanwhile run first
+                        workers->enqueue(&IMCComm::drain_lane, this, key);
+                        return;
+                    }
+                    m = std::move(lane.pending.front());
+                    lane.pending.pop_front();
+                }
+                handle(std::move(m));
+            }
+        }
+
+        void IMCComm::handle(std::unique_ptr<IMC::Message> m) {
+            std::shared_ptr<const MessageHandler> hndl_fun;
+            {
+                std::unique_lock<std::mutex> lock(*binding_mtx);
+                auto binding = message_bindings.find(m->getId());
+                if (binding != message_bindings.end()) {
+                    hndl_fun = binding->second;
+                }
+            }
+            if (!hndl_fun) {
+                BOOST_LOG_TRIVIAL(warning) << "Unhandled IMC message " << m->getName()
+                                           << "(" << static_cast<uint>(m->getId()) << "): "
+                                           << "from(" << m->getSource() << ", "
+                                           << static_cast<uint>(m->getSourceEntity()) << ") "
+                                           << "to(" << m->getDestination() << ", "
+                                           << static_cast<uint>(m->getDestinationEntity()) << ")";
+                return;
+            }
+            BOOST_LOG_TRIVIAL(debug) << "Process IMC message " << m->getName()
+                                     << "(" << static_cast<uint>(m->getId()) << "): "
+                                     << "from(" << m->getSource() << ", "
+                                     << static_cast<uint>(m->getSourceEntity()) << ") "
+                                     << "to(" << m->getDestination() << ", "
+                                     << static_cast<uint>(m->getDestinationEntity()) << ")";
+            const uint16_t id = m->getId();
+            auto t_start = std::chrono::steady_clock::now();
+            try {
+                (*hndl_fun)(std::move(m));
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "Exception raised by an IMC message handler: " << e.what();
+            } catch (...) {
+                // A worker must survive any handler, or its lane would stay scheduled forever
+                BOOST_LOG_TRIVIAL(error) << "Unknown exception raised by an IMC message handler";
+            }
+            double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+
+            std::unique_lock<std::mutex> lock(stats_mtx);
+            HandlerStats& hs = stats[id];
+            hs.count++;
+            hs.total_time += duration;
+            hs.max_time = std::max(hs.max_time, duration);
+        }
+
+        size_t IMCReplayTransport::replay(const std::vector<IMCRecord>& records, double speed) {
+            ASSERT(speed >= 0.);
+            if (records.empty()) {
+                return 0;
+            }
+            const auto t_start = std::chrono::steady_clock::now();
+            size_t n_delivered = 0;
+            for (const auto& r : records) {
+                if (speed > 0.) {
+                    auto due = t_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>((r.time - records.front().time) / speed));
+                    std::this_thread::sleep_until(due);
+                }
+                try {
+                    std::unique_ptr<IMC::Message> m(IMC::Packet::deserialize(r.packet.data(), r.packet.size()));
+                    if (m && recv_handler) {
+                        recv_handler(std::move(m));
+                        n_delivered++;
+                    }
+                } catch (const std::exception& e) {
+                    BOOST_LOG_TRIVIAL(warning) << "Skip recorded IMC packet: " << e.what();
+                }
+            }
+            return n_delivered;
+        }
     }
 }
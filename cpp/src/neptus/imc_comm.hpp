@@ -24,13 +24,18 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #ifndef PLANNING_CPP_IMC_SERVER_HPP
 #define PLANNING_CPP_IMC_SERVER_HPP
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <unordered_map>
 #include <mutex>
 #include <queue>
@@ -56,6 +61,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "../vns/plan.hpp"
 
 #include "imc_message_factories.hpp"
+#include "imc_recording.hpp"
 
 namespace SAOP {
     namespace neptus {
@@ -67,7 +73,7 @@ namespace SAOP {
 
         class IMCTransport {
         public:
-//            virtual ~IMCTransport() = 0;
+            virtual ~IMCTransport() = default;
 
             virtual void run() = 0;
 
@@ -111,8 +117,7 @@ namespace SAOP {
             }
 
             ~IMCTransportUDP() {
-                io_service.stop();
-                recv_thread.join();
+                stop();
             }
 
             void run() override {
@@ -143,7 +148,9 @@ namespace SAOP {
 
             void stop() override {
                 io_service.stop();
-                recv_thread.join();
+                if (recv_thread.joinable()) {
+                    recv_thread.join();
+                }
             }
 
         private:
@@ -154,80 +161,271 @@ namespace SAOP {
             void handle_receive(const boost::system::error_code& error, std::size_t bytes_transferred);
         };
 
+        /* Asynchronous TCP session exchanging IMC messages with a single peer.
+         *
+         * Reception and emission are independent: a read is always pending on the socket, while messages given to
+         * send() wake up the writer, which serializes all the messages queued so far into a single write.
+         * Receive and send buffers are owned by the session and reused.
+         * All socket operations are serialized by the strand of the session. */
+        class IMCTCPSession : public std::enable_shared_from_this<IMCTCPSession> {
+        public:
+            IMCTCPSession(boost::asio::io_service& io_service, tcp::socket socket,
+                          std::function<void(std::unique_ptr<IMC::Message>)> recv_handler,
+                          std::function<void(const IMCTCPSession*)> close_handler = nullptr);
+
+            /* Set the function to be called on message reception. Must be called before start(). */
+            void set_recv_handler(std::function<void(std::unique_ptr<IMC::Message>)> a_recv_handler) {
+                recv_handler = std::move(a_recv_handler);
+            }
+
+            /* Start reading from the socket. Must be called once the session is owned by a shared_ptr. */
+            void start();
+
+            /* Enqueue a message to be sent. Can be called from any thread. */
+            void send(std::unique_ptr<IMC::Message> message);
+
+            /* Close the socket. close_handler is called with this session once it is closed. */
+            void close();
+
+            bool is_open() const {
+                return open;
+            }
+
+            const tcp::endpoint& remote_endpoint() const {
+                return peer;
+            }
+
+        private:
+            tcp::socket socket;
+            boost::asio::io_service::strand strand;
+            tcp::endpoint peer;
+
+            std::function<void(std::unique_ptr<IMC::Message>)> recv_handler;
+            std::function<void(const IMCTCPSession*)> close_handler;
+
+            std::array<uint8_t, 65535> recv_buffer = std::array<uint8_t, 65535>();
+            IMC::Parser parser;
+            std::vector<IMC::Message*> parsed;
+
+            /* Messages waiting to be written, filled by send() */
+            std::mutex outbox_mtx;
+            std::vector<std::unique_ptr<IMC::Message>> outbox;
+
+            /* Messages being written and their serialization. Only accessed within the strand. */
+            std::vector<std::unique_ptr<IMC::Message>> in_flight;
+            std::vector<uint8_t> write_buffer;
+            bool writing = false;
+
+            std::atomic<bool> open;
+
+            void async_read();
+
+            void handle_read(const boost::system::error_code& error, std::size_t bytes_transferred);
+
+            void write_pending();
+
+            void handle_write(const boost::system::error_code& error, std::size_t bytes_transferred);
+
+            void do_close();
+        };
+
+        /* TCP server exchanging IMC messages with any number of peers (DUNE instances, Neptus consoles...).
+         *
+         * Each accepted connection gets its own IMCTCPSession feeding the shared recv_handler. The IMC addresses
+         * found as source of the messages received from a peer are routed to its session: a message whose
+         * destination is one of them is only sent to that peer, others are sent to all peers.
+         *
+         * Messages sent while no peer is connected are kept per destination: broadcast ones are sent to the first
+         * peer accepted, the others wait until a peer announces their destination as source of one of its messages. */
         class IMCTransportTCP : public IMCTransport {
             unsigned short port;
 
             std::function<void(std::unique_ptr<IMC::Message>)> recv_handler;
-            std::shared_ptr<IMCMessageQueue> send_q;
 
-            std::thread session_thread;
+            /* Messages waiting for a route to their destination, by destination.
+             * Messages to broadcast_address are delivered to all peers as soon as one is connected. */
+            std::unordered_map<uint16_t, std::deque<std::unique_ptr<IMC::Message>>> pending;
+
+            boost::asio::io_service io_service;
+            std::unique_ptr<tcp::acceptor> acceptor;
 
-            bool socket_connected = false;
+            /* Open sessions and the session through which each known IMC address is reachable */
+            std::mutex session_mtx;
+            std::vector<std::shared_ptr<IMCTCPSession>> sessions;
+            std::unordered_map<uint16_t, std::shared_ptr<IMCTCPSession>> routes;
+
+            std::thread session_thread;
 
         public:
+            /* IMC destination address of messages intended to every system */
+            static constexpr uint16_t broadcast_address = 0xFFFF;
+
+            /* Maximum number of messages kept for a destination without route, the oldest are dropped first */
+            static constexpr size_t max_pending = 1000;
+
             explicit IMCTransportTCP(unsigned short port)
-                    : port(port), recv_handler(nullptr), send_q(std::make_shared<IMCMessageQueue>()) {}
+                    : port(port), recv_handler(nullptr) {}
 
             IMCTransportTCP(unsigned short port,
                             std::function<void(std::unique_ptr<IMC::Message>)> recv_handler)
-                    : port(port), recv_handler(std::move(recv_handler)),
-                      send_q(std::make_shared<IMCMessageQueue>()) {}
+                    : port(port), recv_handler(std::move(recv_handler)) {}
+
+            ~IMCTransportTCP() {
+                stop();
+            }
 
+            /* Accept connections and run the sessions until stop() is called */
             void loop();
 
             void run() override;
 
-            void session(std::shared_ptr<tcp::socket> sock);
-
             /* Set function the function to be called on message reception */
             void set_recv_handler(std::function<void(std::unique_ptr<IMC::Message>)> a_recv_handler) override {
                 recv_handler = std::move(a_recv_handler);
             }
 
-            /* Enqueue message to be sent */
+            /* Send a message to the peer through which its destination is reachable, or to all peers if the
+             * destination is unknown or broadcast. If there is no peer, the message is kept until one connects or, if
+             * it has a specific destination, until the peer through which it is reachable is known.
+             * Does not wait for the message to be written. */
+            void send(std::unique_ptr<IMC::Message> message) override;
+
+            /* True if at least one peer is connected */
+            bool is_ready() override {
+                std::unique_lock<std::mutex> lock(session_mtx);
+                return !sessions.empty();
+            }
+
+            size_t num_sessions() {
+                std::unique_lock<std::mutex> lock(session_mtx);
+                return sessions.size();
+            }
+
+            void stop() override {
+                io_service.stop();
+                if (session_thread.joinable()) {
+                    session_thread.join();
+                }
+            }
+
+        private:
+            void async_accept();
+
+            void handle_accept(std::shared_ptr<tcp::socket> sock, std::shared_ptr<tcp::endpoint> peer,
+                               const boost::system::error_code& error);
+
+            /* Send the message to all peers. Must be called with session_mtx held. */
+            void send_to_all(std::unique_ptr<IMC::Message> message);
+
+            /* Learn the route to the source of the message and flush the messages waiting for it,
+             * then pass the message to recv_handler */
+            void handle_message(const std::shared_ptr<IMCTCPSession>& from, std::unique_ptr<IMC::Message> message);
+
+            void handle_session_closed(const IMCTCPSession* closed);
+        };
+
+        /* In-process transport delivering the messages of a recording, to benchmark and profile message handling
+         * without vehicles. Messages sent are discarded. */
+        class IMCReplayTransport : public IMCTransport {
+            std::function<void(std::unique_ptr<IMC::Message>)> recv_handler;
+            std::atomic<bool> ready;
+            std::atomic<size_t> n_sent;
+
+        public:
+            IMCReplayTransport() : recv_handler(nullptr), ready(false), n_sent(0) {}
+
+            void run() override {
+                ready = true;
+            }
+
+            void set_recv_handler(std::function<void(std::unique_ptr<IMC::Message>)> a_recv_handler) override {
+                recv_handler = std::move(a_recv_handler);
+            }
+
             void send(std::unique_ptr<IMC::Message> message) override {
-                send_q->push(std::move(message));
+                n_sent++;
             }
 
             bool is_ready() override {
-                return socket_connected;
+                return ready;
             }
 
             void stop() override {
-                // FIXME
+                ready = false;
+            }
+
+            /* Deliver the recorded messages in order. With speed == 0, as fast as possible. Otherwise keeping the
+             * recorded intervals between messages, divided by 'speed'. Returns the number of messages delivered. */
+            size_t replay(const std::vector<IMCRecord>& records, double speed = 0.);
+
+            /* Number of messages sent, and discarded, through this transport */
+            size_t sent_messages() const {
+                return n_sent;
+            }
+        };
+
+        /* Time spent by the handler of a message type */
+        struct HandlerStats {
+            size_t count;
+            double total_time; // seconds
+            double max_time; // seconds
+        };
+
+        /* How messages of one type from one source wait for their handler */
+        struct DispatchPolicy {
+            enum class Kind {
+                /* Every message is handled, in order. For commands. */
+                Fifo,
+                /* A message replaces the ones waiting before it. For state telemetry. */
+                LatestWins,
+                /* At most 'capacity' messages wait, the oldest being dropped. For bulk data. */
+                Bounded
+            };
+
+            Kind kind;
+            size_t capacity;
+
+            static DispatchPolicy fifo() {
+                return DispatchPolicy{Kind::Fifo, std::numeric_limits<size_t>::max()};
+            }
+
+            static DispatchPolicy latest_wins() {
+                return DispatchPolicy{Kind::LatestWins, 1};
+            }
+
+            static DispatchPolicy bounded(size_t capacity) {
+                ASSERT(capacity > 0);
+                return DispatchPolicy{Kind::Bounded, capacity};
             }
         };
 
         /* TODO: Enable shared_from_this ? */
         class IMCComm {
+            typedef std::function<void(std::unique_ptr<IMC::Message>)> MessageHandler;
+
             std::unique_ptr<IMCTransport> imc_transport;
             std::shared_ptr<IMCMessageQueue> recv_q;
-            std::unordered_map<size_t, std::function<void(std::unique_ptr<IMC::Message>)>> message_bindings;
+            /* Handlers are shared so that they are not copied on each message, nor destroyed while running */
+            std::unordered_map<size_t, std::shared_ptr<const MessageHandler>> message_bindings;
 
             std::unique_ptr<std::mutex> binding_mtx = std::unique_ptr<std::mutex>(new std::mutex());
 
-            ThreadPool thp;
-
         public:
             IMCComm() :
                     imc_transport(std::unique_ptr<IMCTransport>(new IMCTransportTCP(8888))),
-                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()),
-                    thp(1) {}
+                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()) {}
 
             explicit IMCComm(unsigned short port) :
                     imc_transport(std::unique_ptr<IMCTransport>(new IMCTransportTCP(port))),
-                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()),
-                    thp(1) {}
+                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()) {}
 
             IMCComm(unsigned short port, std::string dst_ip, std::string dst_port) :
                     imc_transport(std::unique_ptr<IMCTransport>(new IMCTransportUDP(port, dst_ip, dst_port))),
-                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()),
-                    thp(1) {}
+                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()) {}
 
             explicit IMCComm(std::unique_ptr<IMCTransport> transport) :
                     imc_transport(std::move(transport)),
-                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()),
-                    thp(1) {}
+                    recv_q(std::make_shared<SAOP::neptus::IMCMessageQueue>()) {}
 
 //            static std::unique_ptr<IMCComm> using_tcp_transport(unsigned short port) {
 //                auto trans = std::unique_ptr<IMCTransport>(new IMCTransportTCP(port));
@@ -243,6 +441,62 @@ namespace SAOP {
 
             void run();
 
+            /* Stop the transport, handle the messages already received and join the threads started by run().
+             * Must not be called from a message handler. Does nothing if run() was not called. */
+            void stop();
+
+            /* Number of threads running message handlers, 1 by default. Must be set before run().
+             *
+             * With several workers, messages of different (source, message type) pairs are handled in parallel,
+             * so that a slow handler (e.g. decoding a fire map) does not delay others. Messages of the same pair are
+             * always handled in order of reception, one at a time, subject to their dispatch policy. */
+            void set_dispatch_workers(size_t n) {
+                ASSERT(n > 0);
+                dispatch_workers = n;
+            }
+
+            /* Set how messages of a type wait for their handler when it falls behind (FIFO by default).
+             * Policies apply per source: telemetry of a vehicle never replaces the one of another. */
+            void set_dispatch_policy(uint16_t message_id, DispatchPolicy policy) {
+                std::unique_lock<std::mutex> lock(lanes_mtx);
+                policies[message_id] = policy;
+            }
+
+            template<typename M>
+            void set_dispatch_policy(DispatchPolicy policy) {
+                set_dispatch_policy(M::getIdStatic(), policy);
+            }
+
+            /* Number of messages of a type dropped by its dispatch policy */
+            size_t dropped_messages(uint16_t message_id) {
+                std::unique_lock<std::mutex> lock(lanes_mtx);
+                auto count = dropped.find(message_id);
+                return count != dropped.end() ? count->second : 0;
+            }
+
+            /* Record the messages received from now on to a file (see imc_recording.hpp) */
+            void record_to(const std::string& path) {
+                std::atomic_store(&recorder, std::make_shared<IMCRecorder>(path));
+            }
+
+            void stop_recording() {
+                auto previous = std::atomic_exchange(&recorder, std::shared_ptr<IMCRecorder>());
+                if (previous) {
+                    previous->flush();
+                }
+            }
+
+            /* Number of messages received and neither handled nor dropped yet */
+            size_t pending_messages() const {
+                return n_pending;
+            }
+
+            /* Time spent by handlers, for each message type */
+            std::unordered_map<uint16_t, HandlerStats> handler_stats() {
+                std::unique_lock<std::mutex> lock(stats_mtx);
+                return stats;
+            }
+
             bool is_ready() {
                 return ready & imc_transport->is_ready();
             }
@@ -278,12 +532,38 @@ namespace SAOP {
             }
 
         private:
+            /* Messages of one (source, message type) pair waiting to be handled */
+            struct DispatchLane {
+                std::deque<std::unique_ptr<IMC::Message>> pending;
+                /* True while a worker is in charge of the lane */
+                bool scheduled = false;
+            };
+
+            /* Number of messages of a lane handled before giving way to other lanes */
+            static constexpr size_t lane_batch_size = 16;
+
             std::thread message_thread;
             bool ready = false;
 
+            size_t dispatch_workers = 1;
+            std::mutex lanes_mtx;
+            std::unordered_map<uint32_t, DispatchLane> lanes;
+            std::unordered_map<uint16_t, DispatchPolicy> policies;
+            std::unordered_map<uint16_t, size_t> dropped;
+
+            std::shared_ptr<IMCRecorder> recorder;
+            std::atomic<size_t> n_pending{0};
+            /* Notified, with lanes_mtx held, when the last pending message has been handled */
+            std::condition_variable all_handled;
+            std::mutex stats_mtx;
+            std::unordered_map<uint16_t, HandlerStats> stats;
+
+            /* Declared last to be destroyed first, its threads using the lanes and bindings */
+            std::unique_ptr<ThreadPool> workers;
+
             /* Bind a message id to a handler function */
             void bind(size_t id, std::function<void(std::unique_ptr<IMC::Message>)> message_handler) {
-                message_bindings[id] = std::move(message_handler);
+                message_bindings[id] = std::make_shared<const MessageHandler>(std::move(message_handler));
             }
 
             void unbind(size_t id) {
@@ -292,7 +572,22 @@ namespace SAOP {
 
             void message_dispatching_loop();
 
+            /* Queue a message in the lane of its source and type according to the policy of its type,
+             * scheduling the lane if needed */
+            void dispatch(std::unique_ptr<IMC::Message> m);
+
+            /* Handle the pending messages of a lane, in order */
+            void drain_lane(uint32_t key);
+
+            /* Run the handler bound to the message type, if any */
+            void handle(std::unique_ptr<IMC::Message> m);
+
             void message_inbox(std::unique_ptr<IMC::Message> m) {
+                auto rec = std::atomic_load(&recorder);
+                if (rec) {
+                    rec->record(*m);
+                }
+                n_pending++;
                 recv_q->push(std::move(m));
             }
 
@@ -0,0 +1,154 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#ifndef PLANNING_CPP_IMC_RECORDING_HPP
+#define PLANNING_CPP_IMC_RECORDING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../IMC/Base/ByteBuffer.hpp"
+#include "../../IMC/Base/Message.hpp"
+#include "../../IMC/Base/Packet.hpp"
+
+namespace SAOP {
+    namespace neptus {
+
+        /* Binary recordings of IMC traffic, to replay offline what was received from vehicles.
+         *
+         * A recording starts with the 8 bytes "IMCREC01", followed by one record per message:
+         *  - reception time in seconds since the epoch, as a little-endian IEEE 754 double,
+         *  - size of the packet, as a little-endian uint32,
+         *  - the packet, framed as by IMC::Packet::serialize. */
+        const char imc_recording_magic[8] = {'I', 'M', 'C', 'R', 'E', 'C', '0', '1'};
+
+        struct IMCRecord {
+            double time;
+            std::vector<uint8_t> packet;
+        };
+
+        /* Append the messages given to it to a recording file. Thread safe. */
+        class IMCRecorder {
+            std::mutex mtx;
+            std::ofstream out;
+            IMC::ByteBuffer buffer = IMC::ByteBuffer(65535);
+            size_t n_records = 0;
+
+        public:
+            explicit IMCRecorder(const std::string& path) : out(path, std::ios::binary | std::ios::trunc) {
+                if (!out) {
+                    throw std::runtime_error("Cannot open IMC recording \"" + path + "\"");
+                }
+                out.write(imc_recording_magic, sizeof(imc_recording_magic));
+            }
+
+            /* Record a message received now */
+            void record(const IMC::Message& m) {
+                record(m, std::chrono::duration<double>(
+                        std::chrono::system_clock::now().time_since_epoch()).count());
+            }
+
+            /* Record a message received at 'time' (seconds since the epoch) */
+            void record(const IMC::Message& m, double time) {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto n_bytes = static_cast<uint32_t>(IMC::Packet::serialize(&m, buffer));
+
+                uint64_t time_bits;
+                std::memcpy(&time_bits, &time, sizeof(time_bits));
+                uint8_t head[12];
+                for (size_t i = 0; i < 8; ++i) {
+                    head[i] = static_cast<uint8_t>(time_bits >> (8 * i));
+                }
+                for (size_t i = 0; i < 4; ++i) {
+                    head[8 + i] = static_cast<uint8_t>(n_bytes >> (8 * i));
+                }
+                out.write(reinterpret_cast<const char*>(head), sizeof(head));
+                out.write(reinterpret_cast<const char*>(buffer.getBuffer()), n_bytes);
+                n_records++;
+            }
+
+            void flush() {
+                std::lock_guard<std::mutex> lock(mtx);
+                out.flush();
+            }
+
+            /* Number of messages recorded */
+            size_t size() {
+                std::lock_guard<std::mutex> lock(mtx);
+                return n_records;
+            }
+        };
+
+        /* Read a whole recording */
+        inline std::vector<IMCRecord> read_imc_recording(const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Cannot open IMC recording \"" + path + "\"");
+            }
+            char magic[sizeof(imc_recording_magic)];
+            if (!in.read(magic, sizeof(magic)) ||
+                std::memcmp(magic, imc_recording_magic, sizeof(imc_recording_magic)) != 0) {
+                throw std::runtime_error("\"" + path + "\" is not an IMC recording");
+            }
+
+            auto records = std::vector<IMCRecord>();
+            uint8_t head[12];
+            while (in.read(reinterpret_cast<char*>(head), sizeof(head))) {
+                uint64_t time_bits = 0;
+                for (size_t i = 0; i < 8; ++i) {
+                    time_bits |= static_cast<uint64_t>(head[i]) << (8 * i);
+                }
+                uint32_t n_bytes = 0;
+                for (size_t i = 0; i < 4; ++i) {
+                    n_bytes |= static_cast<uint32_t>(head[8 + i]) << (8 * i);
+                }
+
+                IMCRecord r;
+                std::memcpy(&r.time, &time_bits, sizeof(r.time));
+                r.packet.resize(n_bytes);
+                if (!in.read(reinterpret_cast<char*>(r.packet.data()), n_bytes)) {
+                    throw std::runtime_error("IMC recording \"" + path + "\" is truncated");
+                }
+                records.emplace_back(std::move(r));
+            }
+            if (in.gcount() != 0) {
+                throw std::runtime_error("IMC recording \"" + path + "\" is truncated");
+            }
+            return records;
+        }
+    }
+}
+
+#endif //PLANNING_CPP_IMC_RECORDING_HPP
@@ -32,77 +32,84 @@ namespace SAOP {
 
     namespace neptus {
 
-        bool GCS::stop(std::string plan_id, uint16_t uav_addr) {
-            auto pc_stop = produce_unique<IMC::PlanControl>(0, 0, uav_addr, 0xFF);
+        constexpr std::chrono::seconds GCS::request_timeout;
+
+        std::future<bool> GCS::request(std::unique_ptr<IMC::PlanControl> pc, RequestOutcome outcome,
+                                       RequestCompletion done) {
+            std::future<bool> result;
+            pc->request_id = req.add(std::move(outcome), std::move(done), request_timeout, result);
+
+            BOOST_LOG_TRIVIAL(debug) << "Send " << pc->toString();
+
+            imc_comm->send(std::move(pc));
+            return result;
+        }
+
+        std::future<bool> GCS::failed_request(const RequestCompletion& done) {
+            std::promise<bool> result;
+            result.set_value(false);
+            if (done) {
+                done(false);
+            }
+            return result.get_future();
+        }
+
+        opt<uint16_t> GCS::uav_address(const std::string& uav) const {
+            auto uav_id_it = uav_addr_of.find(uav);
+            if (uav_id_it == uav_addr_of.end()) {
+                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
+                return {};
+            }
+            return uav_id_it->second;
+        }
+
+        std::string GCS::uav_name(uint16_t addr) const {
+            auto uav_name_it = uav_name_of.find(addr);
+            return uav_name_it != uav_name_of.end() ? uav_name_it->second : std::string();
+        }
 
-            auto req_id = req.request_id();
+        std::future<bool> GCS::stop(std::string plan_id, uint16_t uav_addr, RequestCompletion done) {
+            auto pc_stop = produce_unique<IMC::PlanControl>(0, 0, uav_addr, 0xFF);
 
             pc_stop->type = IMC::PlanControl::TypeEnum::PC_REQUEST;
             pc_stop->op = IMC::PlanControl::OperationEnum::PC_STOP;
-            pc_stop->request_id = req_id;
             pc_stop->plan_id = plan_id;
 
-            BOOST_LOG_TRIVIAL(debug) << "Send " << pc_stop->toString();
-
-            this->imc_comm->send(std::move(pc_stop));
-
-            return wait_for_stop(req_id);
+            return request(std::move(pc_stop), stop_outcome, std::move(done));
         }
 
-        bool GCS::load(IMC::PlanSpecification ps, uint16_t uav_addr) {
+        std::future<bool> GCS::load(IMC::PlanSpecification ps, uint16_t uav_addr, RequestCompletion done) {
             auto pc_load = produce_unique<IMC::PlanControl>(0, 0, uav_addr, 0xFF);
 
-            auto req_id = req.request_id();
-
             pc_load->type = IMC::PlanControl::TypeEnum::PC_REQUEST;
             pc_load->op = IMC::PlanControl::OperationEnum::PC_LOAD;
-            pc_load->request_id = req_id;
             pc_load->plan_id = ps.plan_id;
             pc_load->arg = IMC::InlineMessage<IMC::Message>();
             pc_load->arg.set(ps);
 
-            BOOST_LOG_TRIVIAL(debug) << "Send " << pc_load->toString();
-
-            imc_comm->send(std::move(pc_load));
-
-            return wait_for_load(req_id);
+            return request(std::move(pc_load), load_outcome, std::move(done));
         }
 
-        bool GCS::start(std::string plan_id, uint16_t uav_addr) {
-//            auto pc_start = produce_unique<IMC::PlanControl>(0, 0, 0x0c10, 0xFF);
+        std::future<bool> GCS::start(std::string plan_id, uint16_t uav_addr, RequestCompletion done) {
             auto pc_start = produce_unique<IMC::PlanControl>(0, 0, uav_addr, 0xFF);
 
-            auto req_id = req.request_id();
-
             pc_start->type = IMC::PlanControl::TypeEnum::PC_REQUEST;
             pc_start->op = IMC::PlanControl::OperationEnum::PC_START;
-            pc_start->request_id = req_id;
             pc_start->plan_id = plan_id;
 
-            BOOST_LOG_TRIVIAL(debug) << "Send " << pc_start->toString();
-
-            imc_comm->send(std::move(pc_start));
-
-            return wait_for_start(req_id);
+            return request(std::move(pc_start), start_outcome, std::move(done));
         }
 
-        bool GCS::start(IMC::PlanSpecification ps, uint16_t uav_addr) {
+        std::future<bool> GCS::start(IMC::PlanSpecification ps, uint16_t uav_addr, RequestCompletion done) {
             auto pc_start = produce_unique<IMC::PlanControl>(0, 0, uav_addr, 0xFF);
 
-            auto req_id = req.request_id();
-
             pc_start->type = IMC::PlanControl::TypeEnum::PC_REQUEST;
             pc_start->op = IMC::PlanControl::OperationEnum::PC_START;
-            pc_start->request_id = req_id;
             pc_start->plan_id = ps.plan_id;
             pc_start->arg = IMC::InlineMessage<IMC::Message>();
             pc_start->arg.set(ps);
 
-            BOOST_LOG_TRIVIAL(debug) << "Send " << pc_start->toString();
-
-            imc_comm->send(std::move(pc_start));
-
-            return wait_for_load(req_id) && wait_for_start(req_id);
+            return request(std::move(pc_start), start_outcome, std::move(done));
         }
 
         IMC::PlanSpecification
@@ -194,7 +201,7 @@ namespace SAOP {
             // m->x, m->y, m->z is a displacement from LLH
             DUNE::Coordinates::WGS84::displace(m->x, m->y, m->z, &m_lat, &m_lon, &m_asl);
 
-            UAVStateReport report{m->getTimeStamp(), uav_name_of[m->getSource()],
+            UAVStateReport report{m->getTimeStamp(), uav_name(m->getSource()),
                                   m_lat, m_lon, m_asl,
                                   m->phi, m->theta, m->psi,
                                   m->vx, m->vy, m->vz};
@@ -237,7 +244,7 @@ namespace SAOP {
 
             // See pt.lsts.neptus.console.plugins.planning.PlanControlStatePanel for "state" and "last outcome" interpretation
 
-            TrajectoryExecutionReport report{m->getTimeStamp(), m->plan_id, uav_name_of[m->getSource()], m->man_id,
+            TrajectoryExecutionReport report{m->getTimeStamp(), m->plan_id, uav_name(m->getSource()), m->man_id,
                                              m->man_eta, state, outcome};
             plan_report_handler(report);
         }
@@ -250,14 +257,11 @@ namespace SAOP {
             auto t = static_cast<IMC::PlanControl::TypeEnum>(m->type);
             if ((t == IMC::PlanControl::TypeEnum::PC_SUCCESS) || (t == IMC::PlanControl::TypeEnum::PC_FAILURE)) {
                 // Notify Plan control success or failure
-                std::unique_lock<std::mutex> lock(pc_answer_mutex);
-                if (req.set_answer(m->request_id, IMC::PlanControl(*m))) {
-                    BOOST_LOG_TRIVIAL(info) << "PlanControl request " << m->request_id <<
-                                            " op " << static_cast<IMC::PlanControl::OperationEnum>(m->op) <<
-                                            " replied " << static_cast<IMC::PlanControl::TypeEnum>(m->type) <<
-                                            " : " << m->info << ")";
-                    pc_answer_cv.notify_all();
-                } else {
+                BOOST_LOG_TRIVIAL(info) << "PlanControl request " << m->request_id <<
+                                        " op " << static_cast<IMC::PlanControl::OperationEnum>(m->op) <<
+                                        " replied " << static_cast<IMC::PlanControl::TypeEnum>(m->type) <<
+                                        " : " << m->info << ")";
+                if (!req.answer(*m)) {
                     BOOST_LOG_TRIVIAL(warning) << "Received reply for unexpected PlanControl request: "
                                                << m->request_id
                                                << " (op " << static_cast<IMC::PlanControl::OperationEnum>(m->op) <<
@@ -272,211 +276,141 @@ namespace SAOP {
 
         void GCS::dev_data_binary_handler(std::unique_ptr<IMC::DevDataBinary> m) {
             try {
-                DRaster firemap = DRaster::decode(m->value);
-                FireMapReport fmr = FireMapReport{m->getTimeStamp(), uav_name_of[m->getSource()], firemap};
-                firemap_report_handler(fmr);
+                if (FireMapReceiver::is_fragment(m->value)) {
+                    FireMapReceiver* receiver;
+                    {
+                        std::lock_guard<std::mutex> lock(firemap_receivers_mtx);
+                        receiver = &firemap_receivers[m->getSource()];
+                    }
+                    // Fragments of a source are handled one at a time, in order
+                    if (receiver->receive(m->value).empty()) {
+                        return;
+                    }
+                    FireMapReport fmr = FireMapReport{m->getTimeStamp(), uav_name(m->getSource()),
+                                                      receiver->firemap()};
+                    firemap_report_handler(fmr);
+                } else {
+                    DRaster firemap = DRaster::decode(m->value);
+                    FireMapReport fmr = FireMapReport{m->getTimeStamp(), uav_name(m->getSource()), firemap};
+                    firemap_report_handler(fmr);
+                }
             } catch (const std::invalid_argument& e) {
                 BOOST_LOG_TRIVIAL(error) << "IMC::DevDataBinary handler: " << e.what();
             }
         }
 
-        bool GCS::load(const Plan& p, size_t trajectory, std::string plan_id, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
-                return false;
+        std::future<bool> GCS::load_async(const Plan& p, size_t trajectory, std::string plan_id, std::string uav,
+                                          RequestCompletion done) {
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
+                return failed_request(done);
             }
-
-            return load(plan_specification(p, trajectory, plan_id), uav_addr);
+            return load(plan_specification(p, trajectory, plan_id), *uav_addr, std::move(done));
         }
 
-
-        bool GCS::load(const Trajectory& t, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
-                return false;
+        std::future<bool> GCS::load_async(const Trajectory& t, std::string uav, RequestCompletion done) {
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
+                return failed_request(done);
             }
-
-            return load(plan_specification(t), uav_addr);
+            return load(plan_specification(t), *uav_addr, std::move(done));
         }
 
-        bool GCS::start(const Plan& p, size_t trajectory, std::string plan_id, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
-                return false;
+        std::future<bool> GCS::start_async(const Plan& p, size_t trajectory, std::string plan_id, std::string uav,
+                                           RequestCompletion done) {
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
+                return failed_request(done);
             }
-
-            return start(plan_specification(p, trajectory, plan_id), uav_addr);
+            return start(plan_specification(p, trajectory, plan_id), *uav_addr, std::move(done));
         }
 
-        bool GCS::start(const Trajectory& t, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
-                return false;
+        std::future<bool> GCS::start_async(const Trajectory& t, std::string uav, RequestCompletion done) {
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
+                return failed_request(done);
             }
-
-            return start(plan_specification(t), uav_addr);
+            return start(plan_specification(t), *uav_addr, std::move(done));
         }
 
-        bool GCS::start(std::string plan_id, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
-                return false;
+        std::future<bool> GCS::start_async(std::string plan_id, std::string uav, RequestCompletion done) {
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
+                return failed_request(done);
             }
-            return start(plan_id, uav_addr);
-
+            return start(plan_id, *uav_addr, std::move(done));
         }
 
-        bool GCS::stop(std::string plan_id, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
-                return false;
+        std::future<bool> GCS::loiter_async(std::string plan_id, LoiterManeuver loiter, double speed,
+                                            std::string uav, RequestCompletion done) {
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
+                return failed_request(done);
             }
-            return stop(plan_id, uav_addr);
+            return start(plan_specification(loiter, speed, plan_id), *uav_addr, std::move(done));
         }
 
-        bool GCS::wait_for_load(uint16_t req_id) {
-            // Wait for an answer from Neptus. If none is received, assume a failure
-            std::unique_lock<std::mutex> lock(pc_answer_mutex);
-            pc_answer_cv.wait_for(lock, std::chrono::seconds(30),
-                                  [this, req_id]() -> bool { return this->req.has_answer(req_id); });
-
-            while (req.has_answer(req_id)) {
-                auto answer = req.get_answer(req_id);
-
-                if (!answer) {
-                    return false;
-                }
-
-                BOOST_LOG_TRIVIAL(debug) << (*answer).plan_id << " req " << (*answer).request_id << " "
-                                         << static_cast<IMC::PlanControl::OperationEnum>((*answer).op) << " "
-                                         << static_cast<IMC::PlanControl::TypeEnum>((*answer).type) << " "
-                                         << (*answer).info;
-
-                if ((*answer).info == "plan loaded") {
-                    if ((*answer).type == IMC::PlanControl::TypeEnum::PC_SUCCESS) {
-                        return true;
-                    } else { //(*answer).type == IMC::PlanControl::TypeEnum::PC_FAILURE
-
-                        return false;
-                    }
-                }
+        std::future<bool> GCS::stop_async(std::string plan_id, std::string uav, RequestCompletion done) {
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
+                return failed_request(done);
             }
-            return false;
+            return stop(plan_id, *uav_addr, std::move(done));
         }
 
-        bool GCS::wait_for_stop(uint16_t req_id) {
-            // Wait for an answer from Neptus. If none is received, assume a failure
-            std::unique_lock<std::mutex> lock(pc_answer_mutex);
-            pc_answer_cv.wait_for(lock, std::chrono::seconds(30),
-                                  [this, req_id]() -> bool { return this->req.has_answer(req_id); });
-
-            while (req.has_answer(req_id)) {
-                auto answer = req.get_answer(req_id);
-
-                if (!answer) {
-                    return false;
-                }
-
-                BOOST_LOG_TRIVIAL(debug) << (*answer).plan_id << " req " << (*answer).request_id << " "
-                                         << static_cast<IMC::PlanControl::OperationEnum>((*answer).op) << " "
-                                         << static_cast<IMC::PlanControl::TypeEnum>((*answer).type) << " "
-                                         << (*answer).info;
-
-                if ((*answer).type == IMC::PlanControl::TypeEnum::PC_SUCCESS) {
-                    return true;
-                } else {
-                    //(*answer).type == IMC::PlanControl::TypeEnum::PC_FAILURE
-                    // Neptus considers stopping nothing as a failure. For us this is a success.
-                    if ((*answer).info == "no plan is running, request ignored") {
-                        return true;
-                    }
-                    return false;
-                }
-            }
-            return false;
+        bool GCS::load(const Plan& p, size_t trajectory, std::string plan_id, std::string uav) {
+            return load_async(p, trajectory, std::move(plan_id), std::move(uav)).get();
         }
 
-        bool GCS::wait_for_start(uint16_t req_id) {
-            // Wait for an answer from Neptus. If none is received, assume a failure
-            std::unique_lock<std::mutex> lock(pc_answer_mutex);
-            pc_answer_cv.wait_for(lock, std::chrono::seconds(30),
-                                  [this, req_id]() -> bool { return this->req.has_answer(req_id); });
+        bool GCS::load(const Trajectory& t, std::string uav) {
+            return load_async(t, std::move(uav)).get();
+        }
 
-            while (req.has_answer(req_id)) {
-                auto answer = req.get_answer(req_id);
+        bool GCS::start(const Plan& p, size_t trajectory, std::string plan_id, std::string uav) {
+            return start_async(p, trajectory, std::move(plan_id), std::move(uav)).get();
+        }
 
-                if (!answer) {
-                    return false;
-                }
+        bool GCS::start(const Trajectory& t, std::string uav) {
+            return start_async(t, std::move(uav)).get();
+        }
 
-                BOOST_LOG_TRIVIAL(debug) << (*answer).plan_id << " req " << (*answer).request_id << " "
-                                         << static_cast<IMC::PlanControl::OperationEnum>((*answer).op) << " "
-                                         << static_cast<IMC::PlanControl::TypeEnum>((*answer).type) << " "
-                                         << (*answer).info;
+        bool GCS::start(std::string plan_id, std::string uav) {
+            return start_async(std::move(plan_id), std::move(uav)).get();
+        }
 
-                if ((*answer).info.find("executing maneuver") != std::string::npos) {
-                    if ((*answer).type == IMC::PlanControl::TypeEnum::PC_SUCCESS) {
-                        return true;
-                    } else { //(*answer).type == IMC::PlanControl::TypeEnum::PC_FAILURE
-                        return false;
-                    }
-                }
+        std::vector<bool> GCS::start_all(const Plan& p, const std::vector<std::string>& uavs) {
+            ASSERT(uavs.size() <= p.trajectories().size());
+            std::vector<std::future<bool>> pending;
+            for (size_t i = 0; i < uavs.size(); ++i) {
+                pending.emplace_back(start_async(p.trajectories()[i], uavs[i]));
+            }
+            std::vector<bool> started;
+            for (auto& result : pending) {
+                started.push_back(result.get());
             }
-            return false;
+            return started;
         }
 
         bool GCS::loiter(std::string plan_id, LoiterManeuver loiter, double speed, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
-                return false;
-            }
+            return loiter_async(std::move(plan_id), loiter, speed, std::move(uav)).get();
+        }
 
-            return start(plan_specification(loiter, speed, plan_id), uav_addr);
+        bool GCS::stop(std::string plan_id, std::string uav) {
+            return stop_async(std::move(plan_id), std::move(uav)).get();
         }
 
         bool GCS::set_wind(double modulo, double direction, std::string uav) {
-            uint16_t uav_addr = 0;
-            auto uav_id_it = uav_addr_of.find(uav);
-            if (uav_id_it != uav_addr_of.end()) {
-                uav_addr = uav_id_it->second;
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "UAV \"" << uav << "\" is unknown";
+            auto uav_addr = uav_address(uav);
+            if (!uav_addr) {
                 return false;
             }
 
-            auto ws_message = produce_unique<IMC::WindSpeed>(0, 0, uav_addr, 0xFF);
+            auto ws_message = produce_unique<IMC::WindSpeed>(0, 0, *uav_addr, 0xFF);
             ws_message = WindSpeedFactory::fill_message(std::move(ws_message), remainder(-direction+M_PI_2, 2*M_PI), modulo);
 
             BOOST_LOG_TRIVIAL(debug) << "Send " << ws_message->toString();
             imc_comm->send(std::move(ws_message));
+            return true;
         }
 
         bool GCS::send_device_data_text(std::string text) {
@@ -30,6 +30,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <cstdlib>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <unordered_map>
 #include <mutex>
@@ -51,6 +52,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "../vns/plan.hpp"
 
+#include "firemap_transfer.hpp"
 #include "imc_comm.hpp"
 #include "imc_message_factories.hpp"
 #include "geography.hpp"
@@ -136,80 +138,176 @@ namespace SAOP {
 
     namespace neptus {
 
-        template<typename Payload>
-        class Requests {
+        /* Called with the outcome of a request: true on success, false on failure or timeout */
+        typedef std::function<void(bool success)> RequestCompletion;
+
+        /* Tells from a final PlanControl answer (success or failure) whether a request succeeded, or is empty if
+         * the request is still to be answered by another message. */
+        typedef std::function<opt<bool>(const IMC::PlanControl& answer)> RequestOutcome;
+
+        /* Outcomes of PlanControl requests, from the final answers of Neptus */
+
+        inline opt<bool> load_outcome(const IMC::PlanControl& answer) {
+            if (answer.type == IMC::PlanControl::TypeEnum::PC_FAILURE) {
+                return false;
+            }
+            if (answer.info == "plan loaded") {
+                return true;
+            }
+            return {};
+        }
+
+        inline opt<bool> start_outcome(const IMC::PlanControl& answer) {
+            if (answer.type == IMC::PlanControl::TypeEnum::PC_FAILURE) {
+                return false;
+            }
+            if (answer.info.find("executing maneuver") != std::string::npos) {
+                return true;
+            }
+            // e.g. "plan loaded" when starting a PlanSpecification: wait for its start
+            return {};
+        }
+
+        inline opt<bool> stop_outcome(const IMC::PlanControl& answer) {
+            if (answer.type == IMC::PlanControl::TypeEnum::PC_SUCCESS) {
+                return true;
+            }
+            // Neptus considers stopping nothing as a failure. For us this is a success.
+            return answer.info == "no plan is running, request ignored";
+        }
+
+        /* Correlation table of the PlanControl requests waiting for an answer, keyed by request id.
+         *
+         * Each request is completed exactly once, through both a future and an optional callback, when its outcome
+         * is known from an answer or when its deadline expires. Callbacks run without any lock held, on the thread
+         * handling the answer or on the table's expiry thread. */
+        class PlanControlRequests {
+            typedef std::chrono::steady_clock clock;
+
+            struct Pending {
+                RequestOutcome outcome;
+                RequestCompletion done;
+                std::promise<bool> result;
+                clock::time_point deadline;
+            };
+
+            std::mutex mtx;
+            std::condition_variable expiry_cv;
             uint16_t last_req_id = 1000;
-            std::unordered_map<uint16_t, std::queue<Payload>> answers = std::unordered_map<uint16_t, std::queue<Payload>>();
-            std::unique_ptr<std::mutex> req_id_mutex = std::unique_ptr<std::mutex>(new std::mutex());
+            std::unordered_map<uint16_t, Pending> pending;
+            bool stopping = false;
+            std::thread expiry_thread;
 
         public:
-            Requests() = default;
+            PlanControlRequests() : expiry_thread(&PlanControlRequests::expire_loop, this) {}
 
-            Requests(const Requests& r) = delete;
+            PlanControlRequests(const PlanControlRequests&) = delete;
 
-            Requests& operator=(const Requests& other) = delete;
+            PlanControlRequests& operator=(const PlanControlRequests&) = delete;
 
-            /* Obtain a request id and keep it until the answer is retrieved */
-            uint16_t request_id() {
-                std::lock_guard<std::mutex> lock_m(*req_id_mutex);
+            /* Fail the requests still waiting */
+            ~PlanControlRequests() {
+                std::vector<Pending> aborted;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    stopping = true;
+                    for (auto& p : pending) {
+                        aborted.emplace_back(std::move(p.second));
+                    }
+                    pending.clear();
+                }
+                expiry_cv.notify_all();
+                expiry_thread.join();
+                for (auto& p : aborted) {
+                    complete(p, false);
+                }
+            }
 
+            /* Track a new request, to be answered before 'timeout'.
+             * Returns its request id and sets 'result' to the future of its outcome. */
+            uint16_t add(RequestOutcome outcome, RequestCompletion done, std::chrono::milliseconds timeout,
+                         std::future<bool>& result) {
+                std::lock_guard<std::mutex> lock(mtx);
                 //FIXME: This will loop inf if there are max uint16_t requests unanswered (unlikely)
-                while (answers.find(last_req_id) != answers.end()) {
+                while (pending.find(last_req_id) != pending.end()) {
                     last_req_id += 1;
                 }
-
-                answers[last_req_id] = std::queue<Payload>();
+                Pending& p = pending[last_req_id];
+                p.outcome = std::move(outcome);
+                p.done = std::move(done);
+                p.deadline = clock::now() + timeout;
+                result = p.result.get_future();
+                expiry_cv.notify_all();
                 return last_req_id++;
             }
 
-            /* Set a request as answered.
-             * Returns false if the req_id is not tracked as unanswered */
-            bool set_answer(uint16_t req_id, Payload p) {
-                std::lock_guard<std::mutex> lock_m(*req_id_mutex);
-                // req_id must exist in the unanswered set
-                auto req_id_it = answers.find(req_id);
-                if (req_id_it == answers.end()) {
-                    return false;
-                } else {
-                    answers[req_id].push(p);
-                    return true;
-                }
-            }
-
-            /* Retrieve the answer of a request if it exists */
-            opt<Payload> get_answer(uint16_t req_id) {
-                std::lock_guard<std::mutex> lock_m(*req_id_mutex);
-                // req_id must exist in the unanswered set
-                auto req_id_it = answers.find(req_id);
-                if (req_id_it != answers.end()) {
-                    if (!answers[req_id].empty()) {
-                        auto p = answers[req_id].front();
-                        answers[req_id].pop();
-                        return p;
+            /* Complete the request a final answer refers to, if this answer decides its outcome.
+             * Returns false if the request is not tracked as unanswered. */
+            bool answer(const IMC::PlanControl& m) {
+                Pending answered;
+                bool success;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    auto p = pending.find(m.request_id);
+                    if (p == pending.end()) {
+                        return false;
                     }
+                    opt<bool> outcome = p->second.outcome(m);
+                    if (!outcome) {
+                        return true;
+                    }
+                    success = *outcome;
+                    answered = std::move(p->second);
+                    pending.erase(p);
                 }
-                return opt<Payload>();
+                complete(answered, success);
+                return true;
             }
 
-            /* Get wether the answer exists */
-            bool has_answer(uint16_t req_id) {
-                std::lock_guard<std::mutex> lock_m(*req_id_mutex);
-                // req_id must exist in the unanswered set
-                auto req_id_it = answers.find(req_id);
-                if (req_id_it != answers.end()) {
-                    if (answers[req_id].empty()) {
-                        return false;
+        private:
+            /* The callback runs first, so that the request is entirely completed once its future is ready */
+            static void complete(Pending& p, bool success) {
+                if (p.done) {
+                    try {
+                        p.done(success);
+                    } catch (const std::exception& e) {
+                        BOOST_LOG_TRIVIAL(error) << "Exception raised by a PlanControl completion: " << e.what();
+                    } catch (...) {
+                        BOOST_LOG_TRIVIAL(error) << "Unknown exception raised by a PlanControl completion";
                     }
                 }
-                return true;
+                p.result.set_value(success);
             }
 
-            void dismiss(uint16_t req_id) {
-                std::lock_guard<std::mutex> lock_m(*req_id_mutex);
-                // req_id must exist in the answers set
-                auto req_id_it = answers.find(req_id);
-                if (req_id_it != answers.end()) {
-                    answers.erase(req_id_it);
+            void expire_loop() {
+                std::unique_lock<std::mutex> lock(mtx);
+                while (!stopping) {
+                    auto next_deadline = clock::time_point::max();
+                    std::vector<std::pair<uint16_t, Pending>> expired;
+                    auto now = clock::now();
+                    for (auto it = pending.begin(); it != pending.end();) {
+                        if (it->second.deadline <= now) {
+                            expired.emplace_back(it->first, std::move(it->second));
+                            it = pending.erase(it);
+                        } else {
+                            next_deadline = std::min(next_deadline, it->second.deadline);
+                            ++it;
+                        }
+                    }
+                    if (!expired.empty()) {
+                        lock.unlock();
+                        for (auto& p : expired) {
+                            BOOST_LOG_TRIVIAL(warning) << "PlanControl request " << p.first << " timed out";
+                            complete(p.second, false);
+                        }
+                        lock.lock();
+                        continue;
+                    }
+                    if (next_deadline == clock::time_point::max()) {
+                        expiry_cv.wait(lock);
+                    } else {
+                        expiry_cv.wait_until(lock, next_deadline);
+                    }
                 }
             }
         };
@@ -441,6 +539,14 @@ namespace SAOP {
                         std::bind(&GCS::plan_control_handler, this, placeholders::_1));
                 imc_comm->bind<IMC::DevDataBinary>(
                         std::bind(&GCS::dev_data_binary_handler, this, placeholders::_1));
+
+                // Under load, skip stale vehicle states rather than lagging behind: only the last one matters.
+                imc_comm->set_dispatch_policy<IMC::EstimatedState>(DispatchPolicy::latest_wins());
+                // Plan control states carry transitions (start of a maneuver, outcome of a plan) that are each
+                // reported to plan_report_handler and would be lost if replaced by a later state: keep them all.
+                imc_comm->set_dispatch_policy<IMC::PlanControlState>(DispatchPolicy::fifo());
+                // Fire map updates must not be dropped: a lost fragment loses its whole update
+                imc_comm->set_dispatch_policy<IMC::DevDataBinary>(DispatchPolicy::fifo());
             }
 
             virtual ~GCS() {
@@ -473,12 +579,38 @@ namespace SAOP {
             /* Start the last loaded PlanSpecification */
             bool start(std::string plan_id, std::string uav);
 
+            /* Load and start every trajectory of a SAOP::Plan, the i-th one on uavs[i], named after the trajectory.
+             * Requests are sent to all the UAVs at once, so this takes as long as the slowest answer. */
+            std::vector<bool> start_all(const Plan& p, const std::vector<std::string>& uavs);
+
             /* Perform a loiter maneuver */
             bool loiter(std::string plan_id, LoiterManeuver loiter, double speed, std::string uav);
 
             /* Stop the plan currently being executed. */
             bool stop(std::string plan_id, std::string uav);
 
+            /* Non-blocking variants of the above.
+             * They return as soon as the request is sent, with the future outcome of the request. 'done', if any, is
+             * also called with this outcome once known, from an IMC handling thread. */
+
+            std::future<bool> load_async(const Plan& p, size_t trajectory, std::string plan_id, std::string uav,
+                                         RequestCompletion done = nullptr);
+
+            std::future<bool> load_async(const Trajectory& t, std::string uav, RequestCompletion done = nullptr);
+
+            std::future<bool> start_async(const Plan& p, size_t trajectory, std::string plan_id, std::string uav,
+                                          RequestCompletion done = nullptr);
+
+            std::future<bool> start_async(const Trajectory& t, std::string uav, RequestCompletion done = nullptr);
+
+            std::future<bool> start_async(std::string plan_id, std::string uav, RequestCompletion done = nullptr);
+
+            std::future<bool> loiter_async(std::string plan_id, LoiterManeuver loiter, double speed, std::string uav,
+                                           RequestCompletion done = nullptr);
+
+            std::future<bool> stop_async(std::string plan_id, std::string uav, RequestCompletion done = nullptr);
+
+            /* Send the wind for an UAV. Vehicles do not answer it, so this never blocks. */
             bool set_wind(double modulo, double direction, std::string uav);
 
             bool send_device_data_text(std::string text);
@@ -500,8 +632,8 @@ namespace SAOP {
             std::shared_ptr<IMCComm> imc_comm;
             std::thread exec_thread;
 
-            mutable std::mutex pc_answer_mutex;
-            mutable std::condition_variable pc_answer_cv;
+            /* How long to wait for the answer to a PlanControl request before assuming a failure */
+            static constexpr std::chrono::seconds request_timeout = std::chrono::seconds(30);
 
             /* Function to be called periodically during execution, carrying plan execution reports */
             std::function<void(TrajectoryExecutionReport per)>
@@ -513,32 +645,44 @@ namespace SAOP {
 
             int projected_coordinate_system_epsg = EPSG_RGF93_LAMBERT93;
 
-            std::unordered_map<uint16_t, std::string> uav_name_of = {{0x0c0c, "x8-02"},
-                                                                     {0x0c10, "x8-06"}};
+            /* Read concurrently by the message handlers, hence never modified */
+            const std::unordered_map<uint16_t, std::string> uav_name_of = {{0x0c0c, "x8-02"},
+                                                                           {0x0c10, "x8-06"}};
 
-            std::unordered_map<std::string, uint16_t> uav_addr_of = {{"x8-02", 0x0c0c},
-                                                                     {"x8-06", 0x0c10}};
+            const std::unordered_map<std::string, uint16_t> uav_addr_of = {{"x8-02", 0x0c0c},
+                                                                           {"x8-06", 0x0c10}};
 
             std::vector<std::tuple<uint16_t, std::string>> available_uavs = {std::make_tuple(0x0c0c, "x8-02"),
                                                                              std::make_tuple(0x0c10, "x8-06")};
-            Requests<IMC::PlanControl> req;
+            PlanControlRequests req;
+
+            /* Fire maps received by delta updates, for each source */
+            std::mutex firemap_receivers_mtx;
+            std::unordered_map<uint16_t, FireMapReceiver> firemap_receivers;
+
+            /* Address of a known UAV */
+            opt<uint16_t> uav_address(const std::string& uav) const;
+
+            /* Name of the UAV with the given IMC address, empty if it is unknown */
+            std::string uav_name(uint16_t addr) const;
 
             /* Send the PlanControl load request for a PlanSpecification */
-            bool load(IMC::PlanSpecification ps, uint16_t uav_addr);
+            std::future<bool> load(IMC::PlanSpecification ps, uint16_t uav_addr, RequestCompletion done);
 
             /* Load and start a PlanSpecification*/
-            bool start(IMC::PlanSpecification ps, uint16_t uav_addr);
+            std::future<bool> start(IMC::PlanSpecification ps, uint16_t uav_addr, RequestCompletion done);
 
-            bool start(std::string plan_id, uint16_t uav_addr);
+            std::future<bool> start(std::string plan_id, uint16_t uav_addr, RequestCompletion done);
 
             /* Send a stop command for plan_id to uav_addr*/
-            bool stop(std::string plan_id, uint16_t uav_addr);
-
-            bool wait_for_load(uint16_t req_id);
+            std::future<bool> stop(std::string plan_id, uint16_t uav_addr, RequestCompletion done);
 
-            bool wait_for_stop(uint16_t req_id);
+            /* Track a PlanControl request to be decided by 'outcome' and send it */
+            std::future<bool> request(std::unique_ptr<IMC::PlanControl> pc, RequestOutcome outcome,
+                                      RequestCompletion done);
 
-            bool wait_for_start(uint16_t req_id);
+            /* Outcome of a request that cannot be sent */
+            static std::future<bool> failed_request(const RequestCompletion& done);
 
             IMC::PlanSpecification
             plan_specification(const Plan& saop_plan, size_t trajectory, std::string plan_id);
@@ -44,6 +44,25 @@ namespace py = pybind11;
 
 PYBIND11_DECLARE_HOLDER_TYPE(T, std::shared_ptr<T>)
 
+/* Wrap a Python callable to be called, copied and released from threads not holding the GIL */
+static neptus::RequestCompletion request_completion(py::object callback) {
+    if (callback.is_none()) {
+        return nullptr;
+    }
+    auto fn = std::shared_ptr<py::object>(new py::object(std::move(callback)), [](py::object* f) {
+        py::gil_scoped_acquire acquire;
+        delete f;
+    });
+    return [fn](bool success) {
+        py::gil_scoped_acquire acquire;
+        try {
+            (*fn)(success);
+        } catch (const py::error_already_set& e) {
+            BOOST_LOG_TRIVIAL(error) << "Request completion callback: " << e.what();
+        }
+    };
+}
+
 PYBIND11_MODULE(neptus_interface, m) {
     m.doc() = "Python module for interfacing with neptus/dune software";
 
@@ -66,7 +85,16 @@ PYBIND11_MODULE(neptus_interface, m) {
             .def(py::init<unsigned short, std::string, std::string>(), py::arg("local_port"), py::arg("remote_ip"),
                  py::arg("remote_port"), "IMC communication with dune vehicles using UDP")
             .def(py::init<unsigned short>(), py::arg("remote_port"), "IMC communication with Neptus using TCP")
-            .def("run", &neptus::IMCComm::run, py::call_guard<py::gil_scoped_release>());
+            .def("set_dispatch_workers", &neptus::IMCComm::set_dispatch_workers, py::arg("n"),
+                 "Number of threads running message handlers, to be set before run()")
+            .def("dropped_messages", &neptus::IMCComm::dropped_messages, py::arg("message_id"),
+                 "Number of messages of an IMC type skipped by its dispatch policy")
+            .def("record_to", &neptus::IMCComm::record_to, py::arg("path"),
+                 "Record the IMC messages received from now on, for replay with the imc_replay tool")
+            .def("stop_recording", &neptus::IMCComm::stop_recording)
+            .def("run", &neptus::IMCComm::run, py::call_guard<py::gil_scoped_release>())
+            .def("stop", &neptus::IMCComm::stop, py::call_guard<py::gil_scoped_release>(),
+                 "Stop the transport and join the threads started by run(), once received messages are handled");
 
     py::class_<neptus::GCS, std::shared_ptr<neptus::GCS >>(m, "GCS")
             .def(py::init<std::shared_ptr<neptus::IMCComm >>(), py::arg("imc"))
@@ -95,6 +123,41 @@ PYBIND11_MODULE(neptus_interface, m) {
                  py::arg("trajectory"), py::arg("uav"), py::call_guard<py::gil_scoped_release>())
             .def("stop", (bool (neptus::GCS::*)(std::string, std::string)) &neptus::GCS::stop,
                  py::arg("plan_id"), py::arg("uav"), py::call_guard<py::gil_scoped_release>())
+            .def("start_all", &neptus::GCS::start_all, py::arg("saop_plan"), py::arg("uavs"),
+                 py::call_guard<py::gil_scoped_release>(),
+                 "Load and start the i-th trajectory of a plan on the i-th uav, all at once")
+            .def("start_async", [](neptus::GCS& self, const Trajectory& t, std::string uav, py::object done) {
+                     auto completion = request_completion(std::move(done));
+                     py::gil_scoped_release release;
+                     self.start_async(t, std::move(uav), std::move(completion));
+                 }, py::arg("trajectory"), py::arg("uav"), py::arg("done") = py::none(),
+                 "Load and start a trajectory without waiting. 'done(success)' is called with the outcome")
+            .def("start_async", [](neptus::GCS& self, std::string plan_id, std::string uav, py::object done) {
+                     auto completion = request_completion(std::move(done));
+                     py::gil_scoped_release release;
+                     self.start_async(std::move(plan_id), std::move(uav), std::move(completion));
+                 }, py::arg("plan_id"), py::arg("uav"), py::arg("done") = py::none(),
+                 "Start a loaded plan without waiting. 'done(success)' is called with the outcome")
+            .def("load_async", [](neptus::GCS& self, const Trajectory& t, std::string uav, py::object done) {
+                     auto completion = request_completion(std::move(done));
+                     py::gil_scoped_release release;
+                     self.load_async(t, std::move(uav), std::move(completion));
+                 }, py::arg("trajectory"), py::arg("uav"), py::arg("done") = py::none(),
+                 "Load a trajectory without waiting. 'done(success)' is called with the outcome")
+            .def("loiter_async", [](neptus::GCS& self, std::string plan_id, LoiterManeuver loiter, double speed,
+                                    std::string uav, py::object done) {
+                     auto completion = request_completion(std::move(done));
+                     py::gil_scoped_release release;
+                     self.loiter_async(std::move(plan_id), loiter, speed, std::move(uav), std::move(completion));
+                 }, py::arg("plan_id"), py::arg("loiter"), py::arg("speed"), py::arg("uav"),
+                 py::arg("done") = py::none(),
+                 "Perform a loiter maneuver without waiting. 'done(success)' is called with the outcome")
+            .def("stop_async", [](neptus::GCS& self, std::string plan_id, std::string uav, py::object done) {
+                     auto completion = request_completion(std::move(done));
+                     py::gil_scoped_release release;
+                     self.stop_async(std::move(plan_id), std::move(uav), std::move(completion));
+                 }, py::arg("plan_id"), py::arg("uav"), py::arg("done") = py::none(),
+                 "Stop the plan of an uav without waiting. 'done(success)' is called with the outcome")
             .def("set_wind", &neptus::GCS::set_wind, py::arg("speed"), py::arg("direction"), py::arg("uav"),
                  "Set the wind speed and direction (m/s, rad) for an uav")
             .def("send_device_data_text", &neptus::GCS::send_device_data_text, py::arg("text"),
@@ -102,6 +165,26 @@ PYBIND11_MODULE(neptus_interface, m) {
             .def_property_readonly("available_vehicles", &neptus::GCS::available_vehicles)
             .def("is_ready", &neptus::GCS::is_ready);
 
+    py::class_<neptus::FireMapEncoder>(m, "FireMapEncoder",
+                                       "Encode the modified areas of a fire map as DevDataBinary fragments")
+            .def(py::init<uint64_t, size_t, size_t>(), py::arg("epsg_code"), py::arg("tile_size") = 64,
+                 py::arg("max_fragment_size") = 60000)
+            .def("encode", [](neptus::FireMapEncoder& self, const DRaster& map, const std::vector<CellRect>& areas) {
+                std::vector<py::bytes> fragments;
+                for (const auto& f : self.encode(map, areas)) {
+                    fragments.emplace_back(f.data(), f.size());
+                }
+                return fragments;
+            }, py::arg("firemap"), py::arg("areas"))
+            .def("encode_all", [](neptus::FireMapEncoder& self, const DRaster& map) {
+                std::vector<py::bytes> fragments;
+                for (const auto& f : self.encode_all(map)) {
+                    fragments.emplace_back(f.data(), f.size());
+                }
+                return fragments;
+            }, py::arg("firemap"))
+            .def_property_readonly("last_sequence", &neptus::FireMapEncoder::last_sequence);
+
     py::enum_<neptus::TrajectoryExecutionState>(m, "TrajectoryExecutionState", py::arithmetic())
             .value("Blocked", neptus::TrajectoryExecutionState::Blocked)
             .value("Ready", neptus::TrajectoryExecutionState::Ready)
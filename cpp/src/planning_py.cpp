@@ -65,6 +65,9 @@ namespace SAOP {
         BOOST_LOG_TRIVIAL(debug) << "Pre-process fire data";
         double preprocessing_start = time();
         shared_ptr<FireData> fire_data = make_shared<FireData>(ignitions, elevation);
+        if (conf.find("fire_front_index_bin") != conf.end()) {
+            fire_data->index_fire_front(conf["fire_front_index_bin"]);
+        }
         double preprocessing_end = time();
 
         BOOST_LOG_TRIVIAL(debug) << "Build initial plan \"" << name << "\"";
@@ -389,12 +392,97 @@ PYBIND11_MODULE(uav_planning, m) {
             .def_readonly("time", &TrajectoryManeuver::time)
             .def_readonly("name", &TrajectoryManeuver::name);
 
+    py::class_<CellObservations>(m, "CellObservations")
+            .def_readonly("cells", &CellObservations::cells, "Indices of the observed cells (x + y * x_width)")
+            .def_readonly("times", &CellObservations::times, "Time of the first observation of each cell")
+            .def("__len__", &CellObservations::size);
+
+    py::class_<CellRect>(m, "CellRect")
+            .def(py::init<size_t, size_t, size_t, size_t>(),
+                 py::arg("x_min"), py::arg("y_min"), py::arg("x_max"), py::arg("y_max"))
+            .def_readonly("x_min", &CellRect::x_min)
+            .def_readonly("y_min", &CellRect::y_min)
+            .def_readonly("x_max", &CellRect::x_max)
+            .def_readonly("y_max", &CellRect::y_max)
+            .def("__repr__", [](const CellRect& r) {
+                std::stringstream repr;
+                repr << "CellRect" << r;
+                return repr.str();
+            });
+
+    py::class_<DSummedAreaTable>(m, "SummedAreaTable")
+            .def(py::init([](const DRaster& raster, size_t num_threads) {
+                     return DSummedAreaTable::of(raster, num_threads);
+                 }), py::arg("raster"), py::arg("num_threads") = 1, py::call_guard<py::gil_scoped_release>())
+            .def("sum", &DSummedAreaTable::sum, py::arg("area"))
+            .def("footprint_sum", &DSummedAreaTable::footprint_sum,
+                 py::arg("segment"), py::arg("view_width"), py::arg("view_depth"))
+            .def("bounding_sum", &DSummedAreaTable::bounding_sum,
+                 py::arg("segment"), py::arg("view_width"), py::arg("view_depth"));
+
+    py::class_<IgnitionCounts, std::shared_ptr<IgnitionCounts>>(m, "IgnitionCounts")
+            .def_property_readonly("bin_size", &IgnitionCounts::bin_size)
+            .def_property_readonly("num_bins", &IgnitionCounts::num_bins)
+            .def("count_ignited_between", [](const IgnitionCounts& self, const CellRect& area, double t0, double t1) {
+                const IgnitionCounts::Bounds b = self.count_ignited_between(area, t0, t1);
+                return py::make_tuple(b.lower, b.upper);
+            }, py::arg("area"), py::arg("t0"), py::arg("t1"),
+                 "Lower and upper bounds of the number of cells of the area ignited in [t0, t1)")
+            .def("count_ignited_between", [](const IgnitionCounts& self, const Segment3d& segment, double view_width,
+                                             double view_depth, double t0, double t1) {
+                const IgnitionCounts::Bounds b = self.count_ignited_between(segment, view_width, view_depth, t0, t1);
+                return py::make_tuple(b.lower, b.upper);
+            }, py::arg("segment"), py::arg("view_width"), py::arg("view_depth"), py::arg("t0"), py::arg("t1"),
+                 "Lower and upper bounds of the number of cells under the footprint ignited in [t0, t1)");
+
     py::class_<FireData, std::shared_ptr<FireData>>(m, "FireData")
             .def(py::init<const DRaster&, const DRaster&>(), py::arg("ignitions"), py::arg("elevation"))
             .def_readonly("ignitions", &FireData::ignitions)
             .def_readonly("traversal_end", &FireData::traversal_end)
             .def_readonly("propagation_directions", &FireData::propagation_directions)
-            .def_readonly("elevation", &FireData::elevation);
+            .def_readonly("elevation", &FireData::elevation)
+            .def("updated", (shared_ptr<FireData> (FireData::*)(const DRaster&, const std::vector<CellRect>&) const)
+                         &FireData::updated,
+                 py::arg("ignitions"), py::arg("changed_areas"), py::call_guard<py::gil_scoped_release>())
+            .def("updated", (shared_ptr<FireData> (FireData::*)(const DRaster&) const) &FireData::updated,
+                 py::arg("ignitions"), py::call_guard<py::gil_scoped_release>())
+            .def("index_fire_front", &FireData::index_fire_front,
+                 py::arg("bin_duration"), py::arg("bucket_cells") = 8,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("index_ignition_counts", &FireData::index_ignition_counts,
+                 py::arg("bin_duration"), py::arg("num_threads") = 0,
+                 py::call_guard<py::gil_scoped_release>())
+            .def_property_readonly("ignition_counts", [](const FireData& self) {
+                return std::const_pointer_cast<IgnitionCounts>(self.ignition_counts());
+            })
+            .def("project_closest_to_fire_front",
+                 (Cell (FireData::*)(const Cell&, double) const) &FireData::project_closest_to_fire_front,
+                 py::arg("cell"), py::arg("time"))
+            .def("project_on_firefront",
+                 [](const FireData& self, const std::vector<Segment3d>& segments, const std::vector<double>& times,
+                    const UAV& uav, size_t num_threads) {
+                     std::vector<opt<Segment3d>> projections;
+                     {
+                         py::gil_scoped_release release;
+                         if (num_threads == 0) {
+                             num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+                         }
+                         if (num_threads > 1) {
+                             ThreadPool pool(num_threads);
+                             projections = self.project_on_firefront(segments, times, uav, &pool);
+                         } else {
+                             projections = self.project_on_firefront(segments, times, uav);
+                         }
+                     }
+                     // segments without projection are None
+                     py::list res;
+                     for (const auto& proj : projections) {
+                         res.append(proj ? py::cast(*proj) : py::object(py::none()));
+                     }
+                     return res;
+                 }, py::arg("segments"), py::arg("times"), py::arg("uav"), py::arg("num_threads") = 0,
+                 "Projects each segment on the fire front at the corresponding time. "
+                 "Returns a list with the projected segments or None if a segment has no projection.");
 
     py::class_<Waypoint3d>(m, "Waypoint")
             .def(py::init<const double, const double, const double, const double>(),
@@ -614,6 +702,8 @@ PYBIND11_MODULE(uav_planning, m) {
             .def("observations", (vector<PositionTime> (Plan::*)() const) &Plan::observations)
             .def("observations", (vector<PositionTime> (Plan::*)(const TimeWindow&) const) &Plan::observations,
                  py::arg("tw"))
+            .def("observed_cells", &Plan::observed_cells, py::arg("time_window"),
+                 py::call_guard<py::gil_scoped_release>())
             .def("view_trace", (vector<PositionTime> (Plan::*)() const) &Plan::view_trace)
             .def("view_trace", (vector<PositionTime> (Plan::*)(const TimeWindow&) const) &Plan::view_trace,
                  py::arg("tw"));
@@ -0,0 +1,199 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_FIRE_DATA_H
+#define PROJECT_TEST_FIRE_DATA_H
+
+#include "../../core/fire_data.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+
+        /** Fire spreading from (cx, cy), slower in the y direction. */
+        DRaster elliptic_fire(double cx, double cy, size_t size = 150) {
+            DRaster ignitions(size, size, 0, 0, 25);
+            for (size_t x = 0; x < size; x++) {
+                for (size_t y = 0; y < size; y++) {
+                    ignitions.set(x, y, sqrt((x - cx) * (x - cx) + 4 * (y - cy) * (y - cy)) * 60);
+                }
+            }
+            return ignitions;
+        }
+
+        void check_same_fire_data(const FireData& fd, const FireData& expected) {
+            BOOST_CHECK(fd.ignitions.data == expected.ignitions.data);
+            BOOST_CHECK(fd.traversal_end.data == expected.traversal_end.data);
+            BOOST_CHECK(fd.propagation_directions.data == expected.propagation_directions.data);
+            BOOST_CHECK(fd.min_front_duration() == expected.min_front_duration());
+            BOOST_CHECK(fd.max_front_duration() == expected.max_front_duration());
+
+            // fire front indexes must give the same projections
+            BOOST_REQUIRE((bool) fd.fire_front_index() == (bool) expected.fire_front_index());
+            for (size_t x = 0; x < fd.ignitions.x_width; x += 7) {
+                for (size_t y = 0; y < fd.ignitions.y_height; y += 7) {
+                    for (double t = 0; t < 8000; t += 900) {
+                        BOOST_CHECK(fd.project_closest_to_fire_front(Cell{x, y}, t) ==
+                                    expected.project_closest_to_fire_front(Cell{x, y}, t));
+                    }
+                }
+            }
+        }
+
+        void test_fire_front_index_closest() {
+            // two fires, the second one igniting much later and burning for longer than a time bin
+            const DRaster first_fire = elliptic_fire(40, 40, 80);
+            const DRaster second_fire = elliptic_fire(70, 10, 80);
+            DRaster ignitions = first_fire;
+            DRaster traversal_end = first_fire;
+            for (size_t x = 0; x < 80; x++) {
+                for (size_t y = 0; y < 80; y++) {
+                    ignitions.set(x, y, std::min(first_fire(x, y), second_fire(x, y) + 2000));
+                    traversal_end.set(x, y, ignitions(x, y) + 200 + (x % 5) * 300);
+                }
+            }
+            ignitions.set(3, 3, numeric_limits<double>::max());
+            traversal_end.set(3, 3, numeric_limits<double>::max());
+
+            const FireFrontIndex index(ignitions, traversal_end, 250, 4);
+            for (size_t x = 0; x < 80; x += 3) {
+                for (size_t y = 0; y < 80; y += 5) {
+                    for (double t = -100; t < 7000; t += 333) {
+                        // brute force, with the same tie-breaking
+                        opt<Cell> expected = {};
+                        double best = numeric_limits<double>::infinity();
+                        for (size_t cy = 0; cy < 80; cy++) {
+                            for (size_t cx = 0; cx < 80; cx++) {
+                                if (ignitions(cx, cy) <= t && t <= traversal_end(cx, cy)) {
+                                    const double d = pow((double) cx - x, 2) + pow((double) cy - y, 2);
+                                    if (d < best) {
+                                        best = d;
+                                        expected = Cell{cx, cy};
+                                    }
+                                }
+                            }
+                        }
+                        const opt<Cell> found = index.closest_on_fire_front(Cell{x, y}, t);
+                        BOOST_REQUIRE((bool) found == (bool) expected);
+                        if (found) {
+                            BOOST_CHECK(*found == *expected);
+                        }
+                    }
+                }
+            }
+        }
+
+        void test_fire_data_updated_areas() {
+            const DRaster initial = elliptic_fire(40, 40);
+            FireData fd(initial, initial);
+            fd.index_fire_front(600);
+
+            // a second ignition point, near the border of the raster
+            DRaster new_ignitions = initial;
+            const DRaster second_fire = elliptic_fire(130, 140);
+            std::vector<CellRect> areas{CellRect{100, 120, 150, 150}, CellRect{0, 0, 3, 3}};
+            for (size_t x = 100; x < 150; x++) {
+                for (size_t y = 120; y < 150; y++) {
+                    new_ignitions.set(x, y, std::min(initial(x, y), second_fire(x, y) + 1200));
+                }
+            }
+            // isolated change in a corner
+            new_ignitions.set(0, 0, 100);
+
+            const shared_ptr<FireData> updated = fd.updated(new_ignitions, areas);
+            FireData expected(new_ignitions, new_ignitions);
+            expected.index_fire_front(600);
+            check_same_fire_data(*updated, expected);
+
+            // the original is left untouched
+            FireData original(initial, initial);
+            original.index_fire_front(600);
+            check_same_fire_data(fd, original);
+        }
+
+        void test_fire_data_updated_ignition_counts() {
+            const DRaster initial = elliptic_fire(40, 40);
+            FireData fd(initial, initial);
+            fd.index_ignition_counts(300, 2);
+
+            // earlier ignitions in a block, without moving the first and last ignitions
+            DRaster new_ignitions = initial;
+            for (size_t x = 60; x < 90; x++) {
+                for (size_t y = 10; y < 30; y++) {
+                    new_ignitions.set(x, y, initial(x, y) - 400);
+                }
+            }
+            const shared_ptr<FireData> updated = fd.updated(new_ignitions, {CellRect{60, 10, 90, 30}});
+            FireData expected(new_ignitions, new_ignitions);
+            expected.index_ignition_counts(300, 1);
+
+            const IgnitionCounts& counts = *updated->ignition_counts();
+            const IgnitionCounts& expected_counts = *expected.ignition_counts();
+            BOOST_CHECK_EQUAL(counts.num_bins(), expected_counts.num_bins());
+            for (const CellRect& area : {CellRect{0, 0, 150, 150}, CellRect{50, 0, 100, 40}, CellRect{70, 20, 71, 21}}) {
+                for (double t0 = -100; t0 < 12000; t0 += 450) {
+                    for (double t1 : {t0 + 300, t0 + 1000, t0 + 5000}) {
+                        const IgnitionCounts::Bounds b = counts.count_ignited_between(area, t0, t1);
+                        const IgnitionCounts::Bounds e = expected_counts.count_ignited_between(area, t0, t1);
+                        BOOST_CHECK_EQUAL(b.lower, e.lower);
+                        BOOST_CHECK_EQUAL(b.upper, e.upper);
+                    }
+                }
+            }
+        }
+
+        void test_fire_data_updated_raster() {
+            const DRaster initial = elliptic_fire(40, 40);
+            FireData fd(initial, initial);
+            fd.index_fire_front(600);
+
+            DRaster new_ignitions = initial;
+            for (size_t x = 60; x < 90; x++) {
+                for (size_t y = 10; y < 30; y++) {
+                    new_ignitions.set(x, y, initial(x, y) - 300);
+                }
+            }
+            new_ignitions.set(149, 149, numeric_limits<double>::max());
+
+            FireData expected(new_ignitions, new_ignitions);
+            expected.index_fire_front(600);
+            check_same_fire_data(*fd.updated(new_ignitions), expected);
+
+            // nothing changed
+            check_same_fire_data(*fd.updated(initial), fd);
+        }
+
+        test_suite* fire_data_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("fire_data_tests");
+            ts->add(BOOST_TEST_CASE(&test_fire_front_index_closest));
+            ts->add(BOOST_TEST_CASE(&test_fire_data_updated_areas));
+            ts->add(BOOST_TEST_CASE(&test_fire_data_updated_raster));
+            ts->add(BOOST_TEST_CASE(&test_fire_data_updated_ignition_counts));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_FIRE_DATA_H
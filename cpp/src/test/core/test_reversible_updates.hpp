@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "../../core/trajectories.hpp"
 #include "../../core/updates/updates.hpp"
+#include "../../vns/evaluation_cache.hpp"
 #include <boost/test/included/unit_test.hpp>
 
 namespace SAOP {
@@ -39,8 +40,16 @@ namespace SAOP {
             return Segment3d(Waypoint3d(xy, xy, 0, 0));
         }
 
+        vector<TrajectoryManeuver> maneuvers_of(const Trajectory& traj) {
+            vector<TrajectoryManeuver> maneuvers;
+            for (size_t i = 0; i < traj.size(); i++) {
+                maneuvers.push_back(traj[i]);
+            }
+            return maneuvers;
+        }
+
         Trajectories default_plan() {
-            UAV uav(10., 32. * M_PI / 180, 0.1);
+            UAV uav("test-uav", 10., 32. * M_PI / 180, 0.1);
             Waypoint3d start(5, 5, 0, 0);
             Waypoint3d end(11, 11, 0, 0);
 
@@ -61,12 +70,15 @@ namespace SAOP {
             BOOST_CHECK(ts.num_segments() == 5);
 
             double dur = ts.duration();
+            const uint64_t hash = ts.hash();
             auto rev = DeleteSegmentUpdate(0, 1).apply(ts);
             BOOST_CHECK(ts.num_segments() == 4);
             BOOST_CHECK(ts.duration() < dur);
             BOOST_CHECK(ts[0][1].maneuver.start.x == 2);
+            BOOST_CHECK(ts.hash() != hash);
             rev->apply(ts);
             BOOST_CHECK(ALMOST_EQUAL(ts.duration(), dur));
+            BOOST_CHECK(ts.hash() == hash);
 
             Segment3d old_seg = ts[0][3].maneuver;
             Segment3d new_seg = seg(4);
@@ -74,16 +86,57 @@ namespace SAOP {
             auto updt_rev = ReplaceSegmentUpdate(0, 3, new_seg).apply(ts);
             BOOST_CHECK(ts.num_segments() == orig_size);
             BOOST_CHECK(ts[0][3].maneuver.start.x == new_seg.start.x);
+            BOOST_CHECK(ts.hash() != hash);
             updt_rev->apply(ts);
             BOOST_CHECK(ts[0][3].maneuver.start.x == old_seg.start.x);
             BOOST_CHECK(ALMOST_EQUAL(ts.duration(), dur));
+            BOOST_CHECK(ts.hash() == hash);
+
+            // the hash only depends on the sequence of maneuvers, not on how it was built
+            BOOST_CHECK(Trajectories(vector<Trajectory>{Trajectory(ts[0].conf(), maneuvers_of(ts[0]))}).hash() == hash);
 
             return ts;
         }
 
+        Trajectory trajectory_through(const TrajectoryConfig& conf, const vector<double>& xys) {
+            vector<TrajectoryManeuver> maneuvers;
+            for (double xy : xys) {
+                maneuvers.emplace_back(seg(xy), 0., "");
+            }
+            return Trajectory(conf, maneuvers);
+        }
+
+        void test_trajectory_hash() {
+            UAV uav("test-uav", 10., 32. * M_PI / 180, 0.1);
+            TrajectoryConfig conf(uav, 10);
+
+            // with a XOR of transition keys, the repeated transitions 1->2 and 2->1 would cancel out
+            BOOST_CHECK(trajectory_through(conf, {1, 2, 1}).hash() != trajectory_through(conf, {1, 2, 1, 2, 1}).hash());
+            BOOST_CHECK(trajectory_through(conf, {1, 2}).hash() != trajectory_through(conf, {2, 1}).hash());
+
+            // same maneuvers, but different start times
+            TrajectoryConfig later(uav, 20);
+            BOOST_CHECK(trajectory_through(conf, {1, 2, 3}).hash() != trajectory_through(later, {1, 2, 3}).hash());
+        }
+
+        void test_evaluation_cache_collisions() {
+            EvaluationCache cache(16);
+            cache.store(42, PlanEvaluation{1., 100., 3, true});
+            BOOST_REQUIRE(cache.find(42, 100., 3));
+            BOOST_CHECK(cache.find(42, 100., 3)->utility == 1.);
+
+            // same hash, but a different plan
+            BOOST_CHECK(!cache.find(42, 101., 3));
+            BOOST_CHECK(!cache.find(42, 100., 4));
+            BOOST_CHECK(!cache.peek(42 + 16, 100., 3));
+            BOOST_CHECK(cache.hits() == 2 && cache.misses() == 2);
+        }
+
         test_suite* reversible_updates_test_suite() {
             test_suite* ts3 = BOOST_TEST_SUITE("reversible_updates_tests");
             ts3->add(BOOST_TEST_CASE(&default_plan));
+            ts3->add(BOOST_TEST_CASE(&test_trajectory_hash));
+            ts3->add(BOOST_TEST_CASE(&test_evaluation_cache_collisions));
 
             return ts3;
         }
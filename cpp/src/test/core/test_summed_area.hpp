@@ -0,0 +1,212 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_SUMMED_AREA_H
+#define PROJECT_TEST_SUMMED_AREA_H
+
+#include "../../core/raster.hpp"
+#include "../../core/summed_area.hpp"
+#include "../../utils.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+
+        /** Sum of the values of the cells whose center is in the rotated rectangle, as defined by
+         * RasterMapper::for_each_rectangle_row(), by testing every cell of the raster. NaN values count as zero. */
+        double brute_force_rectangle_sum(const DRaster& raster, double x, double y, double dir,
+                                         double along_min, double along_max, double half_width) {
+            double sum = 0;
+            for (size_t cy = 0; cy < raster.y_height; cy++) {
+                for (size_t cx = 0; cx < raster.x_width; cx++) {
+                    const double rx = raster.x_coords(cx) - x;
+                    const double ry = raster.y_coords(cy) - y;
+                    const double along = rx * cos(dir) + ry * sin(dir);
+                    const double across = -rx * sin(dir) + ry * cos(dir);
+                    if (along_min <= along && along <= along_max && std::abs(across) <= half_width &&
+                        raster(cx, cy) == raster(cx, cy)) {
+                        sum += raster(cx, cy);
+                    }
+                }
+            }
+            return sum;
+        }
+
+        /** Sum of the values of the cells traced by RasterMapper::segment_trace() */
+        double trace_sum(const DRaster& raster, const Segment3d& segment, double view_width, double view_depth) {
+            const opt<std::vector<Cell>> trace = RasterMapper::segment_trace(segment, view_width, view_depth, raster);
+            double sum = 0;
+            for (const Cell& c : *trace) {
+                sum += raster(c);
+            }
+            return sum;
+        }
+
+        void test_summed_area_sums() {
+            srand(0);
+            DRaster raster(60, 50, 10, 20, 25);
+            for (auto& v : raster.data) {
+                v = drand(0, 10);
+            }
+            raster.set(5, 7, std::numeric_limits<double>::quiet_NaN());
+
+            const DSummedAreaTable table = DSummedAreaTable::of(raster);
+            BOOST_CHECK(DSummedAreaTable::of(raster, 3).sum(CellRect{0, 0, 60, 50}) ==
+                        table.sum(CellRect{0, 0, 60, 50}));
+
+            for (size_t i = 0; i < 200; i++) {
+                // areas may extend beyond the raster, or be empty
+                const size_t x_min = rand(0, 70);
+                const size_t y_min = rand(0, 60);
+                const CellRect area{x_min, y_min, x_min + rand(0, 30), y_min + rand(0, 30)};
+                double expected = 0;
+                for (size_t y = area.y_min; y < std::min(area.y_max, raster.y_height); y++) {
+                    for (size_t x = area.x_min; x < std::min(area.x_max, raster.x_width); x++) {
+                        expected += raster(x, y) == raster(x, y) ? raster(x, y) : 0;
+                    }
+                }
+                BOOST_CHECK_SMALL(table.sum(area) - expected, 1e-6);
+            }
+
+            for (size_t i = 0; i < 200; i++) {
+                const double x = drand(-100, 1700);
+                const double y = drand(-100, 1400);
+                const double dir = drand(0, 2 * M_PI);
+                const double along_min = drand(-100, 0);
+                const double along_max = drand(0, 300);
+                const double half_width = drand(10, 100);
+                BOOST_CHECK_SMALL(table.rectangle_sum(x, y, dir, along_min, along_max, half_width) -
+                                  brute_force_rectangle_sum(raster, x, y, dir, along_min, along_max, half_width),
+                                  1e-6);
+            }
+        }
+
+        void test_summed_area_footprints() {
+            srand(1);
+            DRaster raster(60, 50, 10, 20, 25);
+            for (auto& v : raster.data) {
+                v = drand(0, 10);
+            }
+            const DSummedAreaTable table = DSummedAreaTable::of(raster);
+
+            for (size_t i = 0; i < 200; i++) {
+                // away from the borders of the raster, that segment_trace handles differently
+                const Segment3d segment(Waypoint3d(drand(200, 1300), drand(200, 1100), 100, drand(0, 2 * M_PI)),
+                                        drand(0, 300));
+                const double view_width = drand(60, 150);
+                const double view_depth = drand(60, 150);
+                const double footprint = table.footprint_sum(segment, view_width, view_depth);
+                BOOST_CHECK_SMALL(footprint - brute_force_rectangle_sum(
+                        raster, segment.start.x, segment.start.y, segment.start.dir, -view_depth / 2,
+                        segment.length + view_depth / 2, view_width / 2), 1e-6);
+
+                // segment_trace also takes cells partially covered by the footprint: cells whose center is
+                // in the footprint are all traced when it is extended by a cell on each side, and all cells traced
+                // when it is reduced by a cell on each side have their center in the footprint
+                const double cell = raster.cell_width;
+                BOOST_CHECK_LE(trace_sum(raster, segment, view_width - 2 * cell, view_depth - 2 * cell),
+                               footprint + 1e-6);
+                BOOST_CHECK_LE(footprint,
+                               trace_sum(raster, segment, view_width + 2 * cell, view_depth + 2 * cell) + 1e-6);
+
+                // values are non-negative
+                BOOST_CHECK_LE(footprint, table.bounding_sum(segment, view_width, view_depth) + 1e-6);
+            }
+        }
+
+        void test_ignition_counts_bounds() {
+            srand(2);
+            const double bin = 300;
+            DRaster ignitions(40, 30, 0, 0, 25);
+            for (auto& v : ignitions.data) {
+                v = drand(0, 6000);
+            }
+            // first ignition at time 0, so that bin boundaries are multiples of 'bin'
+            ignitions.set(0, 0, 0);
+            ignitions.set(3, 4, std::numeric_limits<double>::max());
+            const IgnitionCounts counts(ignitions, bin, 2);
+
+            auto count_between = [&ignitions](const CellRect& area, double t0, double t1) {
+                size_t count = 0;
+                for (size_t y = area.y_min; y < std::min(area.y_max, ignitions.y_height); y++) {
+                    for (size_t x = area.x_min; x < std::min(area.x_max, ignitions.x_width); x++) {
+                        count += t0 <= ignitions(x, y) && ignitions(x, y) < t1 ? 1 : 0;
+                    }
+                }
+                return count;
+            };
+
+            for (size_t i = 0; i < 300; i++) {
+                const size_t x_min = rand(0, 40);
+                const size_t y_min = rand(0, 30);
+                const CellRect area{x_min, y_min, x_min + rand(1, 20), y_min + rand(1, 20)};
+                const double t0 = drand(-500, 6500);
+                const double t1 = t0 + drand(0, 3000);
+                const size_t expected = count_between(area, t0, t1);
+                const IgnitionCounts::Bounds b = counts.count_ignited_between(area, t0, t1);
+                BOOST_CHECK_LE(b.lower, expected);
+                BOOST_CHECK_GE(b.upper, expected);
+
+                // exact on bin boundaries
+                const double k0 = std::floor(t0 / bin) * bin;
+                const double k1 = std::ceil(t1 / bin) * bin;
+                const IgnitionCounts::Bounds exact = counts.count_ignited_between(area, k0, k1);
+                BOOST_CHECK_EQUAL(exact.lower, count_between(area, k0, k1));
+                BOOST_CHECK_EQUAL(exact.upper, count_between(area, k0, k1));
+            }
+
+            // under the footprint of segments
+            DRaster ones(ignitions, 1.);
+            for (size_t i = 0; i < 100; i++) {
+                const Segment3d segment(Waypoint3d(drand(0, 1000), drand(0, 750), 100, drand(0, 2 * M_PI)),
+                                        drand(0, 300));
+                const double t0 = drand(0, 6000);
+                const double t1 = t0 + drand(0, 2000);
+                // cells of the footprint ignited in [t0, t1)
+                DRaster ignited_between(ignitions, 0.);
+                for (size_t c = 0; c < ignitions.data.size(); c++) {
+                    ignited_between.data[c] = t0 <= ignitions.data[c] && ignitions.data[c] < t1 ? 1 : 0;
+                }
+                const double expected = brute_force_rectangle_sum(ignited_between, segment.start.x, segment.start.y,
+                                                                  segment.start.dir, -50. / 2,
+                                                                  segment.length + 50. / 2, 50. / 2);
+                const IgnitionCounts::Bounds b = counts.count_ignited_between(segment, 50, 50, t0, t1);
+                BOOST_CHECK_LE(b.lower, expected);
+                BOOST_CHECK_GE(b.upper, expected);
+                BOOST_CHECK_LE(b.upper, DSummedAreaTable::of(ones).footprint_sum(segment, 50, 50));
+            }
+        }
+
+        test_suite* summed_area_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("summed_area_tests");
+            ts->add(BOOST_TEST_CASE(&test_summed_area_sums));
+            ts->add(BOOST_TEST_CASE(&test_summed_area_footprints));
+            ts->add(BOOST_TEST_CASE(&test_ignition_counts_bounds));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_SUMMED_AREA_H
@@ -0,0 +1,164 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_RECONSTRUCTION_H
+#define PROJECT_TEST_RECONSTRUCTION_H
+
+#include "../../firemapping/reconstruction.hpp"
+#include "../../utils.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+
+        /** Ignition times of a fire spreading at one cell per minute from the center of the raster. */
+        DRaster cone_fire(size_t size = 100) {
+            DRaster ignitions(size, size, 0, 0, 25);
+            for (size_t x = 0; x < size; x++) {
+                for (size_t y = 0; y < size; y++) {
+                    ignitions.set(x, y, sqrt(pow(x - size / 2., 2) + pow(y - size / 2., 2)) * 60);
+                }
+            }
+            return ignitions;
+        }
+
+        void test_kdtree_nearest() {
+            srand(0);
+            std::vector<PositionTime> points;
+            for (size_t i = 0; i < 500; i++) {
+                points.emplace_back(Position{drand(0, 1000), drand(0, 1000)}, (double) i);
+            }
+            const KDTree2D tree(points);
+            BOOST_CHECK_EQUAL(tree.size(), points.size());
+
+            for (size_t q = 0; q < 100; q++) {
+                const double x = drand(-100, 1100);
+                const double y = drand(-100, 1100);
+                for (size_t k : {1, 5, 16}) {
+                    for (double radius : {30., 150., 2000.}) {
+                        // brute force: all squared distances within the radius, the k smallest first
+                        std::vector<double> expected;
+                        for (const auto& p : points) {
+                            const double d_sq = pow(p.pt.x - x, 2) + pow(p.pt.y - y, 2);
+                            if (d_sq <= radius * radius) {
+                                expected.push_back(d_sq);
+                            }
+                        }
+                        std::sort(expected.begin(), expected.end());
+                        expected.resize(std::min(expected.size(), k));
+
+                        const auto found = tree.nearest(x, y, k, radius);
+                        BOOST_REQUIRE_EQUAL(found.size(), expected.size());
+                        for (size_t i = 0; i < found.size(); i++) {
+                            BOOST_CHECK_EQUAL(found[i].first, expected[i]);
+                            BOOST_CHECK_EQUAL(found[i].first, pow(found[i].second->pt.x - x, 2) +
+                                                              pow(found[i].second->pt.y - y, 2));
+                        }
+                    }
+                }
+            }
+        }
+
+        void test_reconstruction_cone_fire() {
+            const DRaster truth = cone_fire();
+            // one observed cell out of 16
+            DRaster observed(truth, std::numeric_limits<double>::infinity());
+            for (size_t x = 0; x < truth.x_width; x += 4) {
+                for (size_t y = 0; y < truth.y_height; y += 4) {
+                    observed.set(x, y, truth(x, y));
+                }
+            }
+
+            const DRaster reconstructed = FireMapReconstruction(150, 16, 2).reconstruct(observed);
+            double error = 0;
+            double max_inner_error = 0;
+            for (size_t x = 0; x < truth.x_width; x++) {
+                for (size_t y = 0; y < truth.y_height; y++) {
+                    BOOST_REQUIRE(std::isfinite(reconstructed(x, y)));
+                    const double cell_error = std::abs(reconstructed(x, y) - truth(x, y));
+                    error += cell_error;
+                    if (x <= 96 && y <= 96 && truth(x, y) > 6 * 60) {
+                        // surrounded by observations and away from the apex of the cone, that is smoothed out
+                        max_inner_error = std::max(max_inner_error, cell_error);
+                    }
+                    if (std::isfinite(observed(x, y))) {
+                        // observed cells keep their value
+                        BOOST_CHECK_EQUAL(reconstructed(x, y), observed(x, y));
+                    }
+                }
+            }
+            // errors in cells, i.e. in time for the fire to spread over a cell
+            BOOST_CHECK_LT(error / truth.data.size(), 0.5 * 60);
+            BOOST_CHECK_LT(max_inner_error, 1.5 * 60);
+
+            // the same on a single thread
+            const DRaster single_thread = FireMapReconstruction(150, 16, 1).reconstruct(observed);
+            BOOST_CHECK(single_thread.data == reconstructed.data);
+        }
+
+        void test_reconstruction_no_data() {
+            const DRaster truth = cone_fire();
+            const double no_data = -1;
+            // observations in a corner only
+            std::vector<PositionTime> observations;
+            for (size_t x = 0; x < 10; x++) {
+                for (size_t y = 0; y < 10; y++) {
+                    observations.emplace_back(truth.as_position(Cell{x, y}), truth(x, y));
+                }
+            }
+            const double radius = 100;
+            const DRaster reconstructed = FireMapReconstruction(radius, 16, 2, no_data).reconstruct(observations,
+                                                                                                 truth);
+            for (size_t x = 0; x < truth.x_width; x++) {
+                for (size_t y = 0; y < truth.y_height; y++) {
+                    // distance to the closest observation
+                    const double dx = x < 10 ? 0 : (x - 9.) * truth.cell_width;
+                    const double dy = y < 10 ? 0 : (y - 9.) * truth.cell_width;
+                    const double dist = sqrt(dx * dx + dy * dy);
+                    if (dist >= radius) {
+                        BOOST_CHECK_EQUAL(reconstructed(x, y), no_data);
+                    } else if (dist < radius - 1) {
+                        BOOST_CHECK_NE(reconstructed(x, y), no_data);
+                    }
+                }
+            }
+            // no observation at all
+            const DRaster empty = FireMapReconstruction(radius, 16, 2, no_data).reconstruct({}, truth);
+            BOOST_CHECK(std::all_of(empty.data.begin(), empty.data.end(), [no_data](double v) {
+                return v == no_data;
+            }));
+        }
+
+        test_suite* reconstruction_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("reconstruction_tests");
+            ts->add(BOOST_TEST_CASE(&test_kdtree_nearest));
+            ts->add(BOOST_TEST_CASE(&test_reconstruction_cone_fire));
+            ts->add(BOOST_TEST_CASE(&test_reconstruction_no_data));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_RECONSTRUCTION_H
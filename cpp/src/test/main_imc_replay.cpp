@@ -0,0 +1,102 @@
+/* Copyright (c) 2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+/* Replay a recording of IMC traffic (see IMCComm::record_to) through the GCS message handlers, and report the
+ * throughput and the time spent in each handler.
+ *
+ * Usage: imc_replay RECORDING [SPEED [WORKERS]]
+ *  SPEED: 0 (default) to replay as fast as possible, 1 to replay at the recorded pace, 10 ten times faster...
+ *  WORKERS: number of threads running handlers (see IMCComm::set_dispatch_workers), 1 by default */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+
+#include "../neptus/imc_comm.hpp"
+#include "../neptus/saop_server.hpp"
+
+using namespace SAOP::neptus;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " RECORDING [SPEED [WORKERS]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    double speed = argc > 2 ? std::atof(argv[2]) : 0.;
+    size_t workers = argc > 3 ? static_cast<size_t>(std::atoi(argv[3])) : 1;
+
+    // Per-message logs would dominate the measurements
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::error);
+
+    std::vector<IMCRecord> records;
+    try {
+        records = read_imc_recording(argv[1]);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto transport = new IMCReplayTransport();
+    auto imc_comm = std::make_shared<IMCComm>(std::unique_ptr<IMCTransport>(transport));
+    imc_comm->set_dispatch_workers(workers);
+    GCS gcs(imc_comm,
+            [](TrajectoryExecutionReport) {},
+            [](UAVStateReport) {},
+            [](FireMapReport) {});
+
+    imc_comm->run();
+    while (!imc_comm->is_ready()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto t_start = std::chrono::steady_clock::now();
+    size_t n_delivered = transport->replay(records, speed);
+    while (imc_comm->pending_messages() > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+
+    std::cout << n_delivered << " messages replayed in " << elapsed << " s ("
+              << n_delivered / elapsed << " msg/s), " << transport->sent_messages() << " sent" << std::endl;
+    std::cout << std::setw(24) << std::left << "message" << std::right
+              << std::setw(10) << "handled" << std::setw(10) << "dropped"
+              << std::setw(14) << "mean (us)" << std::setw(14) << "max (us)" << std::endl;
+    for (const auto& s : imc_comm->handler_stats()) {
+        std::cout << std::setw(24) << std::left << IMC::Factory::getAbbrevFromId(s.first) << std::right
+                  << std::setw(10) << s.second.count
+                  << std::setw(10) << imc_comm->dropped_messages(s.first)
+                  << std::setw(14) << s.second.total_time / s.second.count * 1e6
+                  << std::setw(14) << s.second.max_time * 1e6 << std::endl;
+    }
+
+    imc_comm->stop();
+    return EXIT_SUCCESS;
+}
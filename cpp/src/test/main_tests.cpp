@@ -24,7 +24,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "test_dubinswind.hpp"
 #include "test_position_manipulation.hpp"
+#include "test_visibility.hpp"
 #include "core/test_reversible_updates.hpp"
+#include "core/test_fire_data.hpp"
+#include "core/test_summed_area.hpp"
+#include "firemapping/test_reconstruction.hpp"
+#include "neptus/test_firemap_transfer.hpp"
+#include "neptus/test_imc_parser.hpp"
+#include "neptus/test_imc_transport.hpp"
+#include "neptus/test_message_pool.hpp"
+#include "neptus/test_plan_control_requests.hpp"
 #include <boost/test/included/unit_test.hpp>
 
 using namespace boost::unit_test;
@@ -33,12 +42,30 @@ test_suite* init_unit_test_suite(int /*argc*/, char* /*argv*/[]) {
     auto dubinswind_ts = SAOP::Test::dubinswind_test_suite();
     auto dubins_ts = SAOP::Test::dubins_test_suite();
     auto position_manipulation_ts = SAOP::Test::position_manipulation_test_suite();
+    auto visibility_ts = SAOP::Test::visibility_test_suite();
     auto reversible_updates_ts = SAOP::Test::reversible_updates_test_suite();
+    auto fire_data_ts = SAOP::Test::fire_data_test_suite();
+    auto summed_area_ts = SAOP::Test::summed_area_test_suite();
+    auto reconstruction_ts = SAOP::Test::reconstruction_test_suite();
+    auto imc_parser_ts = SAOP::Test::imc_parser_test_suite();
+    auto firemap_transfer_ts = SAOP::Test::firemap_transfer_test_suite();
+    auto imc_transport_ts = SAOP::Test::imc_transport_test_suite();
+    auto message_pool_ts = SAOP::Test::message_pool_test_suite();
+    auto plan_control_requests_ts = SAOP::Test::plan_control_requests_test_suite();
 
     framework::master_test_suite().add(dubinswind_ts);
     framework::master_test_suite().add(dubins_ts);
     framework::master_test_suite().add(position_manipulation_ts);
+    framework::master_test_suite().add(visibility_ts);
     framework::master_test_suite().add(reversible_updates_ts);
+    framework::master_test_suite().add(fire_data_ts);
+    framework::master_test_suite().add(summed_area_ts);
+    framework::master_test_suite().add(reconstruction_ts);
+    framework::master_test_suite().add(imc_parser_ts);
+    framework::master_test_suite().add(firemap_transfer_ts);
+    framework::master_test_suite().add(imc_transport_ts);
+    framework::master_test_suite().add(message_pool_ts);
+    framework::master_test_suite().add(plan_control_requests_ts);
 
     return nullptr;
 
@@ -0,0 +1,189 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_FIREMAP_TRANSFER_H
+#define PROJECT_TEST_FIREMAP_TRANSFER_H
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../../neptus/firemap_transfer.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+        using namespace SAOP::neptus;
+
+        DRaster unobserved_map() {
+            return DRaster(std::vector<double>(300 * 200, std::numeric_limits<double>::infinity()),
+                           300, 200, 10, 20, 25);
+        }
+
+        /** Writes new values in the area of the map, different at each step */
+        void observe_area(DRaster& map, const CellRect& area, int step) {
+            for (size_t y = area.y_min; y < area.y_max; y++) {
+                for (size_t x = area.x_min; x < area.x_max; x++) {
+                    map.set(x, y, step * 100. + x * 0.5 + y * 0.25);
+                }
+            }
+        }
+
+        void check_same_map(const DRaster& map, const DRaster& expected) {
+            BOOST_REQUIRE(map.is_like(expected));
+            BOOST_CHECK(map.data == expected.data);
+        }
+
+        /** Gives all fragments to the receiver, returning the areas it updated. */
+        std::vector<CellRect> receive_all(FireMapReceiver& receiver, const std::vector<std::vector<char>>& fragments) {
+            std::vector<CellRect> updated;
+            for (const auto& f : fragments) {
+                const std::vector<CellRect> u = receiver.receive(f);
+                updated.insert(updated.end(), u.begin(), u.end());
+            }
+            return updated;
+        }
+
+        void test_firemap_transfer_round_trip() {
+            std::mt19937 rng(3);
+            DRaster map = unobserved_map();
+            // small fragments, so that most updates are split
+            FireMapEncoder encoder(2154, 32, 1000);
+            FireMapReceiver receiver;
+
+            for (int step = 1; step <= 20; step++) {
+                const size_t x = rng() % 250, y = rng() % 150;
+                const CellRect area{x, y, x + 1 + rng() % 50, y + 1 + rng() % 50};
+                observe_area(map, area, step);
+                std::vector<std::vector<char>> fragments = encoder.encode(map, {area});
+                // reordered, with a duplicate
+                std::shuffle(fragments.begin(), fragments.end(), rng);
+                fragments.push_back(fragments.front());
+                BOOST_CHECK(!receive_all(receiver, fragments).empty());
+            }
+            BOOST_CHECK_EQUAL(receiver.epsg(), 2154);
+            check_same_map(receiver.firemap(), map);
+        }
+
+        void test_firemap_transfer_lost_fragments() {
+            DRaster map = unobserved_map();
+            FireMapEncoder encoder(2154, 32, 1000);
+            FireMapReceiver receiver;
+            receive_all(receiver, encoder.encode_all(map));
+
+            // an update missing one of its fragments is never applied
+            observe_area(map, CellRect{0, 0, 100, 100}, 1);
+            std::vector<std::vector<char>> fragments = encoder.encode(map, {CellRect{0, 0, 100, 100}});
+            BOOST_REQUIRE(fragments.size() > 1);
+            fragments.erase(fragments.begin() + 1);
+            BOOST_CHECK(receive_all(receiver, fragments).empty());
+            BOOST_CHECK(std::isinf(receiver.firemap()(10, 10)));
+
+            // later updates are applied regardless, and a full one heals the map
+            observe_area(map, CellRect{200, 150, 210, 160}, 2);
+            receive_all(receiver, encoder.encode(map, {CellRect{200, 150, 210, 160}}));
+            BOOST_CHECK_EQUAL(receiver.firemap()(205, 155), map(205, 155));
+            receive_all(receiver, encoder.encode_all(map));
+            check_same_map(receiver.firemap(), map);
+        }
+
+        void test_firemap_transfer_reordered_updates() {
+            DRaster map = unobserved_map();
+            FireMapEncoder encoder(2154, 32, 1000);
+            FireMapReceiver receiver;
+
+            const CellRect area{40, 40, 80, 80};
+            observe_area(map, area, 1);
+            const std::vector<std::vector<char>> older = encoder.encode(map, {area});
+            observe_area(map, area, 2);
+            const std::vector<std::vector<char>> newer = encoder.encode(map, {area});
+
+            // fragments of both updates interleaved, the newer one completing first
+            BOOST_REQUIRE(older.size() > 1 && older.size() == newer.size());
+            for (size_t i = 0; i < newer.size(); i++) {
+                receiver.receive(newer[i]);
+                if (i + 1 < older.size()) {
+                    receiver.receive(older[i]);
+                }
+            }
+            // the older update completes last and must not overwrite the tiles of the newer one
+            BOOST_CHECK(receiver.receive(older.back()).empty());
+            check_same_map(receiver.firemap(), map);
+        }
+
+        void test_firemap_transfer_stream_restart() {
+            DRaster map = unobserved_map();
+            FireMapReceiver receiver;
+            {
+                FireMapEncoder encoder(2154);
+                for (int i = 0; i < 5; i++) {
+                    receive_all(receiver, encoder.encode_all(map));
+                }
+            }
+            // a restarted sender numbers its updates from 1 again, they must not be taken as stale
+            FireMapEncoder restarted(2154);
+            observe_area(map, CellRect{3, 3, 4, 4}, 1);
+            BOOST_CHECK_EQUAL(receive_all(receiver, restarted.encode(map, {CellRect{3, 3, 4, 4}})).size(), 1);
+            check_same_map(receiver.firemap(), map);
+        }
+
+        void test_firemap_transfer_malformed() {
+            DRaster map = unobserved_map();
+            observe_area(map, CellRect{0, 0, 300, 200}, 1);
+            FireMapEncoder encoder(2154);
+            FireMapReceiver receiver;
+            receive_all(receiver, encoder.encode_all(map));
+
+            // truncated
+            std::vector<std::vector<char>> truncated = encoder.encode(map, {CellRect{0, 0, 10, 10}});
+            BOOST_REQUIRE_EQUAL(truncated.size(), 1);
+            truncated[0].resize(truncated[0].size() - 5);
+            BOOST_CHECK_THROW(receiver.receive(truncated[0]), std::invalid_argument);
+
+            // dimensions of a huge map, whose product overflows
+            std::vector<char> huge = encoder.encode(map, {})[0];
+            const size_t x_width_offset = firemap_transfer::fragment_header_size + sizeof(uint64_t);
+            for (uint64_t x_width : {uint64_t(1) << 40, uint64_t(1) << 63}) {
+                std::memcpy(&huge[x_width_offset], &x_width, sizeof(x_width));
+                BOOST_CHECK_THROW(receiver.receive(huge), std::invalid_argument);
+            }
+            // the map is left unchanged
+            check_same_map(receiver.firemap(), map);
+        }
+
+        test_suite* firemap_transfer_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("firemap_transfer_tests");
+            ts->add(BOOST_TEST_CASE(&test_firemap_transfer_round_trip));
+            ts->add(BOOST_TEST_CASE(&test_firemap_transfer_lost_fragments));
+            ts->add(BOOST_TEST_CASE(&test_firemap_transfer_reordered_updates));
+            ts->add(BOOST_TEST_CASE(&test_firemap_transfer_stream_restart));
+            ts->add(BOOST_TEST_CASE(&test_firemap_transfer_malformed));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_FIREMAP_TRANSFER_H
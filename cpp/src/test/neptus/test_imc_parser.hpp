@@ -0,0 +1,156 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_IMC_PARSER_H
+#define PROJECT_TEST_IMC_PARSER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../../../IMC/Base/Packet.hpp"
+#include "../../../IMC/Base/Parser.hpp"
+#include "../../../IMC/Spec/DevDataBinary.hpp"
+#include "../../../IMC/Spec/EstimatedState.hpp"
+#include "../../../IMC/Spec/Heartbeat.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+
+        std::vector<uint8_t> serialized(const IMC::Message& m) {
+            std::vector<uint8_t> bytes(m.getSerializationSize());
+            IMC::Packet::serialize(&m, bytes.data(), bytes.size());
+            return bytes;
+        }
+
+        /** Feeds the stream to a new parser in reads of at most 'read_size' bytes and returns the name and source
+         * of the parsed messages. */
+        std::vector<std::string> parse_in_reads(const std::vector<uint8_t>& stream, size_t read_size) {
+            IMC::Parser parser;
+            std::vector<IMC::Message*> parsed;
+            for (size_t pos = 0; pos < stream.size(); pos += read_size) {
+                const size_t n = std::min(read_size, stream.size() - pos);
+                BOOST_CHECK_EQUAL(parser.parse(stream.data() + pos, n, parsed), n);
+            }
+            std::vector<std::string> names;
+            for (IMC::Message* m : parsed) {
+                std::unique_ptr<IMC::Message> owned(m);
+                names.push_back(std::string(m->getName()) + std::to_string(m->getSource()));
+            }
+            return names;
+        }
+
+        void append(std::vector<uint8_t>& stream, const std::vector<uint8_t>& bytes) {
+            stream.insert(stream.end(), bytes.begin(), bytes.end());
+        }
+
+        /** Pads the stream with more zeros than the largest message. A false sync is only rejected once the message
+         * size announced by its header is received. */
+        void pad(std::vector<uint8_t>& stream) {
+            stream.resize(stream.size() + IMC_CONST_HEADER_SIZE + 65535 + IMC_CONST_FOOTER_SIZE, 0);
+        }
+
+        void test_parser_split_reads() {
+            IMC::Heartbeat hb;
+            hb.setSource(1);
+            IMC::EstimatedState es;
+            es.setSource(2);
+            es.x = 12.5;
+            IMC::DevDataBinary data;
+            data.setSource(3);
+            data.value.assign(5000, static_cast<char>(0xFE)); // payload full of sync bytes
+
+            std::vector<uint8_t> stream;
+            append(stream, serialized(hb));
+            append(stream, serialized(es));
+            append(stream, serialized(data));
+            append(stream, serialized(hb));
+            const std::vector<std::string> expected{"Heartbeat1", "EstimatedState2", "DevDataBinary3", "Heartbeat1"};
+
+            // messages cut in the sync word, in the header, in the payload and in the footer
+            for (size_t read_size : {1, 2, 3, 7, 19, 64, 1000, 4999, 100000}) {
+                BOOST_CHECK(parse_in_reads(stream, read_size) == expected);
+            }
+        }
+
+        void test_parser_false_sync() {
+            IMC::Heartbeat hb;
+            hb.setSource(1);
+            IMC::EstimatedState es;
+            es.setSource(2);
+
+            // sync words in both byte orders followed by garbage, and a header announcing more bytes than available
+            std::vector<uint8_t> stream{0x54, 0xFE, 0x00, 0xFE, 0x54, 0x12, 0x34, 0xFE};
+            std::vector<uint8_t> truncated = serialized(es);
+            truncated.resize(truncated.size() / 2);
+            append(stream, truncated);
+            append(stream, serialized(hb));
+            append(stream, serialized(es));
+            pad(stream);
+
+            for (size_t read_size : {1, 5, 30, 100000}) {
+                BOOST_CHECK(parse_in_reads(stream, read_size) ==
+                            (std::vector<std::string>{"Heartbeat1", "EstimatedState2"}));
+            }
+
+            // garbage that looks like a sync word just before a message
+            std::vector<uint8_t> sync_then_message{0xFE, 0x54, 0xFE};
+            append(sync_then_message, serialized(hb));
+            pad(sync_then_message);
+            for (size_t read_size : {1, 2, 3, 100000}) {
+                BOOST_CHECK(parse_in_reads(sync_then_message, read_size) == std::vector<std::string>{"Heartbeat1"});
+            }
+        }
+
+        void test_parser_corrupted_crc() {
+            IMC::Heartbeat hb;
+            hb.setSource(1);
+            IMC::EstimatedState es;
+            es.setSource(2);
+
+            std::vector<uint8_t> corrupted = serialized(es);
+            corrupted.back() ^= 0xFF; // CRC
+            std::vector<uint8_t> stream;
+            append(stream, serialized(hb));
+            append(stream, corrupted);
+            append(stream, serialized(hb));
+
+            for (size_t read_size : {1, 4, 50, 100000}) {
+                BOOST_CHECK(parse_in_reads(stream, read_size) == (std::vector<std::string>{"Heartbeat1", "Heartbeat1"}));
+            }
+        }
+
+        test_suite* imc_parser_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("imc_parser_tests");
+            ts->add(BOOST_TEST_CASE(&test_parser_split_reads));
+            ts->add(BOOST_TEST_CASE(&test_parser_false_sync));
+            ts->add(BOOST_TEST_CASE(&test_parser_corrupted_crc));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_IMC_PARSER_H
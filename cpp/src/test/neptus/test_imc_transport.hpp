@@ -0,0 +1,174 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_IMC_TRANSPORT_H
+#define PROJECT_TEST_IMC_TRANSPORT_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../../neptus/imc_comm.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+        using namespace SAOP::neptus;
+
+        /** A peer of an IMCTransportTCP, identified by the IMC address it uses as source of its messages */
+        class IMCTestPeer {
+            boost::asio::io_service io_service;
+            tcp::socket socket;
+            IMC::Parser parser;
+
+        public:
+            const uint16_t address;
+
+            IMCTestPeer(unsigned short port, uint16_t address) : socket(io_service), address(address) {
+                socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+                socket.non_blocking(true);
+            }
+
+            /** Announce the address of this peer to the transport */
+            void send_heartbeat() {
+                IMC::Heartbeat hb;
+                hb.setSource(address);
+                std::vector<uint8_t> bytes(hb.getSerializationSize());
+                IMC::Packet::serialize(&hb, bytes.data(), bytes.size());
+                boost::asio::write(socket, boost::asio::buffer(bytes));
+            }
+
+            /** Destinations of the messages received, waiting at most 'timeout' for 'expected' messages */
+            std::vector<uint16_t> receive(size_t expected,
+                                          std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) {
+                std::vector<uint16_t> destinations;
+                auto deadline = std::chrono::steady_clock::now() + timeout;
+                std::array<uint8_t, 4096> buffer;
+                while (destinations.size() < expected && std::chrono::steady_clock::now() < deadline) {
+                    boost::system::error_code error;
+                    size_t n = socket.read_some(boost::asio::buffer(buffer), error);
+                    if (error == boost::asio::error::would_block) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                        continue;
+                    }
+                    BOOST_REQUIRE(!error);
+                    for (size_t i = 0; i < n; i++) {
+                        std::unique_ptr<IMC::Message> m(parser.parse(buffer[i]));
+                        if (m) {
+                            destinations.push_back(m->getDestination());
+                        }
+                    }
+                }
+                return destinations;
+            }
+        };
+
+        std::unique_ptr<IMC::Message> message_to(uint16_t destination) {
+            std::unique_ptr<IMC::Message> m(new IMC::Heartbeat());
+            m->setDestination(destination);
+            return m;
+        }
+
+        /** Evaluate 'condition' until it holds, for at most two seconds */
+        template<typename F>
+        bool wait_for(F condition) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            bool holds = condition();
+            while (!holds && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                holds = condition();
+            }
+            return holds;
+        }
+
+        void test_tcp_transport_routing() {
+            const unsigned short port = 32817;
+            const uint16_t broadcast = IMCTransportTCP::broadcast_address;
+            std::atomic<size_t> received(0);
+            IMCTransportTCP transport(port, [&received](std::unique_ptr<IMC::Message>) { received++; });
+            transport.run();
+
+            // Sent before any peer is connected
+            transport.send(message_to(10));
+            transport.send(message_to(broadcast));
+            transport.send(message_to(20));
+            transport.send(message_to(20));
+
+            std::unique_ptr<IMCTestPeer> a;
+            BOOST_REQUIRE(wait_for([&]() {
+                try {
+                    a.reset(new IMCTestPeer(port, 10));
+                    return true;
+                } catch (const boost::system::system_error&) {
+                    return false;
+                }
+            }));
+            BOOST_REQUIRE(wait_for([&]() { return transport.num_sessions() == 1; }));
+            IMCTestPeer b(port, 20);
+            BOOST_REQUIRE(wait_for([&]() { return transport.num_sessions() == 2; }));
+
+            // Only the broadcast message is delivered before the peers are known, to the first one
+            BOOST_CHECK(a->receive(2, std::chrono::milliseconds(200)) == std::vector<uint16_t>{broadcast});
+            BOOST_CHECK(b.receive(1, std::chrono::milliseconds(200)).empty());
+
+            // Messages waiting for a peer are delivered to it, and only to it, once it announced its address
+            b.send_heartbeat();
+            BOOST_REQUIRE(wait_for([&]() { return received == 1; }));
+            BOOST_CHECK(b.receive(2) == (std::vector<uint16_t>{20, 20}));
+            BOOST_CHECK(a->receive(1, std::chrono::milliseconds(200)).empty());
+            a->send_heartbeat();
+            BOOST_REQUIRE(wait_for([&]() { return received == 2; }));
+            BOOST_CHECK(a->receive(1) == std::vector<uint16_t>{10});
+            BOOST_CHECK(b.receive(1, std::chrono::milliseconds(200)).empty());
+
+            // Known destinations go through their peer, broadcast and unknown ones to every peer
+            transport.send(message_to(20));
+            transport.send(message_to(10));
+            transport.send(message_to(broadcast));
+            transport.send(message_to(33));
+            BOOST_CHECK(a->receive(3) == (std::vector<uint16_t>{10, broadcast, 33}));
+            BOOST_CHECK(b.receive(3) == (std::vector<uint16_t>{20, broadcast, 33}));
+
+            // A route is forgotten when its peer disconnects
+            a.reset();
+            BOOST_REQUIRE(wait_for([&]() { return transport.num_sessions() == 1; }));
+            transport.send(message_to(10));
+            BOOST_CHECK(b.receive(1) == std::vector<uint16_t>{10});
+
+            transport.stop();
+        }
+
+        test_suite* imc_transport_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("imc_transport_tests");
+            ts->add(BOOST_TEST_CASE(&test_tcp_transport_routing));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_IMC_TRANSPORT_H
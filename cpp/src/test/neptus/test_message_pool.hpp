@@ -0,0 +1,150 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_MESSAGE_POOL_H
+#define PROJECT_TEST_MESSAGE_POOL_H
+
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../../../IMC/Base/MessagePool.hpp"
+#include "../../../IMC/Spec/EstimatedState.hpp"
+#include "../../../IMC/Spec/Heartbeat.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+
+        /** Allocation counters of the pool, as seen from the calling thread */
+        struct PoolStats {
+            size_t recycled = 0;
+            size_t allocated = 0;
+
+            static PoolStats current() {
+                PoolStats stats;
+                IMC::MessagePool::getStats(stats.recycled, stats.allocated);
+                return stats;
+            }
+        };
+
+        /** Messages created by one thread and deleted by another are recycled for a third one */
+        void test_message_pool_cross_thread() {
+            const size_t n = 500;
+            // Large enough for the shared pool to keep all blocks, whatever the previous tests left in it
+            IMC::MessagePool::setCapacity(100000);
+
+            std::vector<IMC::EstimatedState*> messages;
+            std::thread producer([&messages]() {
+                for (size_t i = 0; i < n; i++) {
+                    messages.push_back(new IMC::EstimatedState());
+                    messages.back()->x = static_cast<float>(i);
+                }
+            });
+            producer.join();
+
+            std::thread consumer([&messages]() {
+                for (size_t i = 0; i < n; i++) {
+                    BOOST_CHECK_EQUAL(messages[i]->x, static_cast<float>(i));
+                    delete messages[i];
+                }
+            });
+            consumer.join();
+            messages.clear();
+
+            // The blocks released by the consumer are all back in the shared pool once it terminated
+            std::thread reuser([n]() {
+                PoolStats before = PoolStats::current();
+                std::vector<std::unique_ptr<IMC::EstimatedState>> reused;
+                for (size_t i = 0; i < n; i++) {
+                    reused.emplace_back(new IMC::EstimatedState());
+                    reused.back()->x = static_cast<float>(i);
+                }
+                PoolStats after = PoolStats::current();
+                BOOST_CHECK_EQUAL(after.allocated, before.allocated);
+                BOOST_CHECK_EQUAL(after.recycled, before.recycled + n);
+                for (size_t i = 0; i < n; i++) {
+                    BOOST_CHECK_EQUAL(reused[i]->x, static_cast<float>(i));
+                }
+            });
+            reuser.join();
+
+            // Statistics of terminated threads are kept
+            PoolStats total = PoolStats::current();
+            BOOST_CHECK_GE(total.recycled, n);
+
+            IMC::MessagePool::setCapacity(1024);
+        }
+
+        /** Message larger than the largest pooled block (2048 bytes) */
+        struct LargeMessage : public IMC::Heartbeat {
+            char payload[3000];
+        };
+
+        /** Blocks too large to be pooled go to the system allocator each time */
+        void test_message_pool_large_blocks() {
+            for (size_t size : {2048, 3000, 100000}) {
+                PoolStats before = PoolStats::current();
+                for (int i = 0; i < 3; i++) {
+                    void* block = IMC::MessagePool::allocate(size);
+                    std::memset(block, 0xAB, size);
+                    IMC::MessagePool::release(block, size);
+                }
+                PoolStats after = PoolStats::current();
+                BOOST_CHECK_EQUAL(after.allocated, before.allocated + 3);
+                BOOST_CHECK_EQUAL(after.recycled, before.recycled);
+            }
+
+            PoolStats before = PoolStats::current();
+            for (int i = 0; i < 3; i++) {
+                std::unique_ptr<IMC::Message> m(new LargeMessage());
+                std::memset(static_cast<LargeMessage*>(m.get())->payload, 0xCD, sizeof(LargeMessage::payload));
+                BOOST_CHECK_EQUAL(m->getId(), IMC::Heartbeat::getIdStatic());
+            }
+            PoolStats after = PoolStats::current();
+            BOOST_CHECK_EQUAL(after.allocated, before.allocated + 3);
+            BOOST_CHECK_EQUAL(after.recycled, before.recycled);
+
+            // The largest pooled size is recycled
+            const size_t pooled = 2048 - 16;
+            IMC::MessagePool::release(IMC::MessagePool::allocate(pooled), pooled);
+            before = PoolStats::current();
+            IMC::MessagePool::release(IMC::MessagePool::allocate(pooled), pooled);
+            after = PoolStats::current();
+            BOOST_CHECK_EQUAL(after.allocated, before.allocated);
+            BOOST_CHECK_EQUAL(after.recycled, before.recycled + 1);
+        }
+
+        test_suite* message_pool_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("message_pool_tests");
+            ts->add(BOOST_TEST_CASE(&test_message_pool_cross_thread));
+            ts->add(BOOST_TEST_CASE(&test_message_pool_large_blocks));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_MESSAGE_POOL_H
@@ -0,0 +1,227 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PROJECT_TEST_PLAN_CONTROL_REQUESTS_H
+#define PROJECT_TEST_PLAN_CONTROL_REQUESTS_H
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../neptus/saop_server.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+        using namespace SAOP::neptus;
+
+        /** Outcomes given to the completion callback of a request */
+        struct Completions {
+            std::atomic<int> successes{0};
+            std::atomic<int> failures{0};
+
+            RequestCompletion callback() {
+                return [this](bool success) {
+                    if (success) {
+                        successes++;
+                    } else {
+                        failures++;
+                    }
+                };
+            }
+
+            int count() const {
+                return successes + failures;
+            }
+        };
+
+        IMC::PlanControl plan_control_answer(uint16_t request_id, IMC::PlanControl::TypeEnum type,
+                                             const std::string& info) {
+            IMC::PlanControl answer;
+            answer.request_id = request_id;
+            answer.type = type;
+            answer.info = info;
+            return answer;
+        }
+
+        bool is_ready(const std::future<bool>& f) {
+            return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        const std::chrono::milliseconds no_timeout = std::chrono::milliseconds(60000);
+
+        void test_requests_completed_once() {
+            PlanControlRequests requests;
+            Completions succeeded, failed, no_callback;
+            std::future<bool> f_succeeded, f_failed, f_no_callback;
+            uint16_t id_succeeded = requests.add(stop_outcome, succeeded.callback(), no_timeout, f_succeeded);
+            uint16_t id_failed = requests.add(load_outcome, failed.callback(), no_timeout, f_failed);
+            uint16_t id_no_callback = requests.add(stop_outcome, nullptr, no_timeout, f_no_callback);
+            BOOST_CHECK_NE(id_succeeded, id_failed);
+            BOOST_CHECK_NE(id_failed, id_no_callback);
+
+            BOOST_CHECK(requests.answer(plan_control_answer(id_succeeded, IMC::PlanControl::PC_SUCCESS, "")));
+            BOOST_CHECK(requests.answer(plan_control_answer(id_failed, IMC::PlanControl::PC_FAILURE, "")));
+            // Stopping nothing is a success
+            BOOST_CHECK(requests.answer(plan_control_answer(id_no_callback, IMC::PlanControl::PC_FAILURE,
+                                                            "no plan is running, request ignored")));
+            BOOST_REQUIRE(is_ready(f_succeeded) && is_ready(f_failed) && is_ready(f_no_callback));
+            BOOST_CHECK(f_succeeded.get());
+            BOOST_CHECK(!f_failed.get());
+            BOOST_CHECK(f_no_callback.get());
+            BOOST_CHECK_EQUAL(succeeded.successes, 1);
+            BOOST_CHECK_EQUAL(succeeded.failures, 0);
+            BOOST_CHECK_EQUAL(failed.successes, 0);
+            BOOST_CHECK_EQUAL(failed.failures, 1);
+
+            // Answered requests are forgotten, later answers are not theirs
+            BOOST_CHECK(!requests.answer(plan_control_answer(id_succeeded, IMC::PlanControl::PC_SUCCESS, "")));
+            BOOST_CHECK(!requests.answer(plan_control_answer(id_failed, IMC::PlanControl::PC_SUCCESS, "")));
+            BOOST_CHECK_EQUAL(succeeded.count(), 1);
+            BOOST_CHECK_EQUAL(failed.count(), 1);
+        }
+
+        void test_requests_expire_at_deadline() {
+            PlanControlRequests requests;
+            Completions expired, answered;
+            std::future<bool> f_expired, f_answered;
+            const auto t_start = std::chrono::steady_clock::now();
+            uint16_t id_expired = requests.add(stop_outcome, expired.callback(), std::chrono::milliseconds(100),
+                                               f_expired);
+            uint16_t id_answered = requests.add(stop_outcome, answered.callback(), std::chrono::milliseconds(400),
+                                                f_answered);
+
+            BOOST_REQUIRE(f_expired.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+            BOOST_CHECK(std::chrono::steady_clock::now() - t_start >= std::chrono::milliseconds(100));
+            BOOST_CHECK(!f_expired.get());
+            BOOST_CHECK_EQUAL(expired.failures, 1);
+            // An expired request is not tracked anymore
+            BOOST_CHECK(!requests.answer(plan_control_answer(id_expired, IMC::PlanControl::PC_SUCCESS, "")));
+            BOOST_CHECK_EQUAL(expired.count(), 1);
+
+            // The other one still waits for its deadline
+            BOOST_CHECK(!is_ready(f_answered));
+            BOOST_CHECK(requests.answer(plan_control_answer(id_answered, IMC::PlanControl::PC_SUCCESS, "")));
+            BOOST_CHECK(f_answered.get());
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            BOOST_CHECK_EQUAL(answered.successes, 1);
+            BOOST_CHECK_EQUAL(answered.count(), 1);
+        }
+
+        /** Requests answered by another thread right at their deadline are completed once, by either */
+        void test_requests_answered_at_deadline() {
+            const size_t n = 200;
+            const auto timeout = std::chrono::milliseconds(20);
+            PlanControlRequests requests;
+            std::vector<std::unique_ptr<Completions>> completions;
+            std::vector<std::future<bool>> futures(n);
+            std::vector<uint16_t> ids;
+            for (size_t i = 0; i < n; i++) {
+                completions.emplace_back(new Completions());
+                ids.push_back(requests.add(stop_outcome, completions.back()->callback(), timeout, futures[i]));
+            }
+            std::thread answering([&]() {
+                std::this_thread::sleep_for(timeout);
+                for (uint16_t id : ids) {
+                    requests.answer(plan_control_answer(id, IMC::PlanControl::PC_SUCCESS, ""));
+                }
+            });
+            answering.join();
+            for (size_t i = 0; i < n; i++) {
+                BOOST_REQUIRE(futures[i].wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+                // get() throws if the promise was broken
+                const bool success = futures[i].get();
+                BOOST_CHECK_EQUAL(completions[i]->count(), 1);
+                BOOST_CHECK_EQUAL(completions[i]->successes, success ? 1 : 0);
+            }
+        }
+
+        /** Starting a plan specification is first answered by "plan loaded", the request waits for the start */
+        void test_start_waits_for_execution() {
+            PlanControlRequests requests;
+            Completions started;
+            std::future<bool> f_started;
+            uint16_t id = requests.add(start_outcome, started.callback(), no_timeout, f_started);
+
+            BOOST_CHECK(requests.answer(plan_control_answer(id, IMC::PlanControl::PC_SUCCESS, "plan loaded")));
+            BOOST_CHECK(!is_ready(f_started));
+            BOOST_CHECK_EQUAL(started.count(), 0);
+
+            BOOST_CHECK(requests.answer(plan_control_answer(id, IMC::PlanControl::PC_SUCCESS,
+                                                            "executing maneuver 1")));
+            BOOST_REQUIRE(is_ready(f_started));
+            BOOST_CHECK(f_started.get());
+            BOOST_CHECK_EQUAL(started.successes, 1);
+            BOOST_CHECK(!requests.answer(plan_control_answer(id, IMC::PlanControl::PC_SUCCESS,
+                                                             "executing maneuver 2")));
+            BOOST_CHECK_EQUAL(started.count(), 1);
+
+            // A load request is complete once the plan is loaded
+            Completions loaded;
+            std::future<bool> f_loaded;
+            uint16_t load_id = requests.add(load_outcome, loaded.callback(), no_timeout, f_loaded);
+            BOOST_CHECK(requests.answer(plan_control_answer(load_id, IMC::PlanControl::PC_SUCCESS, "plan loaded")));
+            BOOST_REQUIRE(is_ready(f_loaded));
+            BOOST_CHECK(f_loaded.get());
+            BOOST_CHECK_EQUAL(loaded.successes, 1);
+        }
+
+        void test_requests_failed_on_destruction() {
+            Completions first, second;
+            std::future<bool> f_first, f_second;
+            {
+                PlanControlRequests requests;
+                requests.add(stop_outcome, first.callback(), no_timeout, f_first);
+                uint16_t id = requests.add(start_outcome, second.callback(), no_timeout, f_second);
+                BOOST_CHECK(requests.answer(plan_control_answer(id, IMC::PlanControl::PC_SUCCESS, "plan loaded")));
+                BOOST_CHECK(!is_ready(f_first));
+                BOOST_CHECK(!is_ready(f_second));
+            }
+            BOOST_REQUIRE(is_ready(f_first) && is_ready(f_second));
+            BOOST_CHECK(!f_first.get());
+            BOOST_CHECK(!f_second.get());
+            BOOST_CHECK_EQUAL(first.failures, 1);
+            BOOST_CHECK_EQUAL(first.count(), 1);
+            BOOST_CHECK_EQUAL(second.failures, 1);
+            BOOST_CHECK_EQUAL(second.count(), 1);
+        }
+
+        test_suite* plan_control_requests_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("plan_control_requests_tests");
+            ts->add(BOOST_TEST_CASE(&test_requests_completed_once));
+            ts->add(BOOST_TEST_CASE(&test_requests_expire_at_deadline));
+            ts->add(BOOST_TEST_CASE(&test_requests_answered_at_deadline));
+            ts->add(BOOST_TEST_CASE(&test_start_waits_for_execution));
+            ts->add(BOOST_TEST_CASE(&test_requests_failed_on_destruction));
+            return ts;
+        }
+    }
+}
+#endif //PROJECT_TEST_PLAN_CONTROL_REQUESTS_H
@@ -134,7 +134,6 @@ namespace SAOP {
             ts1->add(BOOST_TEST_CASE(&test_medium_alt_SSLS));
             ts1->add(BOOST_TEST_CASE(&test_length_medium_alt));
             ts1->add(BOOST_TEST_CASE(&test_length_high_alt));
-            ts1->add(BOOST_TEST_CASE(&test_length_flat));
             ts1->add(BOOST_TEST_CASE(&test_triangleineq_flat));
             ts1->add(BOOST_TEST_CASE(&test_triangleineq_high));
             ts1->add(BOOST_TEST_CASE(&test_helix_optimization_convergence));
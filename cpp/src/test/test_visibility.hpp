@@ -0,0 +1,132 @@
+/* Copyright (c) 2017, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_TEST_VISIBILITY_HPP
+#define PLANNING_CPP_TEST_VISIBILITY_HPP
+
+#include "../core/raster.hpp"
+#include "../core/uav.hpp"
+#include "../vns/visibility.hpp"
+#include <boost/test/included/unit_test.hpp>
+
+namespace SAOP {
+    namespace Test {
+
+        using namespace boost::unit_test;
+
+        /** Cost of the pending cells computed from scratch: each one costs its distance to the closest visited cell,
+         * up to 500m. */
+        double brute_force_visibility_cost(const Visibility& v) {
+            std::vector<Cell> visited;
+            for (size_t y = 0; y < v.visibility.y_height; y++) {
+                for (size_t x = 0; x < v.visibility.x_width; x++) {
+                    if (v.is_of_interest(x, y) && v.is_visible(x, y)) {
+                        visited.push_back(Cell{x, y});
+                    }
+                }
+            }
+            double cost = 0;
+            for (size_t y = 0; y < v.visibility.y_height; y++) {
+                for (size_t x = 0; x < v.visibility.x_width; x++) {
+                    if (v.is_of_interest(x, y) && !v.is_visible(x, y)) {
+                        double dist = 500.;
+                        for (const Cell& c : visited) {
+                            dist = std::min(dist, sqrt(pow((double) c.x - x, 2) + pow((double) c.y - y, 2)) *
+                                                  v.cell_width);
+                        }
+                        cost += dist / 500.;
+                    }
+                }
+            }
+            return cost;
+        }
+
+        /** Cells of interest in a band of ignition times, segments crossing it in random directions. */
+        void test_visibility_cost() {
+            srand(0);
+            DRaster ignitions(80, 60, 0, 0, 25);
+            for (size_t x = 0; x < 80; x++) {
+                for (size_t y = 0; y < 60; y++) {
+                    ignitions.set(x, y, sqrt(pow(x - 20., 2) + pow(y - 30., 2)) * 60);
+                }
+            }
+            const UAV uav("visibility-uav", 18., 32. * M_PI / 180, 0.1);
+            Visibility v(ignitions, 600, 2400);
+            BOOST_CHECK_CLOSE(v.cost(), brute_force_visibility_cost(v), 1e-6);
+
+            std::vector<Segment> segments;
+            for (size_t i = 0; i < 12; i++) {
+                segments.emplace_back(Waypoint(drand(0, 2000), drand(0, 1500), drand(0, 2 * M_PI)), drand(0, 400));
+                v.add_segment(uav, segments.back());
+                BOOST_CHECK_CLOSE(v.cost(), brute_force_visibility_cost(v), 1e-6);
+            }
+            // overlapping segments only make their cells pending once both are removed
+            for (size_t i = 0; i < 12; i += 2) {
+                v.remove_segment(uav, segments[i]);
+                BOOST_CHECK_CLOSE(v.cost(), brute_force_visibility_cost(v), 1e-6);
+            }
+
+            const Segment added(Waypoint(700, 700, 1.), 300);
+            const Segment removed = segments[1];
+            const LRaster visibility_before = v.visibility;
+            const DRaster costs_before = v.pending_costs;
+            const double cost_before = v.cost();
+
+            const double cost_swap = v.cost_given_swap(uav, added, removed);
+            const double cost_removal = v.cost_given_removal(uav, removed);
+            const double cost_addition = v.cost_given_addition(uav, added);
+
+            // the state is restored after each evaluation
+            BOOST_CHECK(v.visibility.data == visibility_before.data);
+            BOOST_CHECK(v.pending_costs.data == costs_before.data);
+            BOOST_CHECK_EQUAL(v.cost(), cost_before);
+
+            Visibility swapped = v;
+            swapped.add_segment(uav, added);
+            swapped.remove_segment(uav, removed);
+            BOOST_CHECK_CLOSE(cost_swap, brute_force_visibility_cost(swapped), 1e-6);
+
+            Visibility with_removal = v;
+            with_removal.remove_segment(uav, removed);
+            BOOST_CHECK_CLOSE(cost_removal, brute_force_visibility_cost(with_removal), 1e-6);
+
+            Visibility with_addition = v;
+            with_addition.add_segment(uav, added);
+            BOOST_CHECK_CLOSE(cost_addition, brute_force_visibility_cost(with_addition), 1e-6);
+
+            // indexes were restored as well: later changes still give exact costs
+            v.add_segment(uav, added);
+            v.remove_segment(uav, removed);
+            BOOST_CHECK_CLOSE(v.cost(), brute_force_visibility_cost(v), 1e-6);
+        }
+
+        test_suite* visibility_test_suite() {
+            test_suite* ts = BOOST_TEST_SUITE("visibility_tests");
+            ts->add(BOOST_TEST_CASE(&test_visibility_cost));
+            return ts;
+        }
+    }
+}
+
+#endif //PLANNING_CPP_TEST_VISIBILITY_HPP
@@ -0,0 +1,316 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_CONSTRUCTION_H
+#define PLANNING_CPP_CONSTRUCTION_H
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "plan.hpp"
+#include "../ext/json.hpp"
+#include "../ext/ThreadPool.hpp"
+
+namespace SAOP {
+
+    using json = nlohmann::json;
+
+    /** Interface for heuristics building an initial plan, to be refined by local search afterwards. */
+    struct PlanConstructor {
+        virtual ~PlanConstructor() = default;
+
+        /** Adds observations to the given plan, returning after at most 'max_time_secs' seconds (wall clock).
+         * Segments already in the plan are kept. */
+        virtual void construct(Plan& p, double max_time_secs) = 0;
+
+        virtual std::string name() const = 0;
+
+        /** Statistics about the last construction, to be included in the search metadata. */
+        virtual json metadata() const { return json(); }
+    };
+
+    /** Greedy insertion of observations with regret-k selection.
+     *
+     * At each step, the best insertion (in ratio of estimated utility gain over added flight time) of every
+     * candidate observation is computed for each trajectory. The candidate with the largest regret, i.e., the one
+     * that would lose the most if not inserted in its best trajectory, is inserted at its best place.
+     * With a single trajectory this is a plain best-ratio greedy insertion.
+     * The process stops when no candidate can be inserted anymore, or when 'max_insertions' or 'max_time'
+     * is reached.
+     *
+     * Candidates are a subset of the possible observations of the plan. Like in OneInsertNbhd, each candidate is
+     * projected on the fire front at the time the UAV would reach it, and the insertion must fit in the maximum
+     * flight time of the trajectory. The plan is post-processed (projection, smoothing) at the end. */
+    struct RegretInsertionConstructor final : public PlanConstructor {
+
+        std::string name() const override {
+            return "regret-insertion";
+        }
+
+        /** Number of trajectories considered in the regret. With 1, the best ratio is selected. */
+        const size_t regret_k;
+
+        /** Maximum number of possible observations considered as candidates. */
+        const size_t max_candidates;
+
+        /** Maximum number of segments inserted. */
+        const size_t max_insertions;
+
+        /** Wall clock time (s) after which no more segments are inserted. */
+        const double max_time;
+
+        /** Number of threads evaluating candidates. */
+        const size_t num_threads;
+
+        explicit RegretInsertionConstructor(size_t regret_k = 2, size_t max_candidates = 200,
+                                            size_t max_insertions = 100, double max_time = 2.,
+                                            size_t num_threads = 0)
+                : regret_k(std::max<size_t>(regret_k, 1)),
+                  max_candidates(max_candidates),
+                  max_insertions(max_insertions),
+                  max_time(max_time),
+                  num_threads(num_threads > 0 ? num_threads :
+                              std::max<size_t>(std::thread::hardware_concurrency(), 1)) {}
+
+        void construct(Plan& p, double max_time_secs) override {
+            num_inserted = 0;
+            if (p.trajectories().empty() || p.possible_observations.empty()) {
+                return;
+            }
+
+            const double time_limit = std::min(max_time, max_time_secs);
+            const auto start = std::chrono::steady_clock::now();
+            auto elapsed = [start]() {
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            };
+
+            std::vector<PointTimeWindow> candidates = select_candidates(p);
+            if (!pool) {
+                pool.reset(new ThreadPool(num_threads));
+            }
+
+            while (num_inserted < max_insertions && !candidates.empty() && elapsed() < time_limit) {
+                // Plan::estimated_gain() reads the lazily computed utility map of the plan, make sure it is
+                // computed before the plan is shared among threads. Plan::utility() is not enough as it may be
+                // answered by the evaluation cache.
+                p.compute_utility_map();
+
+                std::vector<CandidateInsertions> insertions = evaluate_candidates(*pool, p, candidates);
+
+                opt<size_t> selected = {};
+                double selected_regret = 0.;
+                for (size_t i = 0; i < insertions.size(); i++) {
+                    if (!insertions[i].best) {
+                        continue;
+                    }
+                    const double regret = insertions[i].regret(regret_k);
+                    if (!selected || regret > selected_regret ||
+                        (regret == selected_regret &&
+                         insertions[i].best->ratio > insertions[*selected].best->ratio)) {
+                        selected = i;
+                        selected_regret = regret;
+                    }
+                }
+
+                if (!selected) {
+                    // no candidate can be inserted anymore
+                    break;
+                }
+
+                p.update(SegmentUpdate::insert(insertions[*selected].best->traj_id,
+                                               insertions[*selected].best->segment,
+                                               insertions[*selected].best->insert_loc));
+                num_inserted++;
+
+                // drop the inserted candidate. Others are kept as the fire front they are projected on moves
+                // along with the trajectories.
+                candidates.erase(candidates.begin() + *selected);
+            }
+
+            p.post_process();
+            BOOST_LOG_TRIVIAL(debug) << "Plan \"" << p.name() << "\" constructed with " << num_inserted
+                                     << " insertions: { utility: " << p.utility()
+                                     << ", duration: " << p.duration() << " }";
+        }
+
+        json metadata() const override {
+            json j;
+            j["name"] = name();
+            j["regret_k"] = regret_k;
+            j["insertions"] = num_inserted;
+            return j;
+        }
+
+    private:
+        size_t num_inserted = 0;
+
+        /** Workers evaluating candidates, created on the first construction and reused afterwards. */
+        std::unique_ptr<ThreadPool> pool;
+
+        /** Bound on the number of projections on the fire front of a candidate, see OneInsertNbhd. */
+        static constexpr size_t max_projection_iterations = 10;
+
+        struct Insertion {
+            size_t traj_id;
+            size_t insert_loc;
+            Segment3d segment;
+            double ratio;
+        };
+
+        /** Best insertion of a candidate in each trajectory (ratio of 0 if it cannot be inserted there). */
+        struct CandidateInsertions {
+            opt<Insertion> best;
+            std::vector<double> ratio_per_trajectory;
+
+            /** Sum of the differences between the best ratio and the ratio in the (k-1) next best trajectories. */
+            double regret(size_t k) const {
+                ASSERT(best);
+                std::vector<double> ratios = ratio_per_trajectory;
+                std::sort(ratios.begin(), ratios.end(), std::greater<double>());
+                double r = 0.;
+                for (size_t i = 1; i < k; i++) {
+                    r += best->ratio - (i < ratios.size() ? ratios[i] : 0.);
+                }
+                return r;
+            }
+        };
+
+        /** Possible observations considered for insertion, evenly picked if they are too many. */
+        std::vector<PointTimeWindow> select_candidates(const Plan& p) const {
+            const std::vector<PointTimeWindow>& all = p.possible_observations;
+            if (all.size() <= max_candidates) {
+                return all;
+            }
+            std::vector<PointTimeWindow> selected;
+            selected.reserve(max_candidates);
+            const double step = (double) all.size() / (double) max_candidates;
+            for (size_t i = 0; i < max_candidates; i++) {
+                selected.push_back(all[(size_t) (i * step)]);
+            }
+            return selected;
+        }
+
+        /** Computes the insertions of all candidates, in parallel over contiguous chunks of candidates. */
+        std::vector<CandidateInsertions>
+        evaluate_candidates(ThreadPool& pool, const Plan& p, const std::vector<PointTimeWindow>& candidates) const {
+            std::vector<CandidateInsertions> insertions(candidates.size());
+            const size_t chunk_size = std::max<size_t>(1, (candidates.size() + num_threads - 1) / num_threads);
+
+            std::vector<std::future<void>> chunks;
+            for (size_t first = 0; first < candidates.size(); first += chunk_size) {
+                const size_t last = std::min(first + chunk_size, candidates.size());
+                chunks.push_back(pool.enqueue([this, &p, &candidates, &insertions, first, last]() {
+                    for (size_t i = first; i < last; i++) {
+                        insertions[i] = insertions_of(p, candidates[i]);
+                    }
+                }));
+            }
+            for (auto& c : chunks) {
+                c.get();
+            }
+            return insertions;
+        }
+
+        /** Best insertion of an observation in each trajectory of the plan. Only reads the plan. */
+        CandidateInsertions insertions_of(const Plan& p, const PointTimeWindow& candidate) const {
+            CandidateInsertions result;
+            result.ratio_per_trajectory = std::vector<double>(p.trajectories().size(), 0.);
+
+            for (size_t traj_id = 0; traj_id < p.trajectories().size(); traj_id++) {
+                const Trajectory& traj = p.trajectories()[traj_id];
+                const UAV& uav = traj.conf().uav;
+                if (traj.size() == 0) {
+                    continue;
+                }
+
+                for (size_t loc = std::max<size_t>(traj.insertion_range_start(), 1);
+                     loc <= std::min(traj.insertion_range_end(), traj.size()); loc++) {
+                    const Segment3d prev = traj.segment(loc - 1);
+
+                    // observe in the direction from the previous to the next segment
+                    double dir;
+                    if (loc < traj.size()) {
+                        const Waypoint3d next = traj.segment(loc).start;
+                        dir = atan2(next.y - prev.end.y, next.x - prev.end.x);
+                    } else {
+                        dir = atan2(candidate.pt.y - prev.end.y, candidate.pt.x - prev.end.x);
+                    }
+                    // project the observation on the fire front at the time the UAV reaches it,
+                    // until arrival time and position agree
+                    opt<Segment3d> seg = uav.observation_segment(candidate.pt.x, candidate.pt.y,
+                                                                 traj.segment(0).start.z, dir, 0.);
+                    for (size_t iter = 0; seg && iter < max_projection_iterations; iter++) {
+                        const double arrival = traj.end_time(loc - 1) +
+                                               uav.travel_time(prev.end, seg->start, traj.conf().wind);
+                        const opt<Segment3d> projected = p.firedata().project_on_firefront(*seg, uav, arrival);
+                        if (!projected || *projected == *seg) {
+                            seg = projected;
+                            break;
+                        }
+                        seg = uav.rotate_on_visibility_center(*projected, dir);
+                    }
+                    if (!seg) {
+                        continue;
+                    }
+
+                    // discard if too close to its neighbors, as OneInsertNbhd does
+                    if (seg->start.as_point().dist(prev.end.as_point()) < 4 * uav.min_turn_radius() ||
+                        (loc < traj.size() &&
+                         seg->end.as_point().dist(traj.segment(loc).start.as_point()) <
+                         4 * uav.min_turn_radius())) {
+                        continue;
+                    }
+
+                    const double added_time = traj.insertion_duration_cost(loc, *seg);
+                    if (traj.duration() + added_time > traj.conf().max_flight_time) {
+                        continue;
+                    }
+
+                    const double gain = p.estimated_gain(SegmentUpdate::insert(traj_id, *seg, loc));
+                    if (gain <= 0) {
+                        continue;
+                    }
+                    const double ratio = gain / std::max(added_time, 1.);
+
+                    if (ratio > result.ratio_per_trajectory[traj_id]) {
+                        result.ratio_per_trajectory[traj_id] = ratio;
+                    }
+                    if (!result.best || ratio > result.best->ratio) {
+                        result.best = Insertion{traj_id, loc, *seg, ratio};
+                    }
+                }
+            }
+            return result;
+        }
+    };
+}
+
+#endif //PLANNING_CPP_CONSTRUCTION_H
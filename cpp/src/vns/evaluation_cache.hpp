@@ -0,0 +1,127 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_EVALUATION_CACHE_H
+#define PLANNING_CPP_EVALUATION_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../ext/json.hpp"
+#include "../ext/optional.hpp"
+#include "../utils.hpp"
+
+namespace SAOP {
+
+    using json = nlohmann::json;
+
+    /** Utility, duration and validity a plan would have after a tentative update. */
+    struct PlanEvaluation {
+        double utility;
+        double duration;
+        size_t num_segments;
+        bool valid;
+    };
+
+    /** Bounded cache of plan evaluations, indexed by the hash of the plan trajectories (Trajectories::hash()).
+     *
+     * The table is direct-mapped: each hash has a single slot and a new entry overwrites whatever was there.
+     * An entry is only returned for a plan with the same duration and number of segments as the one it was stored
+     * for, so that a hash collision between different plans is detected rather than returning the wrong utility.
+     * Its memory is allocated once at construction.
+     * Entries are only meaningful for plans sharing the same fire data and initial utility,
+     * i.e., the cache should not outlive a single search. It is not thread safe. */
+    class EvaluationCache {
+    public:
+        /** Creates a cache with at least 'capacity' slots (rounded up to a power of two). */
+        explicit EvaluationCache(size_t capacity) {
+            size_t n = 1;
+            while (n < capacity) {
+                n <<= 1;
+            }
+            entries = std::vector<Entry>(n, Entry{0, false, PlanEvaluation{0., 0., 0, false}});
+            mask = n - 1;
+        }
+
+        /** Evaluation previously stored for a plan with this hash, duration and number of segments, if any.
+         * Hits and misses are counted in the cache statistics. */
+        opt<PlanEvaluation> find(uint64_t hash, double duration, size_t num_segments) {
+            const opt<PlanEvaluation> found = peek(hash, duration, num_segments);
+            if (found) {
+                _hits++;
+            } else {
+                _misses++;
+            }
+            return found;
+        }
+
+        /** Same as find(), without updating the cache statistics. */
+        opt<PlanEvaluation> peek(uint64_t hash, double duration, size_t num_segments) const {
+            const Entry& e = entries[hash & mask];
+            if (e.used && e.hash == hash && e.evaluation.duration == duration &&
+                e.evaluation.num_segments == num_segments) {
+                return e.evaluation;
+            }
+            return {};
+        }
+
+        void store(uint64_t hash, const PlanEvaluation& evaluation) {
+            entries[hash & mask] = Entry{hash, true, evaluation};
+        }
+
+        size_t capacity() const { return entries.size(); }
+
+        size_t hits() const { return _hits; }
+
+        size_t misses() const { return _misses; }
+
+        double hit_rate() const {
+            return _hits + _misses == 0 ? 0. : (double) _hits / (double) (_hits + _misses);
+        }
+
+        json metadata() const {
+            json j;
+            j["capacity"] = capacity();
+            j["hits"] = hits();
+            j["misses"] = misses();
+            j["hit_rate"] = hit_rate();
+            return j;
+        }
+
+    private:
+        struct Entry {
+            uint64_t hash;
+            bool used;
+            PlanEvaluation evaluation;
+        };
+
+        std::vector<Entry> entries;
+        size_t mask;
+
+        size_t _hits = 0;
+        size_t _misses = 0;
+    };
+}
+
+#endif //PLANNING_CPP_EVALUATION_CACHE_H
@@ -79,8 +79,13 @@ namespace SAOP {
             const bool select_arbitrary_trajectory = conf["select_arbitrary_trajectory"];
             check_field_is_present(conf, "select_arbitrary_position");
             const bool select_arbitrary_position = conf["select_arbitrary_position"];
+            const size_t screening_top_k = conf.find("screening_top_k") != conf.end() ?
+                                           conf["screening_top_k"].get<size_t>() : 0;
+            const bool sample_reachable = conf.find("sample_reachable") != conf.end() ?
+                                          conf["sample_reachable"].get<bool>() : false;
             return make_shared<OneInsertNbhd>(
-                    max_trials, select_arbitrary_trajectory, select_arbitrary_position
+                    max_trials, select_arbitrary_trajectory, select_arbitrary_position, screening_top_k,
+                    sample_reachable
             );
         }
         if (name == "trajectory-smoothing") {
@@ -93,6 +98,27 @@ namespace SAOP {
         std::exit(1);
     }
 
+    shared_ptr<PlanConstructor> build_constructor(const json& conf) {
+        check_field_is_present(conf, "name");
+        const std::string& name = conf["name"];
+
+        if (name == "regret-insertion") {
+            const size_t regret_k = conf.find("regret_k") != conf.end() ? conf["regret_k"].get<size_t>() : 2;
+            const size_t max_candidates = conf.find("max_candidates") != conf.end() ?
+                                          conf["max_candidates"].get<size_t>() : 200;
+            const size_t max_insertions = conf.find("max_insertions") != conf.end() ?
+                                          conf["max_insertions"].get<size_t>() : 100;
+            const double max_time = conf.find("max_time") != conf.end() ? conf["max_time"].get<double>() : 2.;
+            const size_t num_threads = conf.find("num_threads") != conf.end() ?
+                                       conf["num_threads"].get<size_t>() : 0;
+            return make_shared<RegretInsertionConstructor>(regret_k, max_candidates, max_insertions, max_time,
+                                                           num_threads);
+        }
+
+        std::cerr << "Unrecognized plan constructor name: " << name << std::endl;
+        std::exit(1);
+    }
+
     shared_ptr<VariableNeighborhoodSearch> build_from_config(const std::string& json_config) {
         auto j = json::parse(json_config);
 
@@ -102,7 +128,19 @@ namespace SAOP {
             ns.push_back(build_neighborhood(it));
         }
 
-        return make_shared<VariableNeighborhoodSearch>(ns, make_shared<PlanPortionRemover>(0., 1.));
+        shared_ptr<VariableNeighborhoodSearch> vns;
+        if (j.find("evaluation_cache_size") != j.end()) {
+            const size_t evaluation_cache_size = j["evaluation_cache_size"];
+            vns = make_shared<VariableNeighborhoodSearch>(ns, make_shared<PlanPortionRemover>(0., 1.),
+                                                          evaluation_cache_size);
+        } else {
+            vns = make_shared<VariableNeighborhoodSearch>(ns, make_shared<PlanPortionRemover>(0., 1.));
+        }
+
+        if (j.find("initial_plan") != j.end()) {
+            vns->constructor = build_constructor(j["initial_plan"]);
+        }
+        return vns;
     }
 
     std::shared_ptr<VariableNeighborhoodSearch> build_default() {
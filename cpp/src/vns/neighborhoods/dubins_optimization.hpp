@@ -113,8 +113,8 @@ namespace SAOP {
                 const size_t seg_id = *opt_seg_id;
 
                 // pick an angle generator and generate a candidate angle
-                const shared_ptr<OrientationChangeGenerator> generator = generators[rand(0, generators.size())];
-                opt<double> optAngle = generator->get_orientation_change(traj, seg_id);
+                const OrientationChangeGenerator& generator = *generators[rand(0, generators.size())];
+                opt<double> optAngle = generator.get_orientation_change(traj, seg_id);
 
                 if (!optAngle)
                     continue; // generator not adapted to current segment, go to next trial
@@ -128,14 +128,11 @@ namespace SAOP {
 
                 // if the duration is improving and the utility doesn't get worse then return the move
                 if (local_duration_cost < -1) {
-                    unique_ptr<LocalMove> move = unique_ptr<SegmentRotation>(new SegmentRotation(plan, traj_id, seg_id, *optAngle));
-
-//                    PReversibleTrajectoriesUpdate rotation_update = unique_ptr<ReplaceSegmentUpdate>(
-//                            new ReplaceSegmentUpdate(traj_id, seg_id, replacement_segment));
-//                    unique_ptr<LocalMove> move = unique_ptr<UpdateBasedMove>(
-//                            new UpdateBasedMove(plan, std::move(rotation_update)));
-                    if (move->is_valid())
-                        return move;
+                    // rotation is applied with post-processing, as SegmentRotation does.
+                    // The candidate lives on the stack and is only turned into a LocalMove if it is kept.
+                    CandidateMove candidate(SegmentUpdate::replace(traj_id, seg_id, replacement_segment), true);
+                    if (candidate.evaluate(*plan).valid)
+                        return candidate.to_move(plan);
                 }
             }
             // we did not find any duration improving move
@@ -29,6 +29,37 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 namespace SAOP {
 
+    /** Accuracy of an approximate gain used to screen candidates, measured on the candidates evaluated exactly. */
+    struct ScreeningStats {
+        /** Number of candidates ranked with the approximate gain. */
+        size_t screened = 0;
+
+        /** Number of candidates evaluated exactly, for which the error is known. */
+        size_t evaluated = 0;
+
+        double sum_error = 0.;
+        double sum_abs_error = 0.;
+        double max_abs_error = 0.;
+
+        void record(double estimated_gain, double exact_gain) {
+            const double error = estimated_gain - exact_gain;
+            evaluated++;
+            sum_error += error;
+            sum_abs_error += std::abs(error);
+            max_abs_error = std::max(max_abs_error, std::abs(error));
+        }
+
+        json metadata() const {
+            json j;
+            j["screened"] = screened;
+            j["evaluated"] = evaluated;
+            j["mean_error"] = evaluated > 0 ? sum_error / evaluated : 0.;
+            j["mean_abs_error"] = evaluated > 0 ? sum_abs_error / evaluated : 0.;
+            j["max_abs_error"] = max_abs_error;
+            return j;
+        }
+    };
+
     /** Neighborhood for generating Insert moves.
      *
      * The neighborhood randomly picks a pending point in the visibility structures and returns
@@ -48,53 +79,140 @@ namespace SAOP {
         const bool select_arbitrary_trajectory;
         const bool select_arbitrary_position;
 
+        /** If non-zero, candidates are ranked with Plan::estimated_gain() and only the 'screening_top_k' best
+         * ones are evaluated exactly. */
+        const size_t screening_top_k;
+
+        /** If set, observations are picked among those that look reachable from a random leg of a random
+         * trajectory (see ObservationIndex::sample_reachable()) instead of among all possible observations.
+         * The observation is then only inserted on this leg. */
+        const bool sample_reachable;
+
         explicit OneInsertNbhd(double max_trials,
                                const bool select_arbitrary_trajectory,
-                               const bool select_arbitrary_position)
+                               const bool select_arbitrary_position,
+                               const size_t screening_top_k = 0,
+                               const bool sample_reachable = false)
                 : max_trials(max_trials),
                   select_arbitrary_trajectory(select_arbitrary_trajectory),
-                  select_arbitrary_position(select_arbitrary_position) {
+                  select_arbitrary_position(select_arbitrary_position),
+                  screening_top_k(screening_top_k),
+                  sample_reachable(sample_reachable) {
             BOOST_LOG_TRIVIAL(info) << "OneInsertNbhd is inserting waypoints at " << default_height
                                     << " above ground altitude";
         }
 
+        json metadata() const override {
+            json j;
+            j["trials"] = num_trials;
+            j["candidates"] = num_candidates;
+            j["acceptance_ratio"] = num_trials > 0 ? (double) num_candidates / num_trials : 0.;
+            j["sample_reachable"] = sample_reachable;
+            if (screening_top_k > 0) {
+                j["screening_top_k"] = screening_top_k;
+                j["screening"] = screening_stats.metadata();
+            }
+            return j;
+        }
+
+        void reset_metadata() override {
+            screening_stats = ScreeningStats();
+            num_trials = 0;
+            num_candidates = 0;
+        }
+
         unique_ptr<LocalMove> get_move(PlanPtr p) override {
-            UpdateBasedMove no_move(p, unique_ptr<EmptyUpdate>(new EmptyUpdate()));
-            unique_ptr<LocalMove> best = {};
+            if (screening_top_k > 0) {
+                return get_screened_move(p);
+            }
+
+            // candidates are kept by value and evaluated in place on the plan,
+            // only the selected one is turned into a LocalMove
+            const double no_move_utility = p->utility();
+            opt<CandidateMove> best = {};
 
             size_t num_tries = 0;
             while (num_tries++ < max_trials) {
-                unique_ptr<LocalMove> candidate_move = get_move_for_random_possible_observation(p);
+                opt<CandidateMove> candidate_move = get_move_for_random_possible_observation(p);
                 if (candidate_move) {
                     // a move was generated
+                    const PlanEvaluation& candidate_eval = candidate_move->evaluate(*p);
 
-                    if (!candidate_move->is_valid())
+                    if (!candidate_eval.valid)
                         // move is not valid, discard it
                         continue;
 
-                    if (!best && is_better_than(*candidate_move, no_move)) {
+                    if (!best && is_better_than(candidate_eval, no_move_utility)) {
                         // no best move, and better than doing nothing
-                        best = std::move(candidate_move);
-                    } else if (best && is_better_than(*candidate_move, *best)) {
+                        best = candidate_move;
+                    } else if (best && is_better_than(candidate_eval, best->evaluate(*p).utility)) {
                         // better than the best move
-                        best = std::move(candidate_move);
+                        best = candidate_move;
                     }
                 }
             }
-            return best;
+            return best ? best->to_move(p) : unique_ptr<LocalMove>();
         }
 
     private:
+        /** Candidates of the current get_screened_move() call with their estimated gain.
+         * Kept as a member to reuse its storage from one call to the other. */
+        std::vector<std::pair<double, CandidateMove>> screened_candidates;
+
+        ScreeningStats screening_stats;
+
+        /** Number of observations picked, and number of those that resulted in an insertion candidate */
+        size_t num_trials = 0;
+        size_t num_candidates = 0;
+
+        /** Same as get_move(), except that all candidates are generated first, ranked with the approximate gain
+         * and only the screening_top_k best are evaluated exactly. */
+        unique_ptr<LocalMove> get_screened_move(PlanPtr p) {
+            screened_candidates.clear();
+            size_t num_tries = 0;
+            while (num_tries++ < max_trials) {
+                opt<CandidateMove> candidate_move = get_move_for_random_possible_observation(p);
+                if (candidate_move) {
+                    screened_candidates.emplace_back(p->estimated_gain(candidate_move->update), *candidate_move);
+                }
+            }
+            screening_stats.screened += screened_candidates.size();
+
+            const size_t k = std::min(screening_top_k, screened_candidates.size());
+            std::partial_sort(screened_candidates.begin(), screened_candidates.begin() + k, screened_candidates.end(),
+                              [](const std::pair<double, CandidateMove>& a, const std::pair<double, CandidateMove>& b) {
+                                  return a.first > b.first;
+                              });
+
+            const double no_move_utility = p->utility();
+            opt<CandidateMove> best = {};
+            for (size_t i = 0; i < k; i++) {
+                CandidateMove& candidate_move = screened_candidates[i].second;
+                const PlanEvaluation& candidate_eval = candidate_move.evaluate(*p);
+                screening_stats.record(screened_candidates[i].first, no_move_utility - candidate_eval.utility);
+
+                if (!candidate_eval.valid)
+                    continue;
+
+                if (!best && is_better_than(candidate_eval, no_move_utility)) {
+                    best = candidate_move;
+                } else if (best && is_better_than(candidate_eval, best->evaluate(*p).utility)) {
+                    best = candidate_move;
+                }
+            }
+            return best ? best->to_move(p) : unique_ptr<LocalMove>();
+        }
+
         /** this move is better than another if it has a significantly better cost or if it has a similar cost but a strictly better duration */
-        bool is_better_than(LocalMove& first, LocalMove& other) {
+        bool is_better_than(const PlanEvaluation& first, double other_utility) {
 //            return localmove_efficiency(first) > localmove_efficiency(other) && (first.utility() + 1) < other.utility();
-            return ((first.utility() + 1) <
-                    other.utility());// || (abs(first.utility() - other.utility()) < 1 && (first.duration() < other.duration()));
+            return ((first.utility + 1) <
+                    other_utility);// || (abs(first.utility() - other.utility()) < 1 && (first.duration() < other.duration()));
         }
 
-        double localmove_efficiency(LocalMove& localmove) {
-            double delta_duration = localmove.duration() - localmove.base_plan->duration();
-            double delta_utility = -(localmove.utility() - localmove.base_plan->utility());
+        double localmove_efficiency(const PlanEvaluation& eval, const Plan& base) {
+            double delta_duration = eval.duration - base.duration();
+            double delta_utility = -(eval.utility - base.utility());
 
             if (delta_duration > 0 && delta_utility > 0) {
                 return delta_utility / delta_duration;
@@ -104,13 +222,34 @@ namespace SAOP {
         }
 
         /** Picks an observation randomly and generates a move that inserts it into the best looking location. */
-        unique_ptr<LocalMove> get_move_for_random_possible_observation(PlanPtr p) {
+        opt<CandidateMove> get_move_for_random_possible_observation(const PlanPtr& p) {
             ASSERT(!p->trajectories().empty());
             if (p->possible_observations.empty())
                 return {};
 
+            num_trials++;
+
             /** Select a random point in the pending list */
-            const size_t index = rand(0, p->possible_observations.size());
+            size_t index;
+            // trajectory and insertion location the point was sampled for, if any
+            opt<size_t> sampled_traj = {};
+            opt<size_t> sampled_loc = {};
+            if (sample_reachable) {
+                const size_t t = rand(0, p->trajectories().size());
+                const opt<size_t> loc = p->trajectories()[t].random_insertion_id();
+                const opt<size_t> reachable = loc ?
+                                              p->observation_index().sample_reachable(p->possible_observations,
+                                                                                      p->trajectories()[t], *loc) :
+                                              opt<size_t>{};
+                if (!reachable) {
+                    return {};
+                }
+                index = *reachable;
+                sampled_traj = t;
+                sampled_loc = loc;
+            } else {
+                index = rand(0, p->possible_observations.size());
+            }
             const PointTimeWindow pt = p->possible_observations[index];
 
             /** Pick an angle randomly */
@@ -136,7 +275,11 @@ namespace SAOP {
             Segment3d projected_random_observation = random_observation;
 
             size_t first_traj, last_traj;
-            if (select_arbitrary_trajectory) {
+            if (sampled_traj) {
+                // only the trajectory the observation looks reachable from
+                first_traj = *sampled_traj;
+                last_traj = *sampled_traj;
+            } else if (select_arbitrary_trajectory) {
                 const size_t t = rand(0, p->trajectories().size());
                 first_traj = t;
                 last_traj = t;
@@ -162,7 +305,11 @@ namespace SAOP {
                                                                                            traj.start_time());
 
                 size_t first_insertion_loc, last_insertion_loc;
-                if (select_arbitrary_position) {
+                if (sampled_loc) {
+                    // only the leg the observation looks reachable from
+                    first_insertion_loc = *sampled_loc;
+                    last_insertion_loc = *sampled_loc;
+                } else if (select_arbitrary_position) {
                     const opt<size_t> loc = traj.random_insertion_id();
                     if (loc) {
                         first_insertion_loc = *loc;
@@ -210,9 +357,10 @@ namespace SAOP {
 
             /** Return the best, if any */
             if (best) {
+                num_candidates++;
 //                return unique_ptr<UpdateBasedMove>(new UpdateBasedMove(p, unique_ptr<InsertSegmentUpdate>(
 //                        new InsertSegmentUpdate(best->traj_id, best->segment, best->insert_loc))));
-                return unique_ptr<Insert>(new Insert(p, best->traj_id, best->segment, best->insert_loc));
+                return CandidateMove(SegmentUpdate::insert(best->traj_id, best->segment, best->insert_loc));
             } else {
                 return {};
             };
@@ -151,6 +151,65 @@ namespace SAOP {
         }
     };
 
+/** A candidate move held by value: an update on the trajectories and its lazily computed evaluation.
+ *
+ * Neighborhoods generate and discard many candidates before picking one. Keeping them as values (on the stack
+ * or in a buffer reused across calls) means that only the selected candidate is turned into a heap-allocated
+ * LocalMove, through to_move(). */
+    struct CandidateMove {
+        SegmentUpdate update;
+
+        /** If set, the plan is post-processed (projection on firefront, smoothing) after the update. */
+        bool post_process;
+
+        explicit CandidateMove(const SegmentUpdate& update, bool post_process = false)
+                : update(update), post_process(post_process) {}
+
+        /** Evaluates the candidate on the given plan. The plan is left untouched. */
+        const PlanEvaluation& evaluate(Plan& p) {
+            if (!evaluation) {
+                evaluation = p.evaluate(update, post_process);
+            }
+            return *evaluation;
+        }
+
+        /** Builds a LocalMove applying this candidate on the given plan, reusing the evaluation if already done. */
+        unique_ptr<LocalMove> to_move(PlanPtr base);
+
+    private:
+        opt<PlanEvaluation> evaluation;
+    };
+
+/** LocalMove applying a value-type update whose outcome was evaluated beforehand. */
+    struct EvaluatedUpdateMove final : public LocalMove {
+        EvaluatedUpdateMove(PlanPtr base, const SegmentUpdate& update, bool post_process,
+                            const PlanEvaluation& evaluation)
+                : LocalMove(std::move(base)), update(update), post_process(post_process), evaluation(evaluation) {}
+
+        /** Cost that would result in applying the move. */
+        double utility() override { return evaluation.utility; };
+
+        /** Total duration that would result in applying the move */
+        double duration() override { return evaluation.duration; };
+
+        bool is_valid() override { return evaluation.valid; }
+
+    protected:
+        void apply_on(PlanPtr target) override {
+            target->update(update, post_process);
+        }
+
+    private:
+        const SegmentUpdate update;
+        const bool post_process;
+        const PlanEvaluation evaluation;
+    };
+
+    inline unique_ptr<LocalMove> CandidateMove::to_move(PlanPtr base) {
+        const PlanEvaluation& eval = evaluate(*base);
+        return unique_ptr<LocalMove>(new EvaluatedUpdateMove(std::move(base), update, post_process, eval));
+    }
+
 /** Local move that insert a segment at given place in the plan. */
     struct Insert final : public CloneBasedLocalMove {
         /** Index of the trajectory in which to perform the insertion. */
@@ -0,0 +1,223 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_OBSERVATION_INDEX_H
+#define PLANNING_CPP_OBSERVATION_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "../core/trajectory.hpp"
+#include "../core/waypoint.hpp"
+#include "../ext/optional.hpp"
+#include "../utils.hpp"
+
+namespace SAOP {
+
+    /** Spatio-temporal index over a set of possible observations.
+     *
+     * Observations are bucketed in a regular grid. Each bucket keeps the time span covered by the time windows of
+     * its observations, so that buckets that cannot match a time constraint are skipped as a whole.
+     * The index only keeps the positions of the observations in the indexed vector: queries must be given
+     * the same vector as the constructor. */
+    class ObservationIndex {
+    public:
+        ObservationIndex(const std::vector<PointTimeWindow>& observations, double bucket_size)
+                : num_observations(observations.size()), bucket_size(bucket_size) {
+            ASSERT(bucket_size > 0);
+            if (observations.empty()) {
+                return;
+            }
+            min_x = std::numeric_limits<double>::infinity();
+            min_y = std::numeric_limits<double>::infinity();
+            double max_x = -std::numeric_limits<double>::infinity();
+            double max_y = -std::numeric_limits<double>::infinity();
+            for (const auto& o : observations) {
+                min_x = std::min(min_x, o.pt.x);
+                min_y = std::min(min_y, o.pt.y);
+                max_x = std::max(max_x, o.pt.x);
+                max_y = std::max(max_y, o.pt.y);
+            }
+            x_buckets = (size_t) std::floor((max_x - min_x) / bucket_size) + 1;
+            y_buckets = (size_t) std::floor((max_y - min_y) / bucket_size) + 1;
+            buckets = std::vector<Bucket>(x_buckets * y_buckets);
+
+            for (size_t i = 0; i < observations.size(); i++) {
+                Bucket& b = buckets[bucket_x(observations[i].pt.x) + bucket_y(observations[i].pt.y) * x_buckets];
+                b.ids.push_back(i);
+                b.earliest = std::min(b.earliest, observations[i].tw.start);
+                b.latest = std::max(b.latest, observations[i].tw.end);
+                latest = std::max(latest, observations[i].tw.end);
+            }
+        }
+
+        size_t size() const { return num_observations; }
+
+        /** Picks uniformly at random an observation that might be made by a detour of the UAV on the leg
+         * between the segments 'insert_loc - 1' and 'insert_loc' of the trajectory.
+         *
+         * The bound is optimistic: the UAV flies straight at max air speed, and the detour is bounded by the
+         * flight time left in the trajectory (an ellipse around the leg). The observation window must intersect
+         * the range of times at which the UAV could be there, which also bounds the detour by the end of the
+         * latest observation window.
+         *
+         * Buckets that may hold a reachable observation are picked with a probability proportional to their
+         * number of observations, and observations are drawn in them until a reachable one is found. Only the
+         * drawn observations are checked, so that the cost of a sample does not grow with the size of the area
+         * in range. Returns the index of the observation in the indexed vector, or an empty option if none
+         * was found after 'max_draws' draws. */
+        opt<size_t> sample_reachable(const std::vector<PointTimeWindow>& observations, const Trajectory& traj,
+                                     size_t insert_loc, size_t max_draws = 64) const {
+            ASSERT(observations.size() == num_observations);
+            if (observations.empty() || insert_loc == 0 || insert_loc > traj.size()) {
+                return {};
+            }
+            const double speed = traj.conf().uav.max_air_speed();
+            const double slack = traj.conf().max_flight_time - traj.duration();
+            if (slack <= 0) {
+                return {};
+            }
+
+            const Position from = traj.segment(insert_loc - 1).end.as_point().as_2d();
+            const double departure = traj.end_time(insert_loc - 1);
+            if (departure > latest) {
+                return {};
+            }
+
+            // with no next segment, the UAV can go anywhere in the range of the remaining flight time
+            const bool has_next = insert_loc < traj.size();
+            const Position to = has_next ? traj.segment(insert_loc).start.as_point().as_2d() : from;
+            const double leg_length = has_next ? from.dist(to) : 0.;
+            const double max_path = leg_length + slack * speed;
+            // no observation can be made after the end of the latest time window
+            const double max_dist_from = std::min(max_path, (latest - departure) * speed);
+
+            // bounding box of the ellipse of foci 'from' and 'to', intersected with the disk reachable in time
+            const double cx = (from.x + to.x) / 2;
+            const double cy = (from.y + to.y) / 2;
+            const double half_extent = has_next ? max_path / 2 : max_path;
+            const size_t bx_min = bucket_x(std::max(cx - half_extent, from.x - max_dist_from));
+            const size_t bx_max = bucket_x(std::min(cx + half_extent, from.x + max_dist_from));
+            const size_t by_min = bucket_y(std::max(cy - half_extent, from.y - max_dist_from));
+            const size_t by_max = bucket_y(std::min(cy + half_extent, from.y + max_dist_from));
+
+            // buckets that may hold a reachable observation, with the cumulated number of observations
+            std::vector<size_t> candidates;
+            std::vector<size_t> cumulated_sizes;
+            size_t total = 0;
+            for (size_t by = by_min; by <= by_max; by++) {
+                for (size_t bx = bx_min; bx <= bx_max; bx++) {
+                    const Bucket& b = buckets[bx + by * x_buckets];
+                    if (b.ids.empty()) {
+                        continue;
+                    }
+                    const double d_from = dist_to_bucket(from, bx, by);
+                    const double path = has_next ? d_from + dist_to_bucket(to, bx, by) : d_from;
+                    if (path > max_path || b.latest < departure + d_from / speed ||
+                        b.earliest > departure + max_path / speed) {
+                        continue;
+                    }
+                    candidates.push_back(bx + by * x_buckets);
+                    total += b.ids.size();
+                    cumulated_sizes.push_back(total);
+                }
+            }
+            if (total == 0) {
+                return {};
+            }
+
+            // rejection sampling: each draw is uniform among the observations of the candidate buckets,
+            // hence an accepted one is uniform among the reachable observations
+            for (size_t draw = 0; draw < max_draws; draw++) {
+                const size_t r = rand(0, total);
+                const size_t c = (size_t) (std::upper_bound(cumulated_sizes.begin(), cumulated_sizes.end(), r) -
+                                           cumulated_sizes.begin());
+                const Bucket& b = buckets[candidates[c]];
+                const size_t id = b.ids[r - (c == 0 ? 0 : cumulated_sizes[c - 1])];
+
+                const PointTimeWindow& o = observations[id];
+                const double d_from = from.dist(o.pt);
+                const double path = has_next ? d_from + o.pt.dist(to) : d_from;
+                if (path > max_path) {
+                    continue;
+                }
+                // earliest arrival is by flying straight there, latest by using all the slack before
+                const double earliest = departure + d_from / speed;
+                const double latest_arrival = departure + (max_path - (path - d_from)) / speed;
+                if (o.tw.end < earliest || o.tw.start > latest_arrival) {
+                    continue;
+                }
+                return id;
+            }
+            return {};
+        }
+
+    private:
+        struct Bucket {
+            std::vector<size_t> ids;
+            double earliest = std::numeric_limits<double>::infinity();
+            double latest = -std::numeric_limits<double>::infinity();
+        };
+
+        const size_t num_observations;
+        const double bucket_size;
+
+        double min_x = 0;
+        double min_y = 0;
+        /** End of the latest time window of the indexed observations */
+        double latest = -std::numeric_limits<double>::infinity();
+        size_t x_buckets = 0;
+        size_t y_buckets = 0;
+        std::vector<Bucket> buckets;
+
+        /** Bucket coordinate of the given position, clamped in the grid */
+        size_t bucket_x(double x) const {
+            return clamped((x - min_x) / bucket_size, x_buckets);
+        }
+
+        size_t bucket_y(double y) const {
+            return clamped((y - min_y) / bucket_size, y_buckets);
+        }
+
+        /** Distance from a position to the area covered by a bucket (zero if inside) */
+        double dist_to_bucket(const Position& pos, size_t bx, size_t by) const {
+            const double x_lo = min_x + bx * bucket_size;
+            const double y_lo = min_y + by * bucket_size;
+            const double dx = std::max(0., std::max(x_lo - pos.x, pos.x - (x_lo + bucket_size)));
+            const double dy = std::max(0., std::max(y_lo - pos.y, pos.y - (y_lo + bucket_size)));
+            return std::sqrt(dx * dx + dy * dy);
+        }
+
+        static size_t clamped(double coord, size_t num_buckets) {
+            if (coord <= 0 || num_buckets == 0) {
+                return 0;
+            }
+            return std::min((size_t) std::floor(coord), num_buckets - 1);
+        }
+    };
+}
+
+#endif //PLANNING_CPP_OBSERVATION_INDEX_H
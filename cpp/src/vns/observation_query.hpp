@@ -0,0 +1,203 @@
+/* Copyright (c) 2017-2019, CNRS-LAAS
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef PLANNING_CPP_OBSERVATION_QUERY_HPP
+#define PLANNING_CPP_OBSERVATION_QUERY_HPP
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+#include "../core/fire_data.hpp"
+#include "../core/raster.hpp"
+#include "../core/trajectories.hpp"
+#include "../ext/ThreadPool.hpp"
+
+namespace SAOP {
+
+    /** Cells observed by a plan, each with an observation time.
+     * Cells are given by their index in the rasters of the fire data (x + y * x_width).
+     * Compact observations (see ObservationQuery) are sorted by cell, each cell with the time of its first
+     * observation. Otherwise, they are in the order of the trajectories and segments, and a cell appears each
+     * time it is observed. */
+    struct CellObservations {
+        std::vector<size_t> cells;
+        std::vector<double> times;
+
+        size_t size() const { return cells.size(); }
+
+        /** Observations as positions of the cell centers in the given raster. */
+        template<typename GenRaster>
+        std::vector<PositionTime> as_positions(const GenRaster& raster) const {
+            std::vector<PositionTime> positions;
+            positions.reserve(cells.size());
+            for (size_t i = 0; i < cells.size(); i++) {
+                positions.emplace_back(raster.as_position(Cell{cells[i] % raster.x_width, cells[i] / raster.x_width}),
+                                       times[i]);
+            }
+            return positions;
+        }
+    };
+
+    /** Stateless computation of the cells observed by trajectories.
+     *
+     * Footprints are traced with RasterMapper::segment_trace and gathered as (cell, time) pairs, without
+     * allocating any raster. If a thread pool is given, trajectories are processed in parallel on it.
+     * If 'compact', each cell is reported once (see CellObservations). */
+    class ObservationQuery {
+    public:
+        /** Cells traced by the segments of the trajectories that are entirely within the time window.
+         * If 'only_burning', only cells burning at the start of the segment are kept.
+         * The observation time of a cell is the start time of the first segment observing it. */
+        static CellObservations segment_observations(const Trajectories& trajs, const FireData& fire,
+                                                     const TimeWindow& tw, bool only_burning, bool compact = true,
+                                                     ThreadPool* pool = nullptr) {
+            return for_each_trajectory(trajs, compact, pool, [&fire, &tw, only_burning](const Trajectory& traj,
+                                                                                      std::vector<Observation>& obs) {
+                const UAV& drone = traj.conf().uav;
+                for (size_t seg_id = 0; seg_id < traj.size(); seg_id++) {
+                    const double obs_time = traj.start_time(seg_id);
+                    if (!tw.contains(TimeWindow{obs_time, traj.end_time(seg_id)})) {
+                        continue;
+                    }
+                    opt<std::vector<Cell>> cells = RasterMapper::segment_trace(
+                            traj[seg_id].maneuver, drone.view_depth(), drone.view_width(), fire.ignitions);
+                    if (!cells) {
+                        continue;
+                    }
+                    for (const auto& c : *cells) {
+                        if (!only_burning ||
+                            (fire.ignitions(c) <= obs_time && obs_time <= fire.traversal_end(c))) {
+                            obs.push_back(Observation{c.x + c.y * fire.ignitions.x_width, obs_time});
+                        }
+                    }
+                }
+            });
+        }
+
+        /** Cells seen burning from the trajectories sampled every 'step' meters, as
+         * GhostFireMapper::observed_fire_locations. The time associated to each cell is its ignition time. */
+        static CellObservations sampled_fire_observations(const Trajectories& trajs, const FireData& fire,
+                                                          double step, bool compact = true,
+                                                          ThreadPool* pool = nullptr) {
+            return for_each_trajectory(trajs, compact, pool, [&fire, step](const Trajectory& traj,
+                                                                         std::vector<Observation>& obs) {
+                const UAV& uav = traj.conf().uav;
+                const auto wp_and_t = traj.sampled_with_time(step);
+                const std::vector<Waypoint3d>& wps = wp_and_t.first;
+                const std::vector<double>& times = wp_and_t.second;
+                for (size_t i = 0; i + 1 < wps.size(); i++) {
+                    if (uav.is_turning(wps[i], wps[i + 1])) {
+                        continue;
+                    }
+                    opt<std::vector<Cell>> cells = RasterMapper::segment_trace(
+                            Segment3d{wps[i], wps[i].forward(1.)}, uav.view_width(), uav.view_depth(),
+                            fire.ignitions);
+                    if (!cells) {
+                        continue;
+                    }
+                    for (const auto& c : *cells) {
+                        if (TimeWindow{fire.ignitions(c), fire.traversal_end(c)}.contains(times[i])) {
+                            obs.push_back(Observation{c.x + c.y * fire.ignitions.x_width, fire.ignitions(c)});
+                        }
+                    }
+                }
+            });
+        }
+
+    private:
+        struct Observation {
+            size_t cell;
+            double time;
+
+            bool operator<(const Observation& o) const {
+                return cell < o.cell || (cell == o.cell && time < o.time);
+            }
+        };
+
+        /** Keeps the first observation of each cell. */
+        static void sort_unique(std::vector<Observation>& obs) {
+            std::sort(obs.begin(), obs.end());
+            obs.erase(std::unique(obs.begin(), obs.end(), [](const Observation& a, const Observation& b) {
+                return a.cell == b.cell;
+            }), obs.end());
+        }
+
+        /** Gathers the observations of each trajectory, computed by 'observe(trajectory, observations)'. */
+        template<typename F>
+        static CellObservations for_each_trajectory(const Trajectories& trajs, bool compact, ThreadPool* pool,
+                                                    F observe) {
+            const size_t n = trajs.size();
+            std::vector<std::vector<Observation>> per_traj(n);
+            auto process = [&trajs, &per_traj, &observe, compact](size_t i) {
+                observe(trajs[i], per_traj[i]);
+                if (compact) {
+                    sort_unique(per_traj[i]);
+                }
+            };
+
+            if (!pool || n <= 1) {
+                for (size_t i = 0; i < n; i++) {
+                    process(i);
+                }
+            } else {
+                std::vector<std::future<void>> tasks;
+                for (size_t i = 0; i < n; i++) {
+                    tasks.push_back(pool->enqueue(process, i));
+                }
+                for (auto& task : tasks) {
+                    task.get();
+                }
+            }
+
+            std::vector<Observation> all;
+            if (n == 1) {
+                all = std::move(per_traj[0]);
+            } else {
+                size_t total = 0;
+                for (const auto& obs : per_traj) {
+                    total += obs.size();
+                }
+                all.reserve(total);
+                for (const auto& obs : per_traj) {
+                    all.insert(all.end(), obs.begin(), obs.end());
+                }
+                if (compact) {
+                    sort_unique(all);
+                }
+            }
+
+            CellObservations result;
+            result.cells.reserve(all.size());
+            result.times.reserve(all.size());
+            for (const Observation& o : all) {
+                result.cells.push_back(o.cell);
+                result.times.push_back(o.time);
+            }
+            return result;
+        }
+    };
+}
+
+#endif //PLANNING_CPP_OBSERVATION_QUERY_HPP
@@ -58,6 +58,20 @@ namespace SAOP {
             ASSERT(t.conf().start_time >= time_window.start && t.conf().start_time <= time_window.end);
         }
 
+        compute_possible_observations();
+        u_map.reset();
+    }
+
+    void Plan::firedata(shared_ptr<FireData> fdata) {
+        fire_data = std::move(fdata);
+        compute_possible_observations();
+        u_map.reset(fire_data);
+        // cached evaluations were made with the previous fire data
+        eval_cache.reset();
+    }
+
+    void Plan::compute_possible_observations() {
+        possible_observations.clear();
         std::vector<Cell> obs_prev_cells;
         obs_prev_cells.reserve(observed_previously.size());
         std::transform(observed_previously.begin(), observed_previously.end(),
@@ -80,8 +94,16 @@ namespace SAOP {
                 }
             }
         }
+        obs_index = make_shared<LazyObservationIndex>();
+    }
 
-        u_map.reset(trajs);
+    const ObservationIndex& Plan::observation_index() const {
+        std::call_once(obs_index->built, [this]() {
+            // buckets of 16x16 cells
+            obs_index->index.reset(new ObservationIndex(possible_observations,
+                                                        16 * fire_data->ignitions.cell_width));
+        });
+        return *obs_index->index;
     }
 
     json Plan::metadata() {
@@ -98,68 +120,27 @@ namespace SAOP {
     }
 
     vector<PositionTime> Plan::observations_full() const {
-        std::vector<PositionTime> result = {};
-        for (const auto& tr: trajs) {
-            GhostFireMapper<double> gfm = GhostFireMapper<double>(fire_data);
-            auto wp_and_t = tr.sampled_with_time(50);
-            auto obs = gfm.observed_fire_locations(std::get<0>(wp_and_t), std::get<1>(wp_and_t), tr.conf().uav);
-            result.insert(result.end(), obs.begin(), obs.end());
-        }
-        return result;
+        return ObservationQuery::sampled_fire_observations(trajs, *fire_data, 50, false, pool.get())
+                .as_positions(fire_data->ignitions);
+    }
+
+    CellObservations Plan::observed_cells(const TimeWindow& tw) const {
+        return ObservationQuery::segment_observations(trajs, *fire_data, tw, true, true, pool.get());
     }
 
     vector<PositionTime> Plan::observations(const TimeWindow& tw) const {
         vector<PositionTime> obs = std::vector<PositionTime>(observed_previously);
-        for (const auto& traj : trajs) {
-            UAV drone = traj.conf().uav;
-            for (size_t seg_id = 0; seg_id < traj.size(); seg_id++) {
-                const Segment3d& seg = traj[seg_id].maneuver;
-
-                double obs_time = traj.start_time(seg_id);
-                double obs_end_time = traj.end_time(seg_id);
-                TimeWindow seg_tw = TimeWindow{obs_time, obs_end_time};
-                if (tw.contains(seg_tw)) {
-                    opt<std::vector<Cell>> opt_cells = segment_trace(seg, drone.view_depth(), drone.view_width(),
-                                                                     fire_data->ignitions);
-                    if (opt_cells) {
-                        for (const auto& c : *opt_cells) {
-                            if (fire_data->ignitions(c) <= obs_time && obs_time <= fire_data->traversal_end(c)) {
-                                // If the cell is observable, add it to the observations list
-                                obs.push_back(
-                                        PositionTime{fire_data->ignitions.as_position(c), traj.start_time(seg_id)});
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        const vector<PositionTime> new_obs =
+                ObservationQuery::segment_observations(trajs, *fire_data, tw, true, false, pool.get())
+                        .as_positions(fire_data->ignitions);
+        obs.insert(obs.end(), new_obs.begin(), new_obs.end());
         return obs;
     }
 
     /*All the positions observed by the UAV camera*/
     vector<PositionTime> Plan::view_trace(const TimeWindow& tw) const {
-        vector<PositionTime> obs = {};
-        for (const auto& traj : trajs) {
-            UAV drone = traj.conf().uav;
-            for (size_t seg_id = 0; seg_id < traj.size(); seg_id++) {
-                const Segment3d& seg = traj[seg_id].maneuver;
-
-                double obs_time = traj.start_time(seg_id);
-                double obs_end_time = traj.end_time(seg_id);
-                TimeWindow seg_tw = TimeWindow{obs_time, obs_end_time};
-                if (tw.contains(seg_tw)) {
-                    opt<std::vector<Cell>> opt_cells = segment_trace(seg, drone.view_depth(), drone.view_width(),
-                                                                     fire_data->ignitions);
-                    if (opt_cells) {
-                        for (const auto& c : *opt_cells) {
-                            obs.emplace_back(
-                                    PositionTime{fire_data->ignitions.as_position(c), traj.start_time(seg_id)});
-                        }
-                    }
-                }
-            }
-        }
-        return obs;
+        return ObservationQuery::segment_observations(trajs, *fire_data, tw, false, false, pool.get())
+                .as_positions(fire_data->ignitions);
     }
 
     void Plan::insert_segment(size_t traj_id, const Segment3d& seg, size_t insert_loc, bool do_post_processing) {
@@ -169,7 +150,7 @@ namespace SAOP {
         if (do_post_processing) {
             post_process();
         }
-        u_map.reset(trajs);
+        u_map.reset();
     }
 
     void Plan::erase_segment(size_t traj_id, size_t at_index, bool do_post_processing) {
@@ -179,12 +160,12 @@ namespace SAOP {
         if (do_post_processing) {
             post_process();
         }
-        u_map.reset(trajs);
+        u_map.reset();
     }
 
     void Plan::replace_segment(size_t traj_id, size_t at_index, const Segment3d& by_segment) {
         replace_segment(traj_id, at_index, 1, std::vector<Segment3d>({by_segment}));
-        u_map.reset(trajs);
+        u_map.reset();
     }
 
     void
@@ -203,38 +184,92 @@ namespace SAOP {
         }
 
         post_process();
-        u_map.reset(trajs);
+        u_map.reset();
     }
 
-    void Plan::project_on_fire_front() {
-        for (auto& traj : trajs) {
-            size_t seg_id = traj.first_modifiable_maneuver();
-            while (seg_id <= traj.last_modifiable_maneuver()) {
-                const Segment3d& seg = traj[seg_id].maneuver;
-                const double t = traj.start_time(seg_id);
-                opt<Segment3d> projected = fire_data->project_on_firefront(seg, traj.conf().uav, t);
-                if (projected) {
-                    if (*projected != seg) {
-                        // original is different than projection, replace it
-                        traj.replace_segment(seg_id, *projected);
-                        u_map.reset(trajs);
-                    }
-                    seg_id++;
-                } else {
-                    // segment has no projection, remove it
-                    if (traj.can_modify(seg_id)) {
-                        traj.erase_segment(seg_id);
-                        u_map.reset(trajs);
+    void Plan::post_process_update(const SegmentUpdate& u, std::vector<SegmentUpdate>* undo) {
+        const SegmentUpdate rev = u.apply(trajs);
+        if (undo) {
+            undo->push_back(rev);
+        }
+        u_map.reset();
+    }
+
+    void Plan::project_on_fire_front(std::vector<SegmentUpdate>* undo) {
+        // Project all segments at once with their current start times.
+        // Replacing or removing a segment changes the start time of the following ones of its trajectory, whose
+        // projections are discarded. They are projected again in a new batch, along with the ones of the other
+        // modified trajectories. When the plan is already mostly on the fire front (e.g. after a local move)
+        // a single batch is enough.
+
+        // first segment of each trajectory that is still to be projected, if any
+        std::vector<opt<size_t>> next_seg(trajs.size());
+        for (size_t traj_id = 0; traj_id < trajs.size(); traj_id++) {
+            if (trajs[traj_id].first_modifiable_maneuver() <= trajs[traj_id].last_modifiable_maneuver()) {
+                next_seg[traj_id] = trajs[traj_id].first_modifiable_maneuver();
+            }
+        }
+
+        while (true) {
+            std::vector<FrontProjectionQuery> queries;
+            // index of the query of the first segment to project in each trajectory
+            std::vector<size_t> first_query(trajs.size());
+            for (size_t traj_id = 0; traj_id < trajs.size(); traj_id++) {
+                first_query[traj_id] = queries.size();
+                if (!next_seg[traj_id]) {
+                    continue;
+                }
+                const Trajectory& traj = trajs[traj_id];
+                for (size_t seg_id = *next_seg[traj_id]; seg_id <= traj.last_modifiable_maneuver(); seg_id++) {
+                    queries.push_back({&traj.conf().uav, traj[seg_id].maneuver, traj.start_time(seg_id)});
+                }
+            }
+            if (queries.empty()) {
+                return;
+            }
+            const std::vector<opt<Segment3d>> batch = fire_data->project_on_firefront(queries, pool.get());
+
+            for (size_t traj_id = 0; traj_id < trajs.size(); traj_id++) {
+                if (!next_seg[traj_id]) {
+                    continue;
+                }
+                const Trajectory& traj = trajs[traj_id];
+                size_t seg_id = *next_seg[traj_id];
+                size_t query_id = first_query[traj_id];
+                next_seg[traj_id] = {};
+                // stop at the first change, the projections of the following segments are outdated
+                while (seg_id <= traj.last_modifiable_maneuver()) {
+                    const Segment3d& seg = traj[seg_id].maneuver;
+                    ASSERT(query_id < queries.size() && queries[query_id].segment == seg);
+                    const opt<Segment3d>& projected = batch[query_id];
+                    query_id++;
+                    if (projected) {
+                        if (*projected != seg) {
+                            // original is different than projection, replace it
+                            post_process_update(SegmentUpdate::replace(traj_id, seg_id, *projected), undo);
+                            next_seg[traj_id] = seg_id + 1;
+                            break;
+                        }
+                        seg_id++;
+                    } else if (traj.can_modify(seg_id)) {
+                        // segment has no projection, remove it
+                        post_process_update(SegmentUpdate::erase(traj_id, seg_id), undo);
+                        next_seg[traj_id] = seg_id;
+                        break;
                     } else {
                         seg_id++;
                     }
                 }
+                if (next_seg[traj_id] && *next_seg[traj_id] > traj.last_modifiable_maneuver()) {
+                    next_seg[traj_id] = {};
+                }
             }
         }
     }
 
-    void Plan::smooth_trajectory() {
-        for (auto& traj : trajs) {
+    void Plan::smooth_trajectory(std::vector<SegmentUpdate>* undo) {
+        for (size_t traj_id = 0; traj_id < trajs.size(); traj_id++) {
+            const Trajectory& traj = trajs[traj_id];
             size_t seg_id = traj.first_modifiable_maneuver();
             while (seg_id < traj.last_modifiable_maneuver()) {
                 const Segment3d& current = traj[seg_id].maneuver;
@@ -245,8 +280,7 @@ namespace SAOP {
 
                 if (dubins_dist_to_next / euclidian_dist_to_next > 2.) {
                     // tight loop, erase next and stay on this segment to check for tight loops on the new next.
-                    traj.erase_segment(seg_id + 1);
-                    u_map.reset(trajs);
+                    post_process_update(SegmentUpdate::erase(traj_id, seg_id + 1), undo);
                 } else {
                     // no loop detected, go to next
                     seg_id++;
@@ -261,10 +295,78 @@ namespace SAOP {
         if (do_post_processing) {
             post_process();
         }
-        u_map.reset(trajs);
+        u_map.reset();
+        return rev;
+    }
+
+    SegmentUpdate Plan::update(const SegmentUpdate& u, bool do_post_processing) {
+        SegmentUpdate rev = u.apply(trajs);
+        if (do_post_processing) {
+            post_process();
+        }
+        u_map.reset();
         return rev;
     }
 
+    PlanEvaluation Plan::evaluate(const SegmentUpdate& u, bool do_post_processing) {
+        Utility::CachedState current = u_map.take_cached_state();
+        const SegmentUpdate rev = u.apply(trajs);
+        // changes made by post-processing, to be reverted in reverse order
+        std::vector<SegmentUpdate> post_processing_rev;
+        if (do_post_processing) {
+            project_on_fire_front(&post_processing_rev);
+            smooth_trajectory(&post_processing_rev);
+        }
+
+        // the trajectories hash is updated along with the trajectories,
+        // look it up before computing the utility map
+        opt<PlanEvaluation> eval = cached_evaluation();
+        if (!eval) {
+            eval = compute_evaluation();
+        }
+
+        for (auto it = post_processing_rev.rbegin(); it != post_processing_rev.rend(); ++it) {
+            it->apply(trajs);
+        }
+        rev.apply(trajs);
+        u_map.restore_cached_state(std::move(current));
+        return *eval;
+    }
+
+    double Plan::estimated_gain(const SegmentUpdate& u, size_t stride) const {
+        if (u.kind != SegmentUpdate::Kind::Insert && u.kind != SegmentUpdate::Kind::Replace) {
+            return 0.;
+        }
+        ASSERT(u.traj_id < trajs.size());
+        const Trajectory& traj = trajs[u.traj_id];
+        const TrajectoryConfig& conf = traj.conf();
+
+        // time at which the UAV would reach the segment
+        double time;
+        if (u.at_index == 0) {
+            time = traj.start_time();
+        } else {
+            time = traj.end_time(u.at_index - 1) +
+                   conf.uav.travel_time(traj.segment(u.at_index - 1).end, u.seg.start, conf.wind);
+        }
+        return u_map.estimated_gain(trajs, u.seg, conf.uav.view_width(), conf.uav.view_depth(), time, stride);
+    }
+
+    opt<PlanEvaluation> Plan::cached_evaluation() {
+        if (!eval_cache) {
+            return {};
+        }
+        return eval_cache->find(trajs.hash(), duration(), num_segments());
+    }
+
+    PlanEvaluation Plan::compute_evaluation() {
+        const PlanEvaluation eval{u_map.utility(trajs), duration(), num_segments(), is_valid()};
+        if (eval_cache) {
+            eval_cache->store(trajs.hash(), eval);
+        }
+        return eval;
+    }
+
     void Plan::freeze_before(double time) {
         trajs.freeze_before(time);
     }
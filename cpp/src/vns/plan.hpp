@@ -26,9 +26,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #define PLANNING_CPP_PLAN_H
 
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <stack>
 
+#include "evaluation_cache.hpp"
+#include "observation_index.hpp"
+#include "observation_query.hpp"
 #include "utility.hpp"
 #include "../core/trajectory.hpp"
 #include "../core/fire_data.hpp"
@@ -100,10 +104,33 @@ namespace SAOP {
             return *fire_data;
         }
 
-        /* Replace plan firedata */
-        void firedata(shared_ptr<FireData> fdata) {
-            fire_data = std::move(fdata);
-            u_map.reset(trajs);
+        /** Spatio-temporal index over possible_observations, built on first use and shared by the copies of the
+         * plan. Queries must be given possible_observations. */
+        const ObservationIndex& observation_index() const;
+
+        /* Replace plan firedata, e.g., by one obtained with FireData::updated().
+         * Possible observations and the utility are recomputed from the new fire data. */
+        void firedata(shared_ptr<FireData> fdata);
+
+        /* Cache of evaluations to consult before computing the utility of a plan.
+         * It is shared by all copies of this plan and may be null. It is not thread safe (see utility() and evaluate()). */
+        shared_ptr<EvaluationCache> evaluation_cache() const {
+            return eval_cache;
+        }
+
+        void evaluation_cache(shared_ptr<EvaluationCache> cache) {
+            eval_cache = std::move(cache);
+        }
+
+        /* Thread pool on which batches of projections on the fire front (see project_on_fire_front()) and queries
+         * of the observed cells are split. It is shared by all copies of this plan and may be null, in which case
+         * they are made on the calling thread. The plan must not be used from a task of this pool. */
+        shared_ptr<ThreadPool> thread_pool() const {
+            return pool;
+        }
+
+        void thread_pool(shared_ptr<ThreadPool> thread_pool) {
+            pool = std::move(thread_pool);
         }
 
         /** Sum of all trajectory durations. */
@@ -111,13 +138,28 @@ namespace SAOP {
             return trajs.duration();
         }
 
-        /* Utility of the plan */
+        /* Utility of the plan
+         *
+         * With an evaluation cache attached, the cache is consulted (but never written) before computing the
+         * utility. The cache is not thread safe: it must then not be updated concurrently, see evaluate(). */
         double utility() const {
-           return u_map.utility();
+            if (eval_cache && !u_map.has_cached_utility()) {
+                const opt<PlanEvaluation> cached = eval_cache->peek(trajs.hash(), duration(), num_segments());
+                if (cached) {
+                    return cached->utility;
+                }
+            }
+            return u_map.utility(trajs);
         }
 
         GenRaster<double> utility_map() const {
-            return u_map.utility_map();
+            return u_map.utility_map(trajs);
+        }
+
+        /** Computes the lazily evaluated utility map of the plan. Once done, and until the plan is updated,
+         * estimated_gain() only reads the plan and can be called from several threads. */
+        void compute_utility_map() const {
+            u_map.compute_utility_map(trajs);
         }
 
         size_t num_segments() const {
@@ -134,6 +176,11 @@ namespace SAOP {
         /** All observations in the plan. Computed assuming we observe at any time, not only when doing a segment*/
         vector<PositionTime> observations_full() const;
 
+        /** Cells seen burning from segments within the time window, each once with the time of its first
+         * observation, sorted by cell index. Compact version of observations(tw), without the previous
+         * observations. */
+        CellObservations observed_cells(const TimeWindow& tw) const;
+
         /* Observations done within an arbitrary time window
          */
         vector<PositionTime> observations(const TimeWindow& tw) const;
@@ -157,6 +204,21 @@ namespace SAOP {
 
         PReversibleTrajectoriesUpdate update(PReversibleTrajectoriesUpdate u, bool do_post_processing = false);
 
+        /** Applies a value-type update and returns the update that would revert it. */
+        SegmentUpdate update(const SegmentUpdate& u, bool do_post_processing = false);
+
+        /** Cheap estimate of the utility gained by applying an update inserting or replacing a segment,
+         * see Utility::estimated_gain(). Other updates are estimated to gain nothing. */
+        double estimated_gain(const SegmentUpdate& u, size_t stride = 2) const;
+
+        /** Evaluates the plan that would result from applying the given update.
+         * The update is applied and reverted in place and the lazily computed utility of the current plan is
+         * preserved, so the plan is never cloned. When requested, the changes made by post-processing are recorded
+         * and reverted as well.
+         * If an evaluation cache is set, it is consulted before computing the utility of the updated plan, and the
+         * computed evaluation is stored in it. Plans sharing the cache must then not be evaluated concurrently. */
+        PlanEvaluation evaluate(const SegmentUpdate& u, bool do_post_processing = false);
+
         void freeze_before(double time);
 
         void freeze_trajectory(std::string traj);
@@ -164,17 +226,22 @@ namespace SAOP {
         void post_process() {
             project_on_fire_front();
             smooth_trajectory();
-            u_map.reset(trajs);
+            u_map.reset();
         }
 
         /** Make sure every segment makes an observation, i.e., that the picture will be taken when the fire in traversing the main cell.
          *
          * If this is not the case for a given segment, its is projected on the firefront.
+         * Segments are projected in batches, split on the thread pool of the plan if any.
          * */
-        void project_on_fire_front();
+        void project_on_fire_front() {
+            project_on_fire_front(nullptr);
+        }
 
         /** Goes through all trajectories and erase segments causing very tight loops. */
-        void smooth_trajectory();
+        void smooth_trajectory() {
+            smooth_trajectory(nullptr);
+        }
 
         /* Get the cells of the Raster
          * */
@@ -185,10 +252,37 @@ namespace SAOP {
         }
 
     private:
+        /** Post-processing steps, each change being recorded in 'undo' (if not null) as the update reverting it. */
+        void project_on_fire_front(std::vector<SegmentUpdate>* undo);
+
+        void smooth_trajectory(std::vector<SegmentUpdate>* undo);
+
+        /** Applies a change made by post-processing, see project_on_fire_front(). */
+        void post_process_update(const SegmentUpdate& u, std::vector<SegmentUpdate>* undo);
+
+        /** Fills possible_observations with the cells igniting in the time window of the plan,
+         * except the ones observed previously. */
+        void compute_possible_observations();
+
+        /** Evaluation of the plan in its current state found in the evaluation cache, if any. */
+        opt<PlanEvaluation> cached_evaluation();
+
+        /** Evaluates the plan in its current state and records the result in the evaluation cache. */
+        PlanEvaluation compute_evaluation();
+
         std::string plan_name = "unnamed";
         Trajectories trajs;
         shared_ptr<FireData> fire_data;
         Utility u_map;
+        shared_ptr<EvaluationCache> eval_cache;
+        shared_ptr<ThreadPool> pool;
+
+        /** Observation index, built on the first call to observation_index() */
+        struct LazyObservationIndex {
+            std::once_flag built;
+            unique_ptr<const ObservationIndex> index;
+        };
+        shared_ptr<LazyObservationIndex> obs_index;
     };
 }
 
@@ -23,32 +23,66 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "utility.hpp"
 
-double SAOP::Utility::utility() const {
+double SAOP::Utility::utility(const Trajectories& trajs) const {
     if (utility_cache && utility_map_cache) {
         return *utility_cache;
     }
     /* Recompute utility */
-    GenRaster<double> utility = utility_map();
+    const GenRaster<double>& utility = current_utility_map(trajs);
     auto accumulate_ignoring_nan = [](double a, double b) { return isnan(b) ? a : a + b; };
     utility_cache = std::accumulate(utility.begin(), utility.end(), 0., accumulate_ignoring_nan);
     return *utility_cache;
 
 }
 
-GenRaster<double> SAOP::Utility::utility_map() const {
-    if (utility_map_cache) {
-        return *utility_map_cache;
+GenRaster<double> SAOP::Utility::utility_map(const Trajectories& trajs) const {
+    return current_utility_map(trajs);
+}
+
+const GenRaster<double>& SAOP::Utility::current_utility_map(const Trajectories& trajs) const {
+    if (!utility_map_cache) {
+        utility_map_cache = utility_impl_trace(trajs);
     }
-    utility_map_cache = utility_impl_trace();
     return *utility_map_cache;
 }
 
+double SAOP::Utility::estimated_gain(const Trajectories& trajs, const Segment3d& segment, double view_width,
+                                     double view_depth, double time, size_t stride) const {
+    ASSERT(stride > 0);
+    const GenRaster<double>& u_map = current_utility_map(trajs);
+    const double step = u_map.cell_width * stride;
+
+    // same visibility rectangle as RasterMapper::segment_trace, in the frame of the segment:
+    // 'along' goes from the back to the front of the rectangle, 'across' from its left to its right
+    const double cos_dir = cos(segment.start.dir);
+    const double sin_dir = sin(segment.start.dir);
+    const double ssx = segment.start.x - cos_dir * view_depth / 2;
+    const double ssy = segment.start.y - sin_dir * view_depth / 2;
+    const double rect_length = segment.length + view_depth;
+
+    double gain = 0.;
+    for (double along = step / 2; along < rect_length; along += step) {
+        for (double across = -view_width / 2 + step / 2; across < view_width / 2; across += step) {
+            const double x = ssx + cos_dir * along - sin_dir * across;
+            const double y = ssy + sin_dir * along + cos_dir * across;
+            if (!u_map.is_x_in(x) || !u_map.is_y_in(y)) {
+                continue;
+            }
+            const Cell c{u_map.x_index(x), u_map.y_index(y)};
+            const double u = u_map(c);
+            if (!isnan(u) && fire_data->ignitions(c) <= time && time <= fire_data->traversal_end(c)) {
+                gain += u;
+            }
+        }
+    }
+    return gain * stride * stride;
+}
+
 GenRaster<double> SAOP::Utility::initial_utility() const {
     return base_utility;
 }
 
-void Utility::reset(Trajectories trajs) {
-    trajectories = std::move(trajs);
+void Utility::reset() {
     utility_cache.reset();
     utility_map_cache.reset();
 }
@@ -59,6 +93,18 @@ void Utility::reset(std::shared_ptr<FireData> firedata) {
     utility_map_cache.reset();
 }
 
+Utility::CachedState Utility::take_cached_state() {
+    CachedState state{std::move(utility_cache), std::move(utility_map_cache)};
+    utility_cache.reset();
+    utility_map_cache.reset();
+    return state;
+}
+
+void Utility::restore_cached_state(CachedState&& state) {
+    utility_cache = std::move(state.utility);
+    utility_map_cache = std::move(state.utility_map);
+}
+
 std::vector<std::pair<Position3dTime, Position3dTime>> Utility::straight_segments_of(const Trajectory& traj) {
     std::vector<std::pair<Position3dTime, Position3dTime>> segments = {};
 
@@ -97,36 +143,34 @@ std::vector<std::pair<Position3dTime, Position3dTime>> Utility::straight_segment
     return segments;
 }
 
-SAOP::GenRaster<double> SAOP::Utility::utility_impl_trace() const {
+SAOP::GenRaster<double> SAOP::Utility::utility_impl_trace(const Trajectories& trajs) const {
     GenRaster<double> u_map(std::vector<double>(base_utility.data), base_utility.x_width, base_utility.y_height,
                             base_utility.x_offset, base_utility.y_offset, base_utility.cell_width);
-    if (trajectories) {
-        for (const auto& traj : *trajectories) {
-            /* Identify straight portions of trajectory */
-            auto straight_o = straight_segments_of(traj);
-            for (const auto& o : straight_o) {
-                Segment3d segment = Segment3d(o.first.pt, o.second.pt);
-                TimeWindow segment_tw = TimeWindow(o.first.time, o.second.time);
-
-                /*Search cells observed from the straight paths*/
-                opt<std::vector<Cell>> trace = RasterMapper::segment_trace<GenRaster<double>>(segment,
-                                                                                              traj.conf().uav.view_width(),
-                                                                                              traj.conf().uav.view_depth(),
-                                                                                              u_map);
-                if (trace) {
-
-                    for (const auto& c: *trace) {
-                        TimeWindow fire_tw = TimeWindow(fire_data->ignitions(c), fire_data->traversal_end(c));
-                        /*Extract utility from the observed cells*/
-                        if (segment_tw.intersects(fire_tw) || segment_tw.contains(fire_tw) ||
-                            fire_tw.contains(segment_tw)) {
-                            u_map.set(c, MIN_UTILITY);
-                        }
+    for (const auto& traj : trajs) {
+        /* Identify straight portions of trajectory */
+        auto straight_o = straight_segments_of(traj);
+        for (const auto& o : straight_o) {
+            Segment3d segment = Segment3d(o.first.pt, o.second.pt);
+            TimeWindow segment_tw = TimeWindow(o.first.time, o.second.time);
+
+            /*Search cells observed from the straight paths*/
+            opt<std::vector<Cell>> trace = RasterMapper::segment_trace<GenRaster<double>>(segment,
+                                                                                          traj.conf().uav.view_width(),
+                                                                                          traj.conf().uav.view_depth(),
+                                                                                          u_map);
+            if (trace) {
+
+                for (const auto& c: *trace) {
+                    TimeWindow fire_tw = TimeWindow(fire_data->ignitions(c), fire_data->traversal_end(c));
+                    /*Extract utility from the observed cells*/
+                    if (segment_tw.intersects(fire_tw) || segment_tw.contains(fire_tw) ||
+                        fire_tw.contains(segment_tw)) {
+                        u_map.set(c, MIN_UTILITY);
                     }
                 }
             }
-
         }
+
     }
     return u_map;
 }
\ No newline at end of file
@@ -39,16 +39,48 @@ namespace SAOP {
         Utility(GenRaster<double> initial_utility, std::shared_ptr<FireData> firedata)
                 : base_utility(std::move(initial_utility)), fire_data(std::move(firedata)) {}
 
-        double utility() const;
+        /* Utility left after observing from 'trajs', the trajectories given to reset() if the cache is still valid.
+         * Trajectories are not stored: they are borrowed for the duration of the call. */
+        double utility(const Trajectories& trajs) const;
 
-        GenRaster<double> utility_map() const;
+        /* True if utility() would return without recomputing the utility map */
+        bool has_cached_utility() const {
+            return utility_cache && utility_map_cache;
+        }
+
+        GenRaster<double> utility_map(const Trajectories& trajs) const;
+
+        /* Computes the utility map if not already cached, so that it can be read concurrently afterwards. */
+        void compute_utility_map(const Trajectories& trajs) const {
+            current_utility_map(trajs);
+        }
 
         GenRaster<double> initial_utility() const;
 
-        void reset(Trajectories trajs);
+        /* Discards the cached utility, to be called whenever the trajectories change. */
+        void reset();
 
         void reset(std::shared_ptr<FireData> firedata);
 
+        /* Fast estimate of the utility that would be gained by observing from the given segment at the given time.
+         * The visibility rectangle of the segment is sampled every 'stride' cells of the current utility map and each
+         * sample counts for stride^2 cells if it is burning at 'time'.
+         * Unlike utility(), the transit to and from the segment is ignored, which makes this an approximation
+         * suited to rank candidates before evaluating the best ones exactly. */
+        double estimated_gain(const Trajectories& trajs, const Segment3d& segment, double view_width,
+                              double view_depth, double time, size_t stride = 2) const;
+
+        /* Lazily computed state of the utility, that can be set aside while a tentative change is evaluated */
+        struct CachedState {
+            opt<double> utility;
+            opt<GenRaster<double>> utility_map;
+        };
+
+        /* Moves the cached state out of this object, leaving it as if it was never reset. */
+        CachedState take_cached_state();
+
+        /* Restores a state previously obtained with take_cached_state(). */
+        void restore_cached_state(CachedState&& state);
 
 
     private:
@@ -66,13 +98,14 @@ namespace SAOP {
         mutable opt<double> utility_cache = {};
         mutable opt<GenRaster<double>> utility_map_cache = {};
 
-        opt<Trajectories> trajectories = {};
+        /* Current utility map, computed from 'trajs' if needed, without copying it */
+        const GenRaster<double>& current_utility_map(const Trajectories& trajs) const;
 
         static std::vector<std::pair<Position3dTime, Position3dTime>> straight_segments_of(const Trajectory& traj);
         /** Utility map of the plan.
          * Extract the utility from observation trace rectangles.
          **/
-        GenRaster<double> utility_impl_trace() const;
+        GenRaster<double> utility_impl_trace(const Trajectories& trajs) const;
 
     };
 }
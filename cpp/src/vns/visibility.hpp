@@ -25,33 +25,52 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #ifndef PLANNING_CPP_VISIBILITY_H
 #define PLANNING_CPP_VISIBILITY_H
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 #include "../core/raster.hpp"
 #include "../core/trajectory.hpp"
-#include "../core/fire_data.hpp"
+#include "../core/uav.hpp"
 
 using namespace std;
 using namespace SAOP;
 
 namespace SAOP {
 
+    /** Tracks the cells seen by a set of segments and the cost of the cells of interest that remain unseen.
+     *
+     * The cost of a pending cell (of interest and not visible) grows with its distance to the closest visited cell
+     * (of interest and visible), up to MAX_INDIVIDUAL_COST beyond MAX_INFORMATIVE_DISTANCE.
+     *
+     * Pending and visited cells are indexed in square buckets at least MAX_INFORMATIVE_DISTANCE wide, so that all
+     * cells informing a given cell are in its bucket or in one of the 8 around it. The cost of each pending cell
+     * and their sum are maintained when a cell changes state, by only looking at the cells of these buckets.
+     * cost_given() records the changes it makes to undo them afterwards.
+     */
     class Visibility {
     public:
-        const FireData fire;
+        const DRaster ignitions;
         const double cell_width;
         LRaster visibility;
         LRaster interest;
 
-        vector<Cell> interesting_visited;
-        vector<Cell> interesting_pending;
-        vector<double> pending_costs;
+        /** Cost associated to each pending cell, 0 for all other cells. */
+        DRaster pending_costs;
 
         Visibility(const DRaster& ignitions, double time_window_min, double time_window_max)
-                : fire(ignitions),
+                : ignitions(ignitions),
                   cell_width(ignitions.cell_width),
                   visibility(LRaster(ignitions.x_width, ignitions.y_height, ignitions.x_offset, ignitions.y_offset,
                                      ignitions.cell_width)),
                   interest(LRaster(ignitions.x_width, ignitions.y_height, ignitions.x_offset, ignitions.y_offset,
-                                   ignitions.cell_width)) {
+                                   ignitions.cell_width)),
+                  pending_costs(DRaster(ignitions.x_width, ignitions.y_height, ignitions.x_offset,
+                                        ignitions.y_offset, ignitions.cell_width)),
+                  bucket_cells((size_t) std::max(1., ceil(MAX_INFORMATIVE_DISTANCE / ignitions.cell_width))),
+                  pending(ignitions.x_width, ignitions.y_height, bucket_cells),
+                  visited(ignitions.x_width, ignitions.y_height, bucket_cells) {
             set_time_window_of_interest(time_window_min, time_window_max);
         }
 
@@ -60,18 +79,26 @@ namespace SAOP {
         /** Mark as interesting all points whose ignition time lies between min and max.
          * All non-interesting points are not taken into account in the cost computation. */
         void set_time_window_of_interest(double min, double max) {
+            ASSERT(!recording);
             reset();
 
-            for (size_t x = 0; x < fire.ignitions.x_width; x++) {
-                for (size_t y = 0; y < fire.ignitions.y_height; y++) {
-                    const double t = fire.ignitions(x, y);
+            for (size_t y = 0; y < ignitions.y_height; y++) {
+                for (size_t x = 0; x < ignitions.x_width; x++) {
+                    const double t = ignitions(x, y);
                     if (min <= t && t <= max) {
-                        Cell c{x, y};
                         interest.set(x, y, 1);
-                        if (is_visible(x, y))
-                            add_visited(c);
-                        else
-                            add_pending(c);
+                        if (is_visible(x, y)) {
+                            visited.add(Cell{x, y});
+                        } else {
+                            pending.add(Cell{x, y});
+                        }
+                    }
+                }
+            }
+            for (size_t y = 0; y < ignitions.y_height; y++) {
+                for (size_t x = 0; x < ignitions.x_width; x++) {
+                    if (is_pending(x, y)) {
+                        set_pending_cost(Cell{x, y}, closest_visited_cost(Cell{x, y}));
                     }
                 }
             }
@@ -92,12 +119,10 @@ namespace SAOP {
             update_visibility(uav, segment, -1);
         }
 
+        /** Sum of the costs of all pending cells.
+         * Maintained incrementally, it might differ from the sum of pending_costs by rounding errors. */
         double cost() const {
-            double cost = 0.;
-            for (size_t i = 0; i < pending_costs.size(); i++) {
-                cost += pending_costs[i];
-            }
-            return cost;
+            return total_cost;
         }
 
         double cost_given_addition(const UAV& uav, Segment addition) {
@@ -112,8 +137,12 @@ namespace SAOP {
             return cost_given(uav, vector<Segment> {added}, vector<Segment> {removed});
         }
 
-        double cost_given(const UAV& uav, const vector<Segment> additions, const vector<Segment> removal) {
-            const double init_cost = cost();
+        /** Cost that would result from adding and removing the given segments.
+         * Changes are recorded while they are applied and undone afterwards, leaving the object untouched. */
+        double cost_given(const UAV& uav, const vector<Segment>& additions, const vector<Segment>& removal) {
+            ASSERT(!recording);
+            recording = true;
+            const double init_cost = total_cost;
 
             // apply changes
             for (auto it = additions.begin(); it != additions.end(); it++)
@@ -122,13 +151,29 @@ namespace SAOP {
                 remove_segment(uav, *it);
             const double resulting_cost = cost();
 
-            // rollback changes
-            for (auto it = additions.begin(); it != additions.end(); it++)
-                remove_segment(uav, *it);
-            for (auto it = removal.begin(); it != removal.end(); it++)
-                add_segment(uav, *it);
+            // rollback changes, most recent first
+            for (auto it = changes.rbegin(); it != changes.rend(); it++) {
+                switch (it->kind) {
+                    case Change::Kind::Visibility:
+                        visibility.set(it->cell, (long) it->previous);
+                        break;
+                    case Change::Kind::Cost:
+                        pending_costs.set(it->cell, it->previous);
+                        break;
+                    case Change::Kind::Visited:
+                        visited.remove(it->cell);
+                        pending.add(it->cell);
+                        break;
+                    case Change::Kind::Pending:
+                        pending.remove(it->cell);
+                        visited.add(it->cell);
+                        break;
+                }
+            }
+            changes.clear();
+            total_cost = init_cost;
+            recording = false;
 
-            assert(abs(init_cost - cost()) < 0.00001);
             return resulting_cost;
         }
 
@@ -139,82 +184,170 @@ namespace SAOP {
         const double MAX_INFORMATIVE_DISTANCE = 500.;
         const double MAX_INDIVIDUAL_COST = 1.;
 
+        /** Set of cells, grouped by the square bucket of 'bucket_cells' x 'bucket_cells' cells they fall in.
+         * Cells are added and removed in constant time. */
+        class BucketedCells {
+        public:
+            BucketedCells(size_t x_width, size_t y_height, size_t bucket_cells)
+                    : x_width(x_width), bucket_cells(bucket_cells),
+                      x_buckets((x_width + bucket_cells - 1) / bucket_cells),
+                      y_buckets((y_height + bucket_cells - 1) / bucket_cells),
+                      buckets(x_buckets * y_buckets),
+                      positions(x_width * y_height, not_in_set) {}
+
+            void add(const Cell& c) {
+                ASSERT(positions[index(c)] == not_in_set);
+                std::vector<Cell>& bucket = buckets[bucket_of(c)];
+                positions[index(c)] = bucket.size();
+                bucket.push_back(c);
+            }
+
+            void remove(const Cell& c) {
+                ASSERT(positions[index(c)] != not_in_set);
+                std::vector<Cell>& bucket = buckets[bucket_of(c)];
+                // move the last cell of the bucket in place of the removed one
+                const size_t position = positions[index(c)];
+                bucket[position] = bucket.back();
+                positions[index(bucket[position])] = position;
+                bucket.pop_back();
+                positions[index(c)] = not_in_set;
+            }
+
+            void clear() {
+                for (auto& bucket : buckets) {
+                    bucket.clear();
+                }
+                std::fill(positions.begin(), positions.end(), not_in_set);
+            }
+
+            /** Applies 'f' to all cells in the bucket of 'c' and the 8 buckets around it. */
+            template<typename F>
+            void for_each_around(const Cell& c, F f) const {
+                const size_t bx = c.x / bucket_cells;
+                const size_t by = c.y / bucket_cells;
+                for (size_t y = by > 0 ? by - 1 : 0; y <= std::min(by + 1, y_buckets - 1); y++) {
+                    for (size_t x = bx > 0 ? bx - 1 : 0; x <= std::min(bx + 1, x_buckets - 1); x++) {
+                        for (const Cell& other : buckets[x + y * x_buckets]) {
+                            f(other);
+                        }
+                    }
+                }
+            }
+
+        private:
+            static constexpr size_t not_in_set = std::numeric_limits<size_t>::max();
+
+            size_t x_width;
+            size_t bucket_cells;
+            size_t x_buckets;
+            size_t y_buckets;
+            std::vector<std::vector<Cell>> buckets;
+            /** Position of each cell in its bucket, or not_in_set. */
+            std::vector<size_t> positions;
+
+            size_t index(const Cell& c) const { return c.x + c.y * x_width; }
+
+            size_t bucket_of(const Cell& c) const { return c.x / bucket_cells + (c.y / bucket_cells) * x_buckets; }
+        };
+
+        /** Change made while recording, with the previous value of the cell for visibility and cost changes. */
+        struct Change {
+            enum class Kind {
+                Visibility, Cost, Visited, Pending
+            };
+            Kind kind;
+            Cell cell;
+            double previous;
+        };
+
+        /** Side of the buckets in cells, such that two cells in non-adjacent buckets are not informative. */
+        size_t bucket_cells;
+        BucketedCells pending;
+        BucketedCells visited;
+
+        double total_cost = 0.;
+
+        /** When recording, changes are kept to be undone. */
+        bool recording = false;
+        std::vector<Change> changes;
+
         inline double cost_by_dist(const Cell pt1, const Cell pt2) const {
             const double dist = sqrt(pow((double) pt1.x - pt2.x, 2.) + pow((double) pt1.y - pt2.y, 2.)) * cell_width;
             const double cost = min(MAX_INFORMATIVE_DISTANCE, dist) / MAX_INFORMATIVE_DISTANCE * MAX_INDIVIDUAL_COST;
-            assert(cost <= MAX_INDIVIDUAL_COST);
+            ASSERT(cost <= MAX_INDIVIDUAL_COST);
             return cost;
         }
 
-        void reset() {
-            interest.reset();
-            interesting_pending.clear();
-            interesting_visited.clear();
+        inline bool is_pending(size_t x, size_t y) const { return is_of_interest(x, y) && !is_visible(x, y); }
+
+        /** Cost of a cell given the visited cells around it. */
+        double closest_visited_cost(const Cell& pt) const {
+            double best_cost = MAX_INDIVIDUAL_COST;
+            visited.for_each_around(pt, [this, &pt, &best_cost](const Cell& v) {
+                best_cost = min(best_cost, cost_by_dist(pt, v));
+            });
+            return best_cost;
         }
 
-        void add_visited(Cell pt) {
-            assert(visibility(pt.x, pt.y) == 1 && is_of_interest(pt.x, pt.y));
-            interesting_visited.push_back(pt);
-
-            // update costs of pending points if this new visited provides a better utility
-            for (size_t i = 0; i < interesting_pending.size(); i++) {
-                const double cost_with_new = cost_by_dist(pt, interesting_pending[i]);
-                if (cost_with_new < pending_costs[i])
-                    pending_costs[i] = cost_with_new;
+        void set_visibility(const Cell& pt, long value) {
+            if (recording) {
+                changes.push_back(Change{Change::Kind::Visibility, pt, (double) visibility(pt.x, pt.y)});
             }
+            visibility.set(pt, value);
         }
 
-        void remove_visited(Cell pt) {
-            assert(visibility(pt.x, pt.y) == 0 || !is_of_interest(pt.x, pt.y));
-
-            // delete visited
-            size_t index = 0;
-            while (interesting_visited[index] != pt) {
-                index++;
-                assert(index < interesting_visited.size());  // Cell is not in the visited list
-            }
-            interesting_visited.erase(interesting_visited.begin() + index);
-
-            // update the utility of any pending whose utility was based on the presence of pt.
-            for (size_t i = 0; i < interesting_pending.size(); i++) {
-                if (abs(pending_costs[i] - cost_by_dist(pt, interesting_pending[i])) < 0.0001) {
-                    // recompute utility of pending
-                    double best_cost = MAX_INDIVIDUAL_COST;
-                    for (auto it = interesting_visited.begin(); it != interesting_visited.end(); it++) {
-                        const double cost = cost_by_dist(interesting_pending[i], *it);
-                        if (best_cost > cost) {
-                            best_cost = cost;
-                        }
-                    }
-                    pending_costs[i] = best_cost;
-                }
+        void set_pending_cost(const Cell& pt, double cost) {
+            if (recording) {
+                changes.push_back(Change{Change::Kind::Cost, pt, pending_costs(pt.x, pt.y)});
             }
+            total_cost += cost - pending_costs(pt.x, pt.y);
+            pending_costs.set(pt, cost);
         }
 
-        void add_pending(Cell pt) {
-            assert(visibility(pt.x, pt.y) == 0 && is_of_interest(pt.x, pt.y));
-            interesting_pending.push_back(pt);
+        void reset() {
+            interest.reset();
+            pending_costs.reset();
+            pending.clear();
+            visited.clear();
+            total_cost = 0.;
+        }
 
-            // compute the utility of this point and store it
-            double best_cost = MAX_INDIVIDUAL_COST;
-            for (auto it = interesting_visited.begin(); it != interesting_visited.end(); it++) {
-                const double cost = cost_by_dist(pt, *it);
-                if (best_cost > cost)
-                    best_cost = cost;
+        /** Cell that just became visited: it has no cost anymore and might reduce the cost of the pending cells
+         * around it. */
+        void add_visited(Cell pt) {
+            ASSERT(visibility(pt.x, pt.y) == 1 && is_of_interest(pt.x, pt.y));
+            pending.remove(pt);
+            visited.add(pt);
+            if (recording) {
+                changes.push_back(Change{Change::Kind::Visited, pt, 0.});
             }
-            pending_costs.push_back(best_cost);
-            assert(pending_costs.size() == interesting_pending.size());
+            set_pending_cost(pt, 0.);
+
+            pending.for_each_around(pt, [this, &pt](const Cell& p) {
+                const double cost = cost_by_dist(pt, p);
+                if (cost < pending_costs(p.x, p.y)) {
+                    set_pending_cost(p, cost);
+                }
+            });
         }
 
-        void remove_pending(Cell pt) {
-            ASSERT(visibility(pt.x, pt.y) == 1 || !is_of_interest(pt.x, pt.y));
-            size_t index = 0;
-            while (interesting_pending[index] != pt) {
-                index++;
-                ASSERT(index < interesting_pending.size());  // Cell is not in the pending list
+        /** Cell that is not visited anymore: it is now pending and the pending cells whose cost was given by it
+         * are recomputed. */
+        void remove_visited(Cell pt) {
+            ASSERT(visibility(pt.x, pt.y) == 0 && is_of_interest(pt.x, pt.y));
+            visited.remove(pt);
+            pending.add(pt);
+            if (recording) {
+                changes.push_back(Change{Change::Kind::Pending, pt, 0.});
             }
-            interesting_pending.erase(interesting_pending.begin() + index);
-            pending_costs.erase(pending_costs.begin() + index);
+
+            // this includes pt itself, whose cost was null
+            pending.for_each_around(pt, [this, &pt](const Cell& p) {
+                const double cost = cost_by_dist(pt, p);
+                if (cost < MAX_INDIVIDUAL_COST && cost == pending_costs(p.x, p.y)) {
+                    set_pending_cost(p, closest_visited_cost(p));
+                }
+            });
         }
 
         void update_visibility(const UAV& uav, const Segment segment, const int increment) {
@@ -240,37 +373,35 @@ namespace SAOP {
 
             // limits of the area in which to search for visible points
             // this is a subset of the raster that strictly contains the visibility rectangle
-            const double min_x = max(min(min(ax, bx), min(cx, dx)) - cell_width, fire.ignitions.x_offset);
+            const double min_x = max(min(min(ax, bx), min(cx, dx)) - cell_width, ignitions.x_offset);
             const double max_x = min(max(max(ax, bx), max(cx, dx)) + cell_width,
-                                     fire.ignitions.x_offset + fire.ignitions.x_width * cell_width -
-                                     fire.ignitions.cell_width / 2);
-            const double min_y = max(min(min(ay, by), min(cy, dy)) - cell_width, fire.ignitions.y_offset);
+                                     ignitions.x_offset + ignitions.x_width * cell_width -
+                                     ignitions.cell_width / 2);
+            const double min_y = max(min(min(ay, by), min(cy, dy)) - cell_width, ignitions.y_offset);
             const double max_y = min(max(max(ay, by), max(cy, dy)) + cell_width,
-                                     fire.ignitions.y_offset + fire.ignitions.y_height * cell_width -
-                                     fire.ignitions.cell_width / 2);
+                                     ignitions.y_offset + ignitions.y_height * cell_width -
+                                     ignitions.cell_width / 2);
 
             // coordinates of where to start the search, centered on a cell
-            const double start_x = fire.ignitions.x_coords(fire.ignitions.x_index(min_x));
-            const double start_y = fire.ignitions.y_coords(fire.ignitions.y_index(min_y));
+            const double start_x = ignitions.x_coords(ignitions.x_index(min_x));
+            const double start_y = ignitions.y_coords(ignitions.y_index(min_y));
 
             // for each point possibly in the rectangle check if it is in the visible area and mark it as pending/visible when necessary
             for (double ix = start_x; ix <= max_x; ix += cell_width) {
                 for (double iy = start_y; iy <= max_y; iy += cell_width) {
                     if (in_rectangle(ix, iy, ax, ay, bx, by, cx, cy)) {
                         // corresponding point in matrix coordinates
-                        const Cell pt{fire.ignitions.x_index(ix), fire.ignitions.y_index(iy)};
+                        const Cell pt{ignitions.x_index(ix), ignitions.y_index(iy)};
 
-                        visibility.set(pt.x, pt.y, visibility(pt.x, pt.y) + increment);
+                        set_visibility(pt, visibility(pt.x, pt.y) + increment);
                         if (is_of_interest(pt.x, pt.y)) {
                             // pt is of interest
                             if (visibility(pt.x, pt.y) == 1 && increment == 1) {
                                 // pt just became visited
-                                remove_pending(pt);
                                 add_visited(pt);
                             } else if (visibility(pt.x, pt.y) == 0 && increment == -1) {
                                 // pt is not visited anymore
                                 remove_visited(pt);
-                                add_pending(pt);
                             }
                         }
 
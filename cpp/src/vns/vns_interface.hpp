@@ -25,8 +25,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #ifndef PLANNING_CPP_VNS_INTERFACE_H
 #define PLANNING_CPP_VNS_INTERFACE_H
 
+#include <chrono>
 #include <ctime>
 #include <memory>
+#include "construction.hpp"
 #include "plan.hpp"
 
 #include "../ext/json.hpp"
@@ -95,6 +97,12 @@ namespace SAOP {
         virtual unique_ptr<LocalMove> get_move(shared_ptr<Plan> plan) = 0;
 
         virtual std::string name() const = 0;
+
+        /** Neighborhood specific statistics to be included in the search metadata. Null if there are none. */
+        virtual json metadata() const { return json(); }
+
+        /** Clear the statistics reported by metadata(), called at the start of each search. */
+        virtual void reset_metadata() {}
     };
 
     struct Shuffler {
@@ -133,16 +141,29 @@ namespace SAOP {
 
         shared_ptr<Shuffler> shuffler;
 
+        /** Number of slots of the cache of plan evaluations used during a search.
+         * 0 (default) disables the cache. It is enabled with the "evaluation_cache_size" configuration field. */
+        size_t evaluation_cache_size;
+
+        /** If set, builds an initial plan from the one given to search(), before local search starts. */
+        shared_ptr<PlanConstructor> constructor;
+
+        /** Threads on which the plans of a search are projected on the fire front (see Plan::thread_pool()),
+         * created on the first search with one thread per hardware core. */
+        shared_ptr<ThreadPool> pool;
+
         explicit VariableNeighborhoodSearch(vector<shared_ptr<Neighborhood>>& neighborhoods,
-                                            shared_ptr<Shuffler> shuffler)
+                                            shared_ptr<Shuffler> shuffler,
+                                            size_t evaluation_cache_size = 0)
                 :
-                neighborhoods(neighborhoods), shuffler(shuffler) {
+                neighborhoods(neighborhoods), shuffler(shuffler), evaluation_cache_size(evaluation_cache_size) {
             ASSERT(neighborhoods.size() > 0);
         }
 
         /** Refines an initial plan with Variable Neighborhood Search.
          *
-         * @param p: Initial plan.
+         * @param p: Initial plan. If a constructor is set, it is first used to add observations to this plan.
+         * @param max_time_secs: Time budget of the search, including the construction of the initial plan.
          * @param max_restarts: Number of allowed restarts (currently only 0 is supported).
          * @param save_every: If >0, the Search result will contain snapshots of the search every N iterations.
          *                    Warning: this is very heavy on memory usage.
@@ -151,10 +172,37 @@ namespace SAOP {
          * @return
          */
         SearchResult search(Plan p, double max_time_secs, size_t save_every = 0, bool save_improvements = false) {
+            SearchResult result(p);
+            for (auto& n : neighborhoods) {
+                n->reset_metadata();
+            }
+
+            // time left for local search, after construction
+            double search_time_secs = max_time_secs;
+            if (constructor) {
+                // The constructor may be multithreaded, which would bias the CPU clock used for the local search.
+                // It is timed with a wall clock instead, and what it used is taken from the budget of the search.
+                const auto construction_start = std::chrono::steady_clock::now();
+                constructor->construct(p, max_time_secs);
+                const std::chrono::duration<double> construction_time =
+                        std::chrono::steady_clock::now() - construction_start;
+                search_time_secs -= construction_time.count();
+                result.metadata["construction"] = constructor->metadata();
+                result.metadata["construction"]["runtime"] = construction_time.count();
+                result.metadata["construction"]["utility"] = p.utility();
+            }
+
             const clock_t search_start = clock();
             auto seconds_since_start = [search_start]() { return (double(clock() - search_start)) / CLOCKS_PER_SEC; };
 
-            SearchResult result(p);
+            // plans visited during this search share a cache of evaluations, indexed by the hash of their trajectories
+            shared_ptr<EvaluationCache> eval_cache =
+                    evaluation_cache_size > 0 ? make_shared<EvaluationCache>(evaluation_cache_size) : nullptr;
+            p.evaluation_cache(eval_cache);
+            if (!pool) {
+                pool = make_shared<ThreadPool>(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+            }
+            p.thread_pool(pool);
 
             shared_ptr<Plan> best_plan = make_shared<Plan>(p);
             shared_ptr<Plan> best_plan_for_restart = make_shared<Plan>(p);
@@ -173,7 +221,7 @@ namespace SAOP {
 
             bool saved = false; /* True if an improvement was saved so save_every do not take an snapshot again */
 
-            while (seconds_since_start() < max_time_secs) {
+            while (seconds_since_start() < search_time_secs) {
                 // choose first neighborhood
                 size_t current_neighborhood = 0;
                 if (num_restarts > 0) {
@@ -187,7 +235,7 @@ namespace SAOP {
                     }
                 }
 
-                while (seconds_since_start() < max_time_secs && current_neighborhood < neighborhoods.size()) {
+                while (seconds_since_start() < search_time_secs && current_neighborhood < neighborhoods.size()) {
                     // get move for current neighborhood
                     const clock_t start = clock();
                     const unique_ptr<LocalMove> move = neighborhoods[current_neighborhood]->get_move(
@@ -244,6 +292,13 @@ namespace SAOP {
                 // no neighborhood provides improvements, restart or exit.
                 num_restarts += 1;
             }
+            // the cache is only valid within this search and the pool belongs to it, do not let them escape
+            best_plan->evaluation_cache(nullptr);
+            best_plan->thread_pool(nullptr);
+            for (auto& intermediate : result.intermediate_plans) {
+                intermediate.evaluation_cache(nullptr);
+                intermediate.thread_pool(nullptr);
+            }
             result.set_final_plan(*best_plan);
 
             // save neighborhoods metadata
@@ -254,8 +309,15 @@ namespace SAOP {
                 j["name"] = std::to_string(i) + "-" + n.name();
                 j["runtime"] = runtime_per_neighborhood[i];
                 j["runs"] = runs_per_neighborhood[i];
+                const json stats = n.metadata();
+                if (!stats.is_null()) {
+                    j["stats"] = stats;
+                }
                 result.metadata["neighborhoods"].push_back(j);
             }
+            if (eval_cache) {
+                result.metadata["evaluation_cache"] = eval_cache->metadata();
+            }
             result.metadata["utility_history"] = json::array();
             for (auto time_utility : utility_history)
                 result.metadata["utility_history"].push_back(json::array({time_utility.first, time_utility.second}));